@@ -0,0 +1,182 @@
+/**
+ * Picking CPUs to pin workers to. The CPUs this process may use come from
+ * its affinity mask, and which socket each is on from sysfs, so this is only
+ * supported on Linux. Pinning itself is done by the thread pool (see
+ * createPinnedThreadPool in src/pool/pool.h).
+ */
+
+// Needed for sched_getaffinity and the CPU_* macros
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "../utility/utility.h"
+#include "affinity.h"
+
+// Path of the file giving the socket of a CPU
+#define PACKAGE_PATH "/sys/devices/system/cpu/cpu%d/topology/"\
+                     "physical_package_id"
+
+/**
+ * Get the number of CPUs this process is allowed to run on, which may be
+ * fewer than are online (e.g. under taskset, cpusets or a batch scheduler).
+ *
+ * @return The number of available CPUs (at least 1)
+ */
+int getAvailableCpus(void)
+{
+#ifdef __linux__
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+        return CPU_COUNT(&set);
+    }
+#endif
+
+    return getOnlineCpus();
+}
+
+#ifdef __linux__
+
+/**
+ * Get the socket (physical package) a CPU is on.
+ *
+ * @param  cpu The CPU
+ *
+ * @return     The ID of its socket, or 0 if it is not known
+ */
+static int getCpuPackage(const int cpu)
+{
+    char path[128];
+    snprintf(path, sizeof(path), PACKAGE_PATH, cpu);
+
+    FILE * const f = fopen(path, "r");
+    int package = 0;
+
+    if (f) {
+        if (fscanf(f, "%d", &package) != 1 || package < 0) {
+            package = 0;
+        }
+
+        fclose(f);
+    }
+
+    return package;
+}
+
+#endif
+
+/**
+ * Work out which CPU each worker should be pinned to under the given policy.
+ * Only CPUs this process is allowed to run on are used. If there are more
+ * workers than CPUs, they wrap around.
+ *
+ * @param  policy  AFFINITY_COMPACT or AFFINITY_SCATTER
+ * @param  threads The number of workers
+ * @param  cpus    Set to the CPU of each worker (threads of them)
+ *
+ * @return         0 on success, ENOTSUP if pinning is not supported on this
+ *                 system, or another error code otherwise
+ */
+int getAffinityCpus(
+    const AffinityPolicy policy,
+    const int threads,
+    int * const cpus
+)
+{
+#ifdef __linux__
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return errno;
+    }
+
+    const int available = CPU_COUNT(&set);
+
+    // Available CPUs and their sockets, in order of CPU number
+    int * const allowed = malloc(available * sizeof(int));
+    int * const packages = malloc(available * sizeof(int));
+
+    if (!allowed || !packages) {
+        free(packages);
+        free(allowed);
+
+        return ENOMEM;
+    }
+
+    int count = 0;
+    int packageCount = 0;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE && count < available; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            allowed[count] = cpu;
+            packages[count] = getCpuPackage(cpu);
+
+            if (packages[count] >= packageCount) {
+                packageCount = packages[count] + 1;
+            }
+
+            count++;
+        }
+    }
+
+    // Order the CPUs socket by socket for compact, or taking the next CPU of
+    // each socket in turn for scatter
+    int * const order = malloc(count * sizeof(int));
+
+    if (!order) {
+        free(packages);
+        free(allowed);
+
+        return ENOMEM;
+    }
+
+    int ordered = 0;
+
+    if (policy == AFFINITY_SCATTER) {
+        for (int round = 0; ordered < count; round++) {
+            for (int package = 0; package < packageCount; package++) {
+                int seen = 0;
+
+                for (int i = 0; i < count; i++) {
+                    if (packages[i] == package && seen++ == round) {
+                        order[ordered++] = allowed[i];
+
+                        break;
+                    }
+                }
+            }
+        }
+    } else {
+        for (int package = 0; package < packageCount; package++) {
+            for (int i = 0; i < count; i++) {
+                if (packages[i] == package) {
+                    order[ordered++] = allowed[i];
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        cpus[i] = order[i % count];
+    }
+
+    free(order);
+    free(packages);
+    free(allowed);
+
+    return 0;
+#else
+    (void)policy;
+    (void)threads;
+    (void)cpus;
+
+    return ENOTSUP;
+#endif
+}
@@ -0,0 +1,44 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+/**
+ * How workers are pinned to CPUs:
+ *  - AFFINITY_NONE: not at all, the operating system moves them as it likes
+ *  - AFFINITY_COMPACT: one per CPU, filling each socket before the next, so
+ *    neighbouring workers share caches and memory
+ *  - AFFINITY_SCATTER: one per CPU, taking a CPU from each socket in turn, so
+ *    fewer workers than CPUs still use the memory bandwidth of every socket
+ */
+typedef enum {
+    AFFINITY_NONE,
+    AFFINITY_COMPACT,
+    AFFINITY_SCATTER
+} AffinityPolicy;
+
+/**
+ * Get the number of CPUs this process is allowed to run on, which may be
+ * fewer than are online (e.g. under taskset, cpusets or a batch scheduler).
+ *
+ * @return The number of available CPUs (at least 1)
+ */
+int getAvailableCpus(void);
+
+/**
+ * Work out which CPU each worker should be pinned to under the given policy.
+ * Only CPUs this process is allowed to run on are used. If there are more
+ * workers than CPUs, they wrap around.
+ *
+ * @param  policy  AFFINITY_COMPACT or AFFINITY_SCATTER
+ * @param  threads The number of workers
+ * @param  cpus    Set to the CPU of each worker (threads of them)
+ *
+ * @return         0 on success, ENOTSUP if pinning is not supported on this
+ *                 system, or another error code otherwise
+ */
+int getAffinityCpus(
+    const AffinityPolicy policy,
+    const int threads,
+    int * const cpus
+);
+
+#endif
@@ -1,118 +1,474 @@
+// Needed for posix_memalign when compiling with -std=c99
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "array.h"
+
+/**
+ * Round a number of doubles up so that it fills whole GRID_ALIGNMENT lines.
+ *
+ * @param  doubles The number of doubles
+ *
+ * @return         The rounded up number of doubles
+ */
+static int alignedStride(const int doubles)
+{
+    const int doublesPerLine = GRID_ALIGNMENT / sizeof(double);
+
+    return (doubles + doublesPerLine - 1) / doublesPerLine * doublesPerLine;
+}
 
 /**
- * Create a square two dimensional array of ints of the dimension specified.
- * Uses malloc, should always be followed later in the calling code with
- * freeTwoDIntArray.
+ * Allocate an aligned block of the given number of doubles.
  *
- * @param  dimension The dimension of the two dimensional array to create
+ * @param  doubles The number of doubles
  *
- * @return           Pointer to the created two dimensional array
+ * @return         Pointer to the block, or NULL if out of memory
  */
-int **createTwoDIntArray(const int dimension)
+static double *allocateAligned(const size_t doubles)
 {
-    int **rows = (int **)malloc(dimension * sizeof(int*));
+    void *data;
 
-    for (int row = 0; row < dimension; row++) {
-        rows[row] = (int *)malloc(dimension * sizeof(int));
+    if (posix_memalign(&data, GRID_ALIGNMENT, doubles * sizeof(double))) {
+        return NULL;
     }
 
-    return rows;
+    return (double *)data;
 }
 
 /**
- * Create a square two dimensional array of doubles of the dimension specified.
- * Uses malloc, should always be followed later in the calling code with
- * freeTwoDDoubleArray.
+ * Allocate an aligned block of the given number of floats, rounded up to a
+ * whole number of doubles.
  *
- * @param  dimension The dimension of the two dimensional array to create
+ * @param  floats The number of floats
  *
- * @return           Pointer to the created two dimensional array
+ * @return        Pointer to the block, or NULL if out of memory
  */
-double **createTwoDDoubleArray(const int dimension)
+static float *allocateAlignedFloats(const size_t floats)
 {
-    double **rows = (double **)malloc(dimension * sizeof(double*));
+    return (float *)allocateAligned((floats + 1) / 2);
+}
 
-    for (int row = 0; row < dimension; row++) {
-        rows[row] = (double *)malloc(dimension * sizeof(double));
+/**
+ * Get the stride createGrid uses for a grid of the given dimension, i.e. the
+ * dimension rounded up to fill whole GRID_ALIGNMENT lines.
+ *
+ * @param  dimension The dimension of the grid
+ *
+ * @return           The stride, in doubles
+ */
+int getGridStride(const int dimension)
+{
+    return alignedStride(dimension);
+}
+
+/**
+ * Create a square grid of doubles of the dimension specified. The stride is
+ * rounded up so that every row starts on a GRID_ALIGNMENT boundary. Uses a
+ * single aligned allocation, should always be followed later in the calling
+ * code with freeGrid.
+ *
+ * @param  dimension The dimension of the grid to create
+ *
+ * @return           Pointer to the created grid, or NULL if out of memory
+ */
+Grid *createGrid(const int dimension)
+{
+    Grid * const grid = malloc(sizeof(Grid));
+
+    if (!grid) {
+        return NULL;
+    }
+
+    grid->dimension = dimension;
+    grid->stride = alignedStride(dimension);
+    grid->data = allocateAligned((size_t)dimension * grid->stride);
+    grid->mapping = NULL;
+    grid->mappingSize = 0;
+
+    if (!grid->data) {
+        free(grid);
+
+        return NULL;
     }
 
-    return rows;
+    return grid;
+}
+
+/**
+ * Frees a given grid.
+ *
+ * @param grid The grid to free
+ */
+void freeGrid(Grid * const grid)
+{
+    if (grid->mapping) {
+        munmap(grid->mapping, grid->mappingSize);
+    } else {
+        free(grid->data);
+    }
+
+    free(grid);
+}
+
+/**
+ * Set every point of a grid (including edges) to 0.
+ *
+ * @param grid The grid to clear
+ */
+void clearGrid(Grid * const grid)
+{
+    const size_t doubles = (size_t)grid->dimension * grid->stride;
+
+    memset(grid->data, 0, doubles * sizeof(double));
 }
 
 /**
- * Frees a given two dimensional array of doubles of the dimension specified.
+ * Copy every point of one grid (including edges) to another of the same
+ * dimension.
  *
- * @param array     The two dimensional array to free
- * @param dimension The dimension of the two dimensional array to free
+ * @param destination The grid to copy to
+ * @param source      The grid to copy from
  */
-void freeTwoDIntArray(int **array, const int dimension)
+void copyGrid(Grid * const destination, const Grid * const source)
 {
-    for(int row = 0; row < dimension; row++) {
-        free(array[row]);
+    const size_t doubles = (size_t)source->dimension * source->stride;
+
+    memcpy(destination->data, source->data, doubles * sizeof(double));
+}
+
+/**
+ * Copy a range of rows of one grid to another of the same dimension.
+ *
+ * @param destination The grid to copy to
+ * @param source      The grid to copy from
+ * @param rowStart    The first row to copy
+ * @param rowEnd      One past the last row to copy
+ */
+void copyGridRows(
+    Grid * const destination,
+    const Grid * const source,
+    const int rowStart,
+    const int rowEnd
+)
+{
+    if (rowEnd <= rowStart) {
+        return;
     }
 
-    free(array);
+    const size_t doubles = (size_t)(rowEnd - rowStart) * source->stride;
+
+    memcpy(
+        gridRow(destination, rowStart),
+        gridRow(source, rowStart),
+        doubles * sizeof(double)
+    );
 }
 
 /**
- * Frees a given two dimensional array of doubles of the dimension specified.
+ * Fill one grid from another of any dimension by bilinear interpolation.
+ * Each point of the destination is placed at the same relative position in
+ * the source (so corners land on corners), and gets the interpolated value
+ * there. Grids of the same dimension are copied exactly. Both grids must
+ * have a dimension of at least 2.
  *
- * @param array     The two dimensional array to free
- * @param dimension The dimension of the two dimensional array to free
+ * @param destination The grid to fill
+ * @param source      The grid to interpolate from
+ * @param interior    1 to only fill the interior of the destination, keeping
+ *                    its edges, or 0 to fill every point
  */
-void freeTwoDDoubleArray(double **array, const int dimension)
+void interpolateGrid(
+    Grid * const destination,
+    const Grid * const source,
+    const int interior
+)
 {
-    for(int row = 0; row < dimension; row++) {
-        free(array[row]);
+    const int n = destination->dimension - 1;
+    const int m = source->dimension - 1;
+    const int first = interior ? 1 : 0;
+    const int last = interior ? n : n + 1;
+
+    for (int row = first; row < last; row++) {
+        // Position in the source, as a whole part and a fraction
+        const long long rowPosition = (long long)row * m;
+        const int r0 = (int)(rowPosition / n);
+        const double rowFraction = (double)(rowPosition % n) / n;
+        const int r1 = rowFraction > 0 ? r0 + 1 : r0;
+
+        const double * const above = gridRow(source, r0);
+        const double * const below = gridRow(source, r1);
+        double * const values = gridRow(destination, row);
+
+        for (int col = first; col < last; col++) {
+            const long long colPosition = (long long)col * m;
+            const int c0 = (int)(colPosition / n);
+            const double colFraction = (double)(colPosition % n) / n;
+            const int c1 = colFraction > 0 ? c0 + 1 : c0;
+
+            const double top = (1 - colFraction) * above[c0]
+                               + colFraction * above[c1];
+            const double bottom = (1 - colFraction) * below[c0]
+                                  + colFraction * below[c1];
+
+            values[col] = (1 - rowFraction) * top + rowFraction * bottom;
+        }
+    }
+}
+
+/**
+ * Create a split grid for a square grid of the dimension specified. Each row
+ * of each colour holds (dimension + 1) / 2 points, padded as in createGrid.
+ * Should always be followed later in the calling code with freeSplitGrid.
+ *
+ * @param  dimension The dimension of the full grid
+ *
+ * @return           Pointer to the created split grid, or NULL if out of
+ *                   memory
+ */
+SplitGrid *createSplitGrid(const int dimension)
+{
+    SplitGrid * const grid = malloc(sizeof(SplitGrid));
+
+    if (!grid) {
+        return NULL;
     }
 
-    free(array);
+    grid->dimension = dimension;
+    grid->stride = alignedStride((dimension + 1) / 2);
+    grid->even = allocateAligned((size_t)dimension * grid->stride);
+    grid->odd = allocateAligned((size_t)dimension * grid->stride);
+
+    if (!grid->even || !grid->odd) {
+        freeSplitGrid(grid);
+
+        return NULL;
+    }
+
+    return grid;
+}
+
+/**
+ * Frees a given split grid.
+ *
+ * @param grid The split grid to free
+ */
+void freeSplitGrid(SplitGrid * const grid)
+{
+    free(grid->even);
+    free(grid->odd);
+    free(grid);
 }
 
 /**
- * Check if the given two dimensional array of ints contains the given value.
+ * Copy every point of a grid into a split grid of the same dimension.
  *
- * @param  value     The value to search for
- * @param  array     The two dimensional array to search in
- * @param  dimension The dimension of the two dimensional array to search
+ * @param split The split grid to copy into
+ * @param grid  The grid to copy from
+ */
+void splitGrid(SplitGrid * const split, const Grid * const grid)
+{
+    splitGridRows(split, grid, 0, grid->dimension);
+}
+
+/**
+ * Copy a range of rows of a grid into a split grid of the same dimension.
  *
- * @return           1 if value found, 0 otherwise
+ * @param split    The split grid to copy into
+ * @param grid     The grid to copy from
+ * @param rowStart The first row to copy
+ * @param rowEnd   One past the last row to copy
  */
-int twoDIntArrayContains(
-    const int value,
-    int ** const array,
-    const int dimension
+void splitGridRows(
+    SplitGrid * const split,
+    const Grid * const grid,
+    const int rowStart,
+    const int rowEnd
 )
 {
-    for(int row = 0; row < dimension; row++) {
-        for(int col = 0; col < dimension; col++) {
-            if (array[row][col] == value) {
-                return 1;
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const values = gridRow(grid, row);
+        double * const even = splitGridRow(split, 0, row);
+        double * const odd = splitGridRow(split, 1, row);
+
+        for (int col = 0; col < grid->dimension; col++) {
+            if ((row + col) & 1) {
+                odd[col / 2] = values[col];
+            } else {
+                even[col / 2] = values[col];
             }
         }
     }
+}
+
+/**
+ * Copy every point of a split grid back into a grid of the same dimension.
+ *
+ * @param grid  The grid to copy into
+ * @param split The split grid to copy from
+ */
+void joinSplitGrid(Grid * const grid, const SplitGrid * const split)
+{
+    joinSplitGridRows(grid, split, 0, grid->dimension);
+}
+
+/**
+ * Copy a range of rows of a split grid back into a grid of the same
+ * dimension.
+ *
+ * @param grid     The grid to copy into
+ * @param split    The split grid to copy from
+ * @param rowStart The first row to copy
+ * @param rowEnd   One past the last row to copy
+ */
+void joinSplitGridRows(
+    Grid * const grid,
+    const SplitGrid * const split,
+    const int rowStart,
+    const int rowEnd
+)
+{
+    for (int row = rowStart; row < rowEnd; row++) {
+        double * const values = gridRow(grid, row);
+        const double * const even = splitGridRow(split, 0, row);
+        const double * const odd = splitGridRow(split, 1, row);
+
+        for (int col = 0; col < grid->dimension; col++) {
+            values[col] = ((row + col) & 1) ? odd[col / 2] : even[col / 2];
+        }
+    }
+}
+
+/**
+ * Create a single precision split grid for a square grid of the dimension
+ * specified. Each row of each colour is padded in the same way as Grid.
+ * Should always be followed later in the calling code with
+ * freeSplitFloatGrid.
+ *
+ * @param  dimension The dimension of the full grid
+ *
+ * @return           Pointer to the created split grid, or NULL if out of
+ *                   memory
+ */
+SplitFloatGrid *createSplitFloatGrid(const int dimension)
+{
+    SplitFloatGrid * const grid = malloc(sizeof(SplitFloatGrid));
+
+    if (!grid) {
+        return NULL;
+    }
+
+    // Twice as many floats as doubles fit in an aligned line
+    grid->dimension = dimension;
+    grid->stride = 2 * alignedStride(((dimension + 1) / 2 + 1) / 2);
+    grid->even = allocateAlignedFloats((size_t)dimension * grid->stride);
+    grid->odd = allocateAlignedFloats((size_t)dimension * grid->stride);
+
+    if (!grid->even || !grid->odd) {
+        freeSplitFloatGrid(grid);
+
+        return NULL;
+    }
 
-    return 0;
+    return grid;
 }
 
 /**
- * Simple array search on an array of integers. Returns the index of the first
- * occurence of the value if it is found, or -1 otherwise.
+ * Frees a given single precision split grid.
  *
- * @param  value     The value to search for
- * @param  array     The array to search in
- * @param  dimension The dimension of the array to search in
+ * @param grid The split grid to free
+ */
+void freeSplitFloatGrid(SplitFloatGrid * const grid)
+{
+    free(grid->even);
+    free(grid->odd);
+    free(grid);
+}
+
+/**
+ * Copy every point of a grid into a single precision split grid of the same
+ * dimension, rounding each to the nearest float.
  *
- * @return           Index of first occurence of value if found, -1 otherwise
+ * @param split The split grid to copy into
+ * @param grid  The grid to copy from
  */
-int intArraySearch(const int value, int * const array, const int dimension)
+void splitFloatGrid(SplitFloatGrid * const split, const Grid * const grid)
 {
-    for (int i = 0; i < dimension; i++) {
-        if (value == array[i]) {
-            return i;
+    for (int row = 0; row < grid->dimension; row++) {
+        const double * const values = gridRow(grid, row);
+        float * const even = splitFloatGridRow(split, 0, row);
+        float * const odd = splitFloatGridRow(split, 1, row);
+
+        for (int col = 0; col < grid->dimension; col++) {
+            if ((row + col) & 1) {
+                odd[col / 2] = (float)values[col];
+            } else {
+                even[col / 2] = (float)values[col];
+            }
         }
     }
+}
+
+/**
+ * Copy every point of a single precision split grid back into a grid of the
+ * same dimension.
+ *
+ * @param grid  The grid to copy into
+ * @param split The split grid to copy from
+ */
+void joinSplitFloatGrid(Grid * const grid, const SplitFloatGrid * const split)
+{
+    for (int row = 0; row < grid->dimension; row++) {
+        double * const values = gridRow(grid, row);
+        const float * const even = splitFloatGridRow(split, 0, row);
+        const float * const odd = splitFloatGridRow(split, 1, row);
+
+        for (int col = 0; col < grid->dimension; col++) {
+            values[col] = ((row + col) & 1) ? odd[col / 2] : even[col / 2];
+        }
+    }
+}
 
-    return -1;
+/**
+ * Create a cube of doubles of the dimension specified. Uses a single aligned
+ * allocation, should always be followed later in the calling code with
+ * freeGrid3D.
+ *
+ * @param  dimension The dimension of the cube to create
+ *
+ * @return           Pointer to the created cube, or NULL if out of memory
+ */
+Grid3D *createGrid3D(const int dimension)
+{
+    Grid3D * const grid = malloc(sizeof(Grid3D));
+
+    if (!grid) {
+        return NULL;
+    }
+
+    grid->dimension = dimension;
+    grid->stride = alignedStride(dimension);
+    grid->planeStride = (size_t)dimension * grid->stride;
+    grid->data = allocateAligned(dimension * grid->planeStride);
+
+    if (!grid->data) {
+        free(grid);
+
+        return NULL;
+    }
+
+    return grid;
+}
+
+/**
+ * Frees a given cube.
+ *
+ * @param grid The cube to free
+ */
+void freeGrid3D(Grid3D * const grid)
+{
+    free(grid->data);
+    free(grid);
 }
@@ -1,70 +1,329 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <stddef.h>
+
+// Alignment of grid allocations (and so of every grid row), in bytes
+#define GRID_ALIGNMENT 64
+
+/**
+ * Square two dimensional grid of doubles, stored in a single aligned
+ * allocation. Rows are padded so that each one starts on a GRID_ALIGNMENT
+ * boundary, so the distance between rows (stride) may be larger than the
+ * dimension. Use gridRow to get a pointer to the start of a row.
+ *
+ * The data may instead be inside a private memory mapping of a grid file
+ * (see src/gridfile/gridfile.c), in which case freeGrid unmaps it.
+ */
+typedef struct {
+    double * data; // All rows, one after another
+    int dimension; // Number of rows (and columns)
+    int stride; // Distance between the start of consecutive rows, in doubles
+    void * mapping; // Start of the mapping holding data, or NULL if allocated
+    size_t mappingSize; // Size of the mapping in bytes
+} Grid;
+
+/**
+ * Get the stride createGrid uses for a grid of the given dimension, i.e. the
+ * dimension rounded up to fill whole GRID_ALIGNMENT lines.
+ *
+ * @param  dimension The dimension of the grid
+ *
+ * @return           The stride, in doubles
+ */
+int getGridStride(const int dimension);
+
+/**
+ * Create a square grid of doubles of the dimension specified. Uses a single
+ * aligned allocation, should always be followed later in the calling code
+ * with freeGrid.
+ *
+ * @param  dimension The dimension of the grid to create
+ *
+ * @return           Pointer to the created grid
+ */
+Grid *createGrid(const int dimension);
+
+/**
+ * Frees a given grid.
+ *
+ * @param grid The grid to free
+ */
+void freeGrid(Grid * const grid);
+
+/**
+ * Set every point of a grid (including edges) to 0.
+ *
+ * @param grid The grid to clear
+ */
+void clearGrid(Grid * const grid);
+
 /**
- * Create a square two dimensional array of ints of the dimension specified.
+ * Copy every point of one grid (including edges) to another of the same
+ * dimension.
  *
- * @param  dimension The dimension of the two dimensional array to create
+ * @param destination The grid to copy to
+ * @param source      The grid to copy from
+ */
+void copyGrid(Grid * const destination, const Grid * const source);
+
+/**
+ * Copy a range of rows of one grid to another of the same dimension.
+ *
+ * @param destination The grid to copy to
+ * @param source      The grid to copy from
+ * @param rowStart    The first row to copy
+ * @param rowEnd      One past the last row to copy
+ */
+void copyGridRows(
+    Grid * const destination,
+    const Grid * const source,
+    const int rowStart,
+    const int rowEnd
+);
+
+/**
+ * Fill one grid from another of any dimension by bilinear interpolation.
+ * Each point of the destination is placed at the same relative position in
+ * the source (so corners land on corners), and gets the interpolated value
+ * there. Grids of the same dimension are copied exactly. Both grids must
+ * have a dimension of at least 2.
  *
- * @return           Pointer to the created two dimensional array
+ * @param destination The grid to fill
+ * @param source      The grid to interpolate from
+ * @param interior    1 to only fill the interior of the destination, keeping
+ *                    its edges, or 0 to fill every point
  */
-int **createTwoDIntArray(const int dimension);
+void interpolateGrid(
+    Grid * const destination,
+    const Grid * const source,
+    const int interior
+);
 
 /**
- * Create a square two dimensional array of doubles of the dimension specified.
+ * Get a pointer to the start of a row of a grid.
  *
- * @param  dimension The dimension of the two dimensional array to create
+ * @param  grid The grid
+ * @param  row  The index of the row
  *
- * @return           Pointer to the created two dimensional array
+ * @return      Pointer to the first value in the row
  */
-double **createTwoDDoubleArray(const int dimension);
+static inline double *gridRow(const Grid * const grid, const int row)
+{
+    return grid->data + (size_t)row * grid->stride;
+}
 
 /**
- * Note: It would be nice to do the above two in one function as they are
- *       almost identical, but I'm not sure how to do this in C, or if it is
- *       even a good idea.
+ * Square grid of doubles stored as two compacted arrays, one for each colour
+ * of point (see top of src/solve/solve.c): 'E' points where row + col is even
+ * and 'O' points where it is odd. The point at (row, col) is stored at index
+ * col / 2 of row 'row' in the array for its colour. Each colour array has the
+ * same row padding rules as Grid.
  */
+typedef struct {
+    double * even; // All 'E' points, row by row
+    double * odd; // All 'O' points, row by row
+    int dimension; // Number of rows (and columns) of the full grid
+    int stride; // Distance between the start of consecutive rows, in doubles
+} SplitGrid;
 
 /**
- * Frees a given two dimensional array of doubles of the dimension specified.
+ * Create a split grid for a square grid of the dimension specified. Should
+ * always be followed later in the calling code with freeSplitGrid.
+ *
+ * @param  dimension The dimension of the full grid
  *
- * @param array     The two dimensional array to free
- * @param dimension The dimension of the two dimensional array to free
+ * @return           Pointer to the created split grid, or NULL if out of
+ *                   memory
  */
-void freeTwoDIntArray(int **array, const int dimension);
+SplitGrid *createSplitGrid(const int dimension);
 
 /**
- * Frees a given two dimensional array of doubles of the dimension specified.
+ * Frees a given split grid.
  *
- * @param array     The two dimensional array to free
- * @param dimension The dimension of the two dimensional array to free
+ * @param grid The split grid to free
  */
-void freeTwoDDoubleArray(double **array, const int dimension);
+void freeSplitGrid(SplitGrid * const grid);
 
 /**
- * Note: As above, these two free functions are almost identical.
+ * Copy every point of a grid into a split grid of the same dimension.
+ *
+ * @param split The split grid to copy into
+ * @param grid  The grid to copy from
  */
+void splitGrid(SplitGrid * const split, const Grid * const grid);
 
 /**
- * Check if the given two dimensional array of ints contains the given value.
+ * Copy a range of rows of a grid into a split grid of the same dimension.
  *
- * @param  value     The value to search for
- * @param  array     The two dimensional array to search in
- * @param  dimension The dimension of the two dimensional array to search in
+ * @param split    The split grid to copy into
+ * @param grid     The grid to copy from
+ * @param rowStart The first row to copy
+ * @param rowEnd   One past the last row to copy
+ */
+void splitGridRows(
+    SplitGrid * const split,
+    const Grid * const grid,
+    const int rowStart,
+    const int rowEnd
+);
+
+/**
+ * Copy every point of a split grid back into a grid of the same dimension.
+ *
+ * @param grid  The grid to copy into
+ * @param split The split grid to copy from
+ */
+void joinSplitGrid(Grid * const grid, const SplitGrid * const split);
+
+/**
+ * Copy a range of rows of a split grid back into a grid of the same
+ * dimension.
  *
- * @return           1 if value found, 0 otherwise
+ * @param grid     The grid to copy into
+ * @param split    The split grid to copy from
+ * @param rowStart The first row to copy
+ * @param rowEnd   One past the last row to copy
  */
-int twoDIntArrayContains(
-    const int value,
-    int ** const array,
-    const int dimension
+void joinSplitGridRows(
+    Grid * const grid,
+    const SplitGrid * const split,
+    const int rowStart,
+    const int rowEnd
 );
 
 /**
- * Simple array search on an array of integers. Returns the index of the first
- * occurence of the value if it is found, or -1 otherwise.
+ * Get a pointer to the start of a row of one colour of a split grid.
  *
- * @param  value     The value to search for
- * @param  array     The array to search in
- * @param  dimension The dimension of the array to search in
+ * @param  grid    The split grid
+ * @param  oddFlag 1 for the 'O' points, 0 for the 'E' points
+ * @param  row     The index of the row
  *
- * @return           Index of first occurence of value if found, -1 otherwise
+ * @return         Pointer to the first point of the colour in the row
  */
-int intArraySearch(const int value, int * const array, const int dimension);
+static inline double *splitGridRow(
+    const SplitGrid * const grid,
+    const int oddFlag,
+    const int row
+)
+{
+    return (oddFlag ? grid->odd : grid->even) + (size_t)row * grid->stride;
+}
+
+/**
+ * The same as SplitGrid, but storing single precision floats. Used to do most
+ * of the sweeps of a solve at half the memory traffic (see SOLVE_FLOAT_MIXED
+ * in src/solve/solve.h).
+ */
+typedef struct {
+    float * even; // All 'E' points, row by row
+    float * odd; // All 'O' points, row by row
+    int dimension; // Number of rows (and columns) of the full grid
+    int stride; // Distance between the start of consecutive rows, in floats
+} SplitFloatGrid;
+
+/**
+ * Create a single precision split grid for a square grid of the dimension
+ * specified. Should always be followed later in the calling code with
+ * freeSplitFloatGrid.
+ *
+ * @param  dimension The dimension of the full grid
+ *
+ * @return           Pointer to the created split grid, or NULL if out of
+ *                   memory
+ */
+SplitFloatGrid *createSplitFloatGrid(const int dimension);
+
+/**
+ * Frees a given single precision split grid.
+ *
+ * @param grid The split grid to free
+ */
+void freeSplitFloatGrid(SplitFloatGrid * const grid);
+
+/**
+ * Copy every point of a grid into a single precision split grid of the same
+ * dimension, rounding each to the nearest float.
+ *
+ * @param split The split grid to copy into
+ * @param grid  The grid to copy from
+ */
+void splitFloatGrid(SplitFloatGrid * const split, const Grid * const grid);
+
+/**
+ * Copy every point of a single precision split grid back into a grid of the
+ * same dimension.
+ *
+ * @param grid  The grid to copy into
+ * @param split The split grid to copy from
+ */
+void joinSplitFloatGrid(Grid * const grid, const SplitFloatGrid * const split);
+
+/**
+ * Get a pointer to the start of a row of one colour of a single precision
+ * split grid.
+ *
+ * @param  grid    The split grid
+ * @param  oddFlag 1 for the 'O' points, 0 for the 'E' points
+ * @param  row     The index of the row
+ *
+ * @return         Pointer to the first point of the colour in the row
+ */
+static inline float *splitFloatGridRow(
+    const SplitFloatGrid * const grid,
+    const int oddFlag,
+    const int row
+)
+{
+    return (oddFlag ? grid->odd : grid->even) + (size_t)row * grid->stride;
+}
+
+/**
+ * Cube of doubles, stored plane by plane in a single aligned allocation. Each
+ * plane is laid out like a Grid, with rows padded to a GRID_ALIGNMENT
+ * boundary. Use grid3DRow to get a pointer to the start of a row.
+ */
+typedef struct {
+    double * data; // All planes, one after another
+    int dimension; // Number of planes (and rows and columns)
+    int stride; // Distance between the start of consecutive rows, in doubles
+    size_t planeStride; // Distance between consecutive planes, in doubles
+} Grid3D;
+
+/**
+ * Create a cube of doubles of the dimension specified. Uses a single aligned
+ * allocation, should always be followed later in the calling code with
+ * freeGrid3D.
+ *
+ * @param  dimension The dimension of the cube to create
+ *
+ * @return           Pointer to the created cube, or NULL if out of memory
+ */
+Grid3D *createGrid3D(const int dimension);
+
+/**
+ * Frees a given cube.
+ *
+ * @param grid The cube to free
+ */
+void freeGrid3D(Grid3D * const grid);
+
+/**
+ * Get a pointer to the start of a row of a cube.
+ *
+ * @param  grid  The cube
+ * @param  plane The index of the plane
+ * @param  row   The index of the row within the plane
+ *
+ * @return       Pointer to the first value in the row
+ */
+static inline double *grid3DRow(
+    const Grid3D * const grid,
+    const int plane,
+    const int row
+)
+{
+    return grid->data + plane * grid->planeStride + (size_t)row * grid->stride;
+}
+
+#endif
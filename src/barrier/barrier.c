@@ -0,0 +1,196 @@
+/**
+ * A sense-reversing barrier with spin-then-block waiting.
+ *
+ * The 'sense' of the barrier is a generation counter rather than a single
+ * flag, so threads do not need to keep their own local sense: each thread
+ * reads the generation when it arrives, and waits for it to change. The last
+ * thread to arrive resets the count of remaining threads and then increments
+ * the generation, which releases everyone.
+ *
+ * Waiting threads first spin on the generation, which is fastest when the
+ * other threads are close behind (e.g. between the 'E' and 'O' sweeps of a
+ * balanced band decomposition). After spinCount checks they block on a
+ * condition variable (a futex on Linux), so idle workers do not steal a core
+ * from other jobs on a shared node. The last thread only takes the lock to
+ * wake blocked threads if there are any. Both sides use sequentially
+ * consistent atomics, so either the waiter sees the new generation, or the
+ * last thread sees the waiter in sleepers.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "barrier.h"
+
+/**
+ * Print the given error and exit. Used inside waitBarrier, where there is no
+ * caller to return an error code to.
+ *
+ * @param error The pthread error code
+ */
+static void barrierError(const int error)
+{
+    printf("Something went wrong in thread. Error code: %d\n", error);
+    exit(error);
+}
+
+/**
+ * Tell the CPU we are in a spin loop, so it can save power and give
+ * resources to the other hyperthread.
+ */
+static inline void cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * Release all threads waiting at the barrier. Called by the last thread to
+ * arrive.
+ *
+ * @param barrier    The barrier to open
+ * @param generation The generation the waiting threads arrived in
+ */
+static void openBarrier(Barrier * const barrier, const unsigned int generation)
+{
+    __atomic_store_n(&barrier->remaining, barrier->threads, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&barrier->generation, generation + 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&barrier->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        int error = pthread_mutex_lock(&barrier->lock);
+
+        if (error) {
+            barrierError(error);
+        }
+
+        pthread_cond_broadcast(&barrier->opened);
+        pthread_mutex_unlock(&barrier->lock);
+    }
+}
+
+/**
+ * Initialise a barrier for the given number of threads. Should always be
+ * followed later in the calling code with destroyBarrier.
+ *
+ * @param  barrier   The barrier to initialise
+ * @param  threads   The number of threads that must arrive to open it
+ * @param  spinCount How many times a waiting thread checks the barrier before
+ *                   blocking (0 to block straight away)
+ *
+ * @return           0 on success, or a pthread error code otherwise
+ */
+int initBarrier(
+    Barrier * const barrier,
+    const int threads,
+    const int spinCount
+)
+{
+    barrier->threads = threads;
+    barrier->spinCount = spinCount;
+    barrier->remaining = threads;
+    barrier->generation = 0;
+    barrier->sleepers = 0;
+
+    int error = pthread_mutex_init(&barrier->lock, NULL);
+
+    if (error) {
+        return error;
+    }
+
+    error = pthread_cond_init(&barrier->opened, NULL);
+
+    if (error) {
+        pthread_mutex_destroy(&barrier->lock);
+    }
+
+    return error;
+}
+
+/**
+ * Block until all threads have arrived at the barrier. The barrier can be
+ * reused straight away, as waiting threads only leave when the generation
+ * changes, and the count of remaining threads is reset before it does.
+ *
+ * @param barrier The barrier to wait at
+ */
+void waitBarrier(Barrier * const barrier)
+{
+    // Must be read before arriving, as the generation cannot change until
+    // this thread has arrived
+    const unsigned int generation = __atomic_load_n(
+        &barrier->generation,
+        __ATOMIC_SEQ_CST
+    );
+
+    if (__atomic_sub_fetch(&barrier->remaining, 1, __ATOMIC_SEQ_CST) == 0) {
+        openBarrier(barrier, generation);
+
+        return;
+    }
+
+    for (int i = 0; i < barrier->spinCount; i++) {
+        if (__atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE)
+            != generation
+        ) {
+            return;
+        }
+
+        cpuRelax();
+    }
+
+    int error = pthread_mutex_lock(&barrier->lock);
+
+    if (error) {
+        barrierError(error);
+    }
+
+    __atomic_add_fetch(&barrier->sleepers, 1, __ATOMIC_SEQ_CST);
+
+    while (__atomic_load_n(&barrier->generation, __ATOMIC_SEQ_CST)
+           == generation
+    ) {
+        error = pthread_cond_wait(&barrier->opened, &barrier->lock);
+
+        if (error) {
+            barrierError(error);
+        }
+    }
+
+    __atomic_sub_fetch(&barrier->sleepers, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_unlock(&barrier->lock);
+}
+
+/**
+ * Permanently remove threads from a barrier, e.g. threads that failed to
+ * start. Opens the barrier if all of the remaining threads are waiting.
+ *
+ * @param barrier The barrier to remove threads from
+ * @param count   The number of threads to remove
+ */
+void removeFromBarrier(Barrier * const barrier, const int count)
+{
+    const unsigned int generation = __atomic_load_n(
+        &barrier->generation,
+        __ATOMIC_SEQ_CST
+    );
+
+    barrier->threads -= count;
+
+    if (__atomic_sub_fetch(&barrier->remaining, count, __ATOMIC_SEQ_CST) == 0) {
+        openBarrier(barrier, generation);
+    }
+}
+
+/**
+ * Destroy a barrier initialised with initBarrier.
+ *
+ * @param barrier The barrier to destroy
+ */
+void destroyBarrier(Barrier * const barrier)
+{
+    pthread_cond_destroy(&barrier->opened);
+    pthread_mutex_destroy(&barrier->lock);
+}
@@ -0,0 +1,64 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <pthread.h>
+
+/**
+ * Reusable barrier for a fixed number of threads. Threads that arrive early
+ * spin for a while (cheap if the others are close behind), then block on a
+ * condition variable so they do not burn a core while waiting for a long
+ * time. See src/barrier/barrier.c for details.
+ */
+typedef struct {
+    int threads; // Number of threads that must arrive
+    int spinCount; // Number of checks to spin for before blocking
+    int remaining; // Number of threads still to arrive (atomic)
+    unsigned int generation; // The barrier's 'sense', incremented every time
+                             // the barrier opens (atomic)
+    int sleepers; // Number of threads blocked (atomic, changed under lock)
+    pthread_mutex_t lock; // Lock for blocking waits
+    pthread_cond_t opened; // Signalled when the barrier opens
+} Barrier;
+
+/**
+ * Initialise a barrier for the given number of threads. Should always be
+ * followed later in the calling code with destroyBarrier.
+ *
+ * @param  barrier   The barrier to initialise
+ * @param  threads   The number of threads that must arrive to open it
+ * @param  spinCount How many times a waiting thread checks the barrier before
+ *                   blocking (0 to block straight away)
+ *
+ * @return           0 on success, or a pthread error code otherwise
+ */
+int initBarrier(
+    Barrier * const barrier,
+    const int threads,
+    const int spinCount
+);
+
+/**
+ * Block until all threads have arrived at the barrier. The barrier can be
+ * reused straight away.
+ *
+ * @param barrier The barrier to wait at
+ */
+void waitBarrier(Barrier * const barrier);
+
+/**
+ * Permanently remove threads from a barrier, e.g. threads that failed to
+ * start. Opens the barrier if all of the remaining threads are waiting.
+ *
+ * @param barrier The barrier to remove threads from
+ * @param count   The number of threads to remove
+ */
+void removeFromBarrier(Barrier * const barrier, const int count);
+
+/**
+ * Destroy a barrier initialised with initBarrier.
+ *
+ * @param barrier The barrier to destroy
+ */
+void destroyBarrier(Barrier * const barrier);
+
+#endif
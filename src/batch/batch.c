@@ -0,0 +1,496 @@
+/**
+ * Batches of independent solves in one process (see --batch in src/main.c),
+ * so thousands of small grids do not each pay to start a process, create
+ * threads and allocate working buffers.
+ *
+ * A small grid gains little from being split across threads: each sweep is
+ * too short to cover the cost of the barriers between half-sweeps. So the
+ * jobs are run one per thread instead, with no synchronisation at all while
+ * solving, and every thread busy until the batch runs out of jobs. Threads
+ * take the largest job left each time, so the jobs left at the end (when
+ * some threads are idle) are the shortest ones. Grids of at least the split
+ * size are large enough to split well, and would leave the other threads
+ * idle for a long time if one thread had to solve them alone, so they are
+ * run first, one at a time, each on all the threads.
+ *
+ * Each thread solves all its jobs with one solve context, so the pool and
+ * scratch buffers are set up once per thread rather than once per job.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../pool/pool.h"
+#include "../solve/solve.h"
+#include "../solve/band.h"
+#include "batch.h"
+
+// Characters that separate the fields of a manifest line
+#define FIELD_SEPARATORS " \t\r\n"
+
+// Starting size of the buffer manifest lines are read into
+#define INITIAL_LINE_CAPACITY 256
+
+// A job and the dimension of its grid, to sort jobs by
+typedef struct {
+    int size; // The dimension of the job's grid
+    int job; // The job
+} BatchOrder;
+
+// struct to pass multiple arguments to the pool task
+typedef struct {
+    const BatchOrder * order; // Jobs to run one per thread, largest first
+    int count; // Number of jobs in order
+    int next; // Index in order of the next job to run
+    pthread_mutex_t lock; // Lock on next and error
+    const SolveOptions * options; // Options for each thread's context
+    BatchTask task; // Called to run each job
+    void * args; // Passed to task
+    int error; // First error creating or freeing a context
+} BatchArgs;
+
+/**
+ * Read a whole line from a file into a buffer, growing the buffer if the
+ * line does not fit.
+ *
+ * @param  f        The file
+ * @param  buffer   The buffer, which may be replaced by a larger one
+ * @param  capacity The size of the buffer, updated if it grows
+ * @param  ended    Set to 1 if the end of the file was reached before any
+ *                  character of the line, 0 otherwise
+ *
+ * @return          0 on success, or an error code otherwise
+ */
+static int readLine(
+    FILE * const f,
+    char ** const buffer,
+    size_t * const capacity,
+    int * const ended
+)
+{
+    size_t length = 0;
+
+    *ended = 0;
+
+    while (1) {
+        if (*capacity - length < 2) {
+            char * const grown = realloc(*buffer, *capacity * 2);
+
+            if (!grown) {
+                return ENOMEM;
+            }
+
+            *buffer = grown;
+            *capacity *= 2;
+        }
+
+        if (!fgets(*buffer + length, (int)(*capacity - length), f)) {
+            *ended = length == 0;
+
+            return ferror(f) ? EIO : 0;
+        }
+
+        length += strlen(*buffer + length);
+
+        if ((*buffer)[length - 1] == '\n') {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Split a line of a manifest into fields.
+ *
+ * @param  line       The line read
+ * @param  lineNumber The number of the line in the manifest
+ * @param  parsed     Set to the fields of the line (fieldCount is 0 for a
+ *                    blank line or a comment, and nothing is allocated)
+ *
+ * @return            0 on success, or ENOMEM
+ */
+static int splitManifestLine(
+    const char * const line,
+    const int lineNumber,
+    ManifestLine * const parsed
+)
+{
+    parsed->lineNumber = lineNumber;
+    parsed->fieldCount = 0;
+    parsed->fields = NULL;
+    parsed->text = NULL;
+
+    const char *c = line + strspn(line, FIELD_SEPARATORS);
+
+    if (*c == '\0' || *c == '#') {
+        return 0;
+    }
+
+    const size_t length = strlen(c);
+    int fieldCount = 0;
+
+    for (size_t i = 0; i < length; ) {
+        i += strspn(c + i, FIELD_SEPARATORS);
+
+        if (i < length) {
+            fieldCount++;
+            i += strcspn(c + i, FIELD_SEPARATORS);
+        }
+    }
+
+    parsed->text = malloc(length + 1);
+    parsed->fields = malloc(fieldCount * sizeof(char *));
+
+    if (!parsed->text || !parsed->fields) {
+        free(parsed->fields);
+        free(parsed->text);
+
+        return ENOMEM;
+    }
+
+    memcpy(parsed->text, c, length + 1);
+
+    for (char *field = strtok(parsed->text, FIELD_SEPARATORS);
+         field;
+         field = strtok(NULL, FIELD_SEPARATORS)
+    ) {
+        parsed->fields[parsed->fieldCount++] = field;
+    }
+
+    return 0;
+}
+
+/**
+ * Read a job manifest: a text file with one job per line. Blank lines and
+ * lines starting with # are skipped, and the fields of every other line are
+ * separated by spaces or tabs. Should always be followed later in the
+ * calling code with freeManifest.
+ *
+ * @param  path  The path of the manifest
+ * @param  lines Set to the lines with at least one field, in order
+ * @param  count Set to the number of lines
+ *
+ * @return       0 on success, or an error code otherwise
+ */
+int readManifest(
+    const char * const path,
+    ManifestLine ** const lines,
+    int * const count
+)
+{
+    FILE * const f = fopen(path, "r");
+
+    if (!f) {
+        return errno;
+    }
+
+    size_t capacity = INITIAL_LINE_CAPACITY;
+    char *buffer = malloc(capacity);
+
+    int error = buffer ? 0 : ENOMEM;
+    int ended = 0;
+    int lineCapacity = 0;
+
+    *lines = NULL;
+    *count = 0;
+
+    for (int lineNumber = 1; !error; lineNumber++) {
+        error = readLine(f, &buffer, &capacity, &ended);
+
+        if (error || ended) {
+            break;
+        }
+
+        ManifestLine line;
+        error = splitManifestLine(buffer, lineNumber, &line);
+
+        if (error || line.fieldCount == 0) {
+            continue;
+        }
+
+        if (*count == lineCapacity) {
+            lineCapacity = lineCapacity ? lineCapacity * 2 : 16;
+
+            ManifestLine * const grown = realloc(
+                *lines,
+                lineCapacity * sizeof(ManifestLine)
+            );
+
+            if (!grown) {
+                free(line.fields);
+                free(line.text);
+                error = ENOMEM;
+
+                break;
+            }
+
+            *lines = grown;
+        }
+
+        (*lines)[(*count)++] = line;
+    }
+
+    free(buffer);
+    fclose(f);
+
+    if (error) {
+        freeManifest(*lines, *count);
+        *lines = NULL;
+        *count = 0;
+    }
+
+    return error;
+}
+
+/**
+ * Free the lines read by readManifest.
+ *
+ * @param lines The lines
+ * @param count The number of lines
+ */
+void freeManifest(ManifestLine * const lines, const int count)
+{
+    for (int i = 0; i < count; i++) {
+        free(lines[i].fields);
+        free(lines[i].text);
+    }
+
+    free(lines);
+}
+
+/**
+ * Compare two jobs for qsort, so larger grids come first, and jobs with the
+ * same size stay in manifest order.
+ *
+ * @param  a The first BatchOrder
+ * @param  b The second BatchOrder
+ *
+ * @return   Negative if a goes first, positive if b goes first
+ */
+static int compareBatchOrder(const void * const a, const void * const b)
+{
+    const BatchOrder * const first = (const BatchOrder *) a;
+    const BatchOrder * const second = (const BatchOrder *) b;
+
+    if (first->size != second->size) {
+        return first->size > second->size ? -1 : 1;
+    }
+
+    return first->job - second->job;
+}
+
+/**
+ * Record the first error of any worker.
+ *
+ * @param batchArgs BatchArgs shared by all workers
+ * @param error     The error, or 0 to do nothing
+ */
+static void setBatchError(BatchArgs * const batchArgs, const int error)
+{
+    if (!error) {
+        return;
+    }
+
+    pthread_mutex_lock(&batchArgs->lock);
+
+    if (!batchArgs->error) {
+        batchArgs->error = error;
+    }
+
+    pthread_mutex_unlock(&batchArgs->lock);
+}
+
+/**
+ * Pool task for the jobs run one per thread. Each worker creates a single
+ * thread solve context, then takes jobs (largest first) until there are
+ * none left.
+ *
+ * @param workerId The ID of the worker
+ * @param args     BatchArgs shared by all workers
+ */
+static void runSingleJobs(const int workerId, void * const args)
+{
+    // Every worker takes jobs from the same list
+    (void)workerId;
+
+    BatchArgs * const batchArgs = (BatchArgs *) args;
+
+    int error;
+    SolveContext * const context = createSolveContext(
+        batchArgs->options,
+        &error
+    );
+
+    if (error) {
+        setBatchError(batchArgs, error);
+
+        return;
+    }
+
+    while (1) {
+        pthread_mutex_lock(&batchArgs->lock);
+        const int next = batchArgs->next++;
+        pthread_mutex_unlock(&batchArgs->lock);
+
+        if (next >= batchArgs->count) {
+            break;
+        }
+
+        batchArgs->task(
+            batchArgs->order[next].job,
+            1,
+            context,
+            batchArgs->args
+        );
+    }
+
+    setBatchError(batchArgs, freeSolveContext(context));
+}
+
+/**
+ * Run the jobs of at least the split size, one at a time, each on all the
+ * threads.
+ *
+ * @param  order   The jobs, largest first
+ * @param  count   The number of jobs
+ * @param  options Options with the threads, spinCount and affinity to use
+ * @param  task    Called to run each job
+ * @param  args    Passed to every call of task
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+static int runSplitJobs(
+    const BatchOrder * const order,
+    const int count,
+    const SolveOptions * const options,
+    BatchTask task,
+    void * const args
+)
+{
+    int error;
+    SolveContext * const context = createSolveContext(options, &error);
+
+    if (error) {
+        return error;
+    }
+
+    for (int i = 0; i < count; i++) {
+        task(order[i].job, options->threads, context, args);
+    }
+
+    return freeSolveContext(context);
+}
+
+/**
+ * Run a batch of independent jobs on options->threads threads. Jobs whose
+ * grids have a dimension of at least splitSize are run first, one at a time,
+ * each split across all the threads. The rest are run one per thread, with
+ * each thread taking the largest job left whenever it finishes one, so the
+ * threads finish at about the same time. Each thread keeps a solve context
+ * for all its jobs, so only the first job on it pays to set one up.
+ *
+ * @param  sizes     The dimension of the grid of each job
+ * @param  jobs      The number of jobs
+ * @param  options   Options with the threads, spinCount and affinity to use
+ * @param  splitSize Dimension from which jobs are split across threads
+ * @param  task      Called to run each job
+ * @param  args      Passed to every call of task
+ *
+ * @return           0 on success, or an error code if the threads or
+ *                   contexts could not be created (some jobs may not have
+ *                   run)
+ */
+int runBatch(
+    const int * const sizes,
+    const int jobs,
+    const SolveOptions * const options,
+    const int splitSize,
+    BatchTask task,
+    void * const args
+)
+{
+    if (jobs == 0) {
+        return 0;
+    }
+
+    BatchOrder * const order = malloc(jobs * sizeof(BatchOrder));
+
+    if (!order) {
+        return ENOMEM;
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        order[i].size = sizes[i];
+        order[i].job = i;
+    }
+
+    qsort(order, jobs, sizeof(BatchOrder), compareBatchOrder);
+
+    // With one thread there is nothing to split
+    int splitJobs = 0;
+
+    while (options->threads > 1
+           && splitJobs < jobs
+           && order[splitJobs].size >= splitSize
+    ) {
+        splitJobs++;
+    }
+
+    int error = 0;
+
+    if (splitJobs > 0) {
+        error = runSplitJobs(order, splitJobs, options, task, args);
+    }
+
+    if (!error && splitJobs < jobs) {
+        const int singleJobs = jobs - splitJobs;
+
+        // Workers only wait for the next batch, so should not spin
+        SolveOptions poolOptions = *options;
+        poolOptions.threads = singleJobs < options->threads
+                              ? singleJobs
+                              : options->threads;
+        poolOptions.spinCount = 0;
+        poolOptions.context = NULL;
+
+        // Each worker's own context, on the thread the pool pinned it to
+        SolveOptions singleOptions = *options;
+        singleOptions.threads = 1;
+        singleOptions.spinCount = 0;
+        singleOptions.affinity = AFFINITY_NONE;
+        singleOptions.context = NULL;
+
+        BatchArgs batchArgs;
+        batchArgs.order = order + splitJobs;
+        batchArgs.count = singleJobs;
+        batchArgs.next = 0;
+        batchArgs.options = &singleOptions;
+        batchArgs.task = task;
+        batchArgs.args = args;
+        batchArgs.error = 0;
+
+        error = pthread_mutex_init(&batchArgs.lock, NULL);
+
+        if (!error) {
+            ThreadPool * const pool = createSolvePool(&poolOptions, &error);
+
+            if (!error) {
+                runThreadPool(pool, runSingleJobs, &batchArgs);
+
+                error = releaseSolvePool(&poolOptions, pool);
+
+                if (batchArgs.error) {
+                    error = batchArgs.error;
+                }
+            }
+
+            pthread_mutex_destroy(&batchArgs.lock);
+        }
+    }
+
+    free(order);
+
+    return error;
+}
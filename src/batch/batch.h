@@ -0,0 +1,79 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "../solve/solve.h"
+
+// One line of a job manifest, split into whitespace separated fields
+typedef struct {
+    int lineNumber; // Line of the manifest the job is on, from 1
+    int fieldCount; // Number of fields on the line
+    char ** fields; // The fields, pointing into text
+    char * text; // Copy of the line, with a 0 after each field
+} ManifestLine;
+
+/**
+ * Task run for each job of a batch, on whichever thread the job was given
+ * to. The job must be solved with the given number of threads and context.
+ */
+typedef void (*BatchTask)(
+    const int job,
+    const int threads,
+    SolveContext * const context,
+    void * const args
+);
+
+/**
+ * Read a job manifest: a text file with one job per line. Blank lines and
+ * lines starting with # are skipped, and the fields of every other line are
+ * separated by spaces or tabs. Should always be followed later in the
+ * calling code with freeManifest.
+ *
+ * @param  path  The path of the manifest
+ * @param  lines Set to the lines with at least one field, in order
+ * @param  count Set to the number of lines
+ *
+ * @return       0 on success, or an error code otherwise
+ */
+int readManifest(
+    const char * const path,
+    ManifestLine ** const lines,
+    int * const count
+);
+
+/**
+ * Free the lines read by readManifest.
+ *
+ * @param lines The lines
+ * @param count The number of lines
+ */
+void freeManifest(ManifestLine * const lines, const int count);
+
+/**
+ * Run a batch of independent jobs on options->threads threads. Jobs whose
+ * grids have a dimension of at least splitSize are run first, one at a time,
+ * each split across all the threads. The rest are run one per thread, with
+ * each thread taking the largest job left whenever it finishes one, so the
+ * threads finish at about the same time. Each thread keeps a solve context
+ * for all its jobs, so only the first job on it pays to set one up.
+ *
+ * @param  sizes     The dimension of the grid of each job
+ * @param  jobs      The number of jobs
+ * @param  options   Options with the threads, spinCount and affinity to use
+ * @param  splitSize Dimension from which jobs are split across threads
+ * @param  task      Called to run each job
+ * @param  args      Passed to every call of task
+ *
+ * @return           0 on success, or an error code if the threads or
+ *                   contexts could not be created (some jobs may not have
+ *                   run)
+ */
+int runBatch(
+    const int * const sizes,
+    const int jobs,
+    const SolveOptions * const options,
+    const int splitSize,
+    BatchTask task,
+    void * const args
+);
+
+#endif
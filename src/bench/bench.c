@@ -0,0 +1,629 @@
+/**
+ * Benchmark harness for solve, built and run by make bench.
+ *
+ * Runs every combination of grid size, configuration (see BenchConfig) and
+ * thread count given, each several times on the same generated grid, and
+ * writes one line of CSV per combination to stdout:
+ *
+ *   size, config, threads, repeats - the combination
+ *   sweeps                         - sweeps done by each run
+ *   best_seconds, median_seconds   - wall time of the solve alone
+ *   points_per_second              - interior points updated per second
+ *   gb_per_second                  - effective memory bandwidth
+ *   efficiency                     - parallel efficiency
+ *
+ * The rates are worked out from the median time. The bandwidth counts
+ * BYTES_PER_POINT per point per sweep, the least any sweep can move (each
+ * value read and written once), so it is a lower bound on what the memory
+ * system delivered. The parallel efficiency is the speedup over the smallest
+ * thread count run for the same size and configuration, divided by the ratio
+ * of thread counts, so it is exact when the smallest count is 1.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../affinity/affinity.h"
+#include "../array/array.h"
+#include "../generate/generate.h"
+#include "../solve/solve.h"
+#include "../utility/utility.h"
+
+#define HELP "Usage: bin/bench [options]\n"\
+             "Writes CSV of solve timings to stdout.\n"\
+             "Options:\n"\
+             " --sizes=N,N,...        Grid sizes (default 256,512,1024).\n"\
+             " --threads=N,N,...      Thread counts (default powers of 2\n"\
+             "                        up to the number of CPUs, and that\n"\
+             "                        number).\n"\
+             " --configs=NAME,...     Configurations to run: dispatch,\n"\
+             "                        bands, blocked, bands-split,\n"\
+             "                        blocked-split or jacobi (default\n"\
+             "                        dispatch,bands,blocked).\n"\
+             " --repeats=N            Runs of each combination (default 3).\n"\
+             " --precision=X          Precision to work to (default 0.001).\n"\
+             " --omega=X|auto         Relaxation factor (default auto).\n"\
+             " --seed=N               Seed for generated grids (default 1).\n"\
+             " --affinity=none|compact|scatter\n"\
+             "                        How to pin threads to CPUs (default\n"\
+             "                        none).\n"
+
+#define INVALID_LIST "%s must be a list of integers of at least %d\n"
+
+#define INVALID_CONFIG "Unknown configuration: %.*s\n"
+
+#define INVALID_REPEATS "Repeats must be an integer greater than 0\n"
+
+#define INVALID_PRECISION "Precision must be a decimal greater than 0\n"
+
+#define INVALID_OMEGA "Omega must be auto or a decimal between 0 and 2\n"
+
+#define INVALID_SEED "Seed must be a non-negative integer\n"
+
+#define INVALID_AFFINITY "Affinity must be one of none, compact or scatter\n"
+
+#define INVALID_OPTION "Unknown option: %s\n"
+
+#define OUT_OF_MEMORY "Not enough memory to run the benchmark\n"
+
+#define SOLVE_ERROR "Something went wrong. Error code: %d\n"
+
+#define CSV_HEADER "size,config,threads,repeats,sweeps,best_seconds,"\
+                   "median_seconds,points_per_second,gb_per_second,"\
+                   "efficiency\n"
+
+// Most entries in a list option
+#define MAX_LIST 32
+
+// Smallest grid with an interior point
+#define MIN_SIZE 3
+
+// Bytes moved per point per sweep in the least traffic a sweep can cause:
+// one double read and one written
+#define BYTES_PER_POINT (2 * sizeof(double))
+
+// A named combination of solve options to benchmark
+typedef struct {
+    const char * name; // Name used in --configs and the CSV
+    SolveMethod method; // The numerical method
+    SolveMode mode; // How work is split between threads
+    SolveLayout layout; // How the grid is stored while solving
+} BenchConfig;
+
+static const BenchConfig CONFIGS[] = {
+    {
+        "dispatch",
+        SOLVE_METHOD_RELAX,
+        SOLVE_MODE_DISPATCH,
+        SOLVE_LAYOUT_NATURAL
+    },
+    {
+        "bands",
+        SOLVE_METHOD_RELAX,
+        SOLVE_MODE_BANDS,
+        SOLVE_LAYOUT_NATURAL
+    },
+    {
+        "blocked",
+        SOLVE_METHOD_RELAX,
+        SOLVE_MODE_BLOCKED,
+        SOLVE_LAYOUT_NATURAL
+    },
+    {
+        "bands-split",
+        SOLVE_METHOD_RELAX,
+        SOLVE_MODE_BANDS,
+        SOLVE_LAYOUT_SPLIT
+    },
+    {
+        "blocked-split",
+        SOLVE_METHOD_RELAX,
+        SOLVE_MODE_BLOCKED,
+        SOLVE_LAYOUT_SPLIT
+    },
+    {
+        "jacobi",
+        SOLVE_METHOD_JACOBI,
+        SOLVE_MODE_BANDS,
+        SOLVE_LAYOUT_NATURAL
+    }
+};
+
+#define CONFIG_COUNT (int)(sizeof(CONFIGS) / sizeof(CONFIGS[0]))
+
+// The matrix of runs to do
+typedef struct {
+    int sizes[MAX_LIST]; // Grid dimensions
+    int sizeCount; // Number of grid dimensions
+    int threads[MAX_LIST]; // Thread counts, in increasing order
+    int threadCount; // Number of thread counts
+    const BenchConfig * configs[MAX_LIST]; // Configurations
+    int configCount; // Number of configurations
+    int repeats; // Runs of each combination
+    double precision; // Precision to work to
+    double omega; // Relaxation factor, or SOLVE_OMEGA_AUTO
+    unsigned long long seed; // Seed of the generated grids
+    AffinityPolicy affinity; // How workers are pinned to CPUs
+} BenchOptions;
+
+/**
+ * Parse a comma separated list of integers.
+ *
+ * @param  value   The list
+ * @param  minimum The smallest integer allowed in the list
+ * @param  values  Set to the integers in the list
+ * @param  count   Set to the number of integers in the list
+ *
+ * @return         0 if success, -1 if the list is invalid or too long
+ */
+static int parseIntList(
+    const char * value,
+    const int minimum,
+    int * const values,
+    int * const count
+)
+{
+    *count = 0;
+
+    while (1) {
+        char *end;
+        const long parsed = strtol(value, &end, 10);
+
+        if (end == value
+            || parsed < minimum
+            || parsed > INT_MAX
+            || (*end != ',' && *end != '\0')
+            || *count == MAX_LIST
+        ) {
+            return -1;
+        }
+
+        values[(*count)++] = (int)parsed;
+
+        if (*end == '\0') {
+            return 0;
+        }
+
+        value = end + 1;
+    }
+}
+
+/**
+ * Parse a comma separated list of configuration names. Prints an error
+ * message if a name is unknown.
+ *
+ * @param  value   The list
+ * @param  configs Set to the configurations in the list
+ * @param  count   Set to the number of configurations in the list
+ *
+ * @return         0 if success, -1 if error
+ */
+static int parseConfigList(
+    const char * value,
+    const BenchConfig ** const configs,
+    int * const count
+)
+{
+    *count = 0;
+
+    while (1) {
+        const size_t length = strcspn(value, ",");
+        const BenchConfig *config = NULL;
+
+        for (int i = 0; i < CONFIG_COUNT; i++) {
+            if (strlen(CONFIGS[i].name) == length
+                && strncmp(CONFIGS[i].name, value, length) == 0
+            ) {
+                config = &CONFIGS[i];
+            }
+        }
+
+        if (!config || *count == MAX_LIST) {
+            printf(INVALID_CONFIG, (int)length, value);
+
+            return -1;
+        }
+
+        configs[(*count)++] = config;
+
+        if (value[length] == '\0') {
+            return 0;
+        }
+
+        value += length + 1;
+    }
+}
+
+/**
+ * Compare two ints, for qsort.
+ *
+ * @param  a Pointer to the first int
+ * @param  b Pointer to the second int
+ *
+ * @return   Negative, zero or positive as a is less than, equal to or more
+ *           than b
+ */
+static int compareInts(const void * const a, const void * const b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+/**
+ * Compare two doubles, for qsort.
+ *
+ * @param  a Pointer to the first double
+ * @param  b Pointer to the second double
+ *
+ * @return   Negative, zero or positive as a is less than, equal to or more
+ *           than b
+ */
+static int compareDoubles(const void * const a, const void * const b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Set the given options to their defaults.
+ *
+ * @param options The options to set
+ */
+static void setDefaultBenchOptions(BenchOptions * const options)
+{
+    options->sizes[0] = 256;
+    options->sizes[1] = 512;
+    options->sizes[2] = 1024;
+    options->sizeCount = 3;
+
+    const int cpus = getAvailableCpus();
+
+    options->threadCount = 0;
+
+    for (int threads = 1; threads < cpus; threads *= 2) {
+        options->threads[options->threadCount++] = threads;
+    }
+
+    options->threads[options->threadCount++] = cpus;
+
+    options->configs[0] = &CONFIGS[0];
+    options->configs[1] = &CONFIGS[1];
+    options->configs[2] = &CONFIGS[2];
+    options->configCount = 3;
+
+    options->repeats = 3;
+    options->precision = 0.001;
+    options->omega = SOLVE_OMEGA_AUTO;
+    options->seed = 1;
+    options->affinity = AFFINITY_NONE;
+}
+
+/**
+ * Parse the command line arguments into the given options. Prints an error
+ * message if an option is unknown or invalid.
+ *
+ * @param  args    Number of command line arguments
+ * @param  argv    Array of command line arguments
+ * @param  options The options to update
+ *
+ * @return         0 if success, -1 if error
+ */
+static int parseBenchOptions(
+    int args,
+    char *argv[],
+    BenchOptions * const options
+)
+{
+    const char *value;
+
+    for (int i = 1; i < args; i++) {
+        if ((value = getOptionValue(argv[i], "--sizes"))) {
+            if (parseIntList(
+                value,
+                MIN_SIZE,
+                options->sizes,
+                &options->sizeCount
+            )) {
+                printf(INVALID_LIST, "Sizes", MIN_SIZE);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--threads"))) {
+            if (parseIntList(
+                value,
+                1,
+                options->threads,
+                &options->threadCount
+            )) {
+                printf(INVALID_LIST, "Threads", 1);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--configs"))) {
+            if (parseConfigList(
+                value,
+                options->configs,
+                &options->configCount
+            )) {
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--repeats"))) {
+            options->repeats = atoi(value);
+
+            if (options->repeats <= 0) {
+                printf(INVALID_REPEATS);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--precision"))) {
+            options->precision = atof(value);
+
+            if (options->precision <= 0) {
+                printf(INVALID_PRECISION);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--omega"))) {
+            if (strcmp(value, "auto") == 0) {
+                options->omega = SOLVE_OMEGA_AUTO;
+            } else {
+                options->omega = atof(value);
+
+                if (options->omega <= 0 || options->omega >= 2) {
+                    printf(INVALID_OMEGA);
+
+                    return -1;
+                }
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--seed"))) {
+            char *end;
+
+            options->seed = strtoull(value, &end, 10);
+
+            if (value[0] == '\0' || value[0] == '-' || *end != '\0') {
+                printf(INVALID_SEED);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--affinity"))) {
+            if (strcmp(value, "none") == 0) {
+                options->affinity = AFFINITY_NONE;
+            } else if (strcmp(value, "compact") == 0) {
+                options->affinity = AFFINITY_COMPACT;
+            } else if (strcmp(value, "scatter") == 0) {
+                options->affinity = AFFINITY_SCATTER;
+            } else {
+                printf(INVALID_AFFINITY);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        printf(INVALID_OPTION, argv[i]);
+
+        return -1;
+    }
+
+    // So the smallest thread count, the efficiency baseline, is run first
+    qsort(
+        options->threads,
+        options->threadCount,
+        sizeof(int),
+        compareInts
+    );
+
+    return 0;
+}
+
+/**
+ * Run every configuration and thread count on one grid size, and write a
+ * line of CSV for each.
+ *
+ * @param  input   The generated grid to solve (left unchanged)
+ * @param  values  A grid of the same size to solve in
+ * @param  options The matrix of runs to do
+ * @param  times   Space for options->repeats times
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+static int runSize(
+    const Grid * const input,
+    Grid * const values,
+    const BenchOptions * const options,
+    double * const times
+)
+{
+    const int dimension = input->dimension;
+    const double points = (double)(dimension - 2) * (dimension - 2);
+
+    for (int c = 0; c < options->configCount; c++) {
+        const BenchConfig * const config = options->configs[c];
+
+        // Median time of the smallest thread count, the efficiency baseline
+        double baseTime = 0;
+
+        for (int t = 0; t < options->threadCount; t++) {
+            SolveOptions solveOptions;
+            setDefaultSolveOptions(&solveOptions);
+
+            solveOptions.threads = options->threads[t];
+            solveOptions.precision = options->precision;
+            solveOptions.method = config->method;
+            solveOptions.mode = config->mode;
+            solveOptions.layout = config->layout;
+            solveOptions.omega = options->omega;
+            solveOptions.affinity = options->affinity;
+
+            // Repeats reuse the pool and scratch buffers, as an embedding
+            // pipeline would, so only the first one pays to set them up
+            int error;
+            SolveContext * const context = createSolveContext(
+                &solveOptions,
+                &error
+            );
+
+            if (error) {
+                return error;
+            }
+
+            SolveResult result;
+
+            for (int r = 0; r < options->repeats && !error; r++) {
+                copyGrid(values, input);
+
+                const double start = getMonotonicTime();
+                error = solveWithContext(context, values, &result);
+                times[r] = getMonotonicTime() - start;
+            }
+
+            const int contextError = freeSolveContext(context);
+
+            if (error || contextError) {
+                return error ? error : contextError;
+            }
+
+            qsort(times, options->repeats, sizeof(double), compareDoubles);
+
+            const double median = options->repeats & 1
+                                  ? times[options->repeats / 2]
+                                  : (times[options->repeats / 2 - 1]
+                                     + times[options->repeats / 2]) / 2;
+
+            if (t == 0) {
+                baseTime = median;
+            }
+
+            const double updates = points * result.iterations;
+            const double efficiency = baseTime * options->threads[0]
+                                      / (median * options->threads[t]);
+
+            printf(
+                "%d,%s,%d,%d,%d,%.6f,%.6f,%.4g,%.4g,%.3f\n",
+                dimension,
+                config->name,
+                options->threads[t],
+                options->repeats,
+                result.iterations,
+                times[0],
+                median,
+                updates / median,
+                updates * BYTES_PER_POINT / median / 1e9,
+                efficiency
+            );
+
+            fflush(stdout);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Main function. Parses the options, then runs the whole matrix, writing CSV
+ * to stdout as it goes.
+ *
+ * @param  args Number of command line arguments
+ * @param  argv Array of command line arguments
+ * @return      0 if success, -1 if error.
+ */
+int main(int args, char *argv[])
+{
+    for (int i = 1; i < args; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf(HELP);
+
+            return 0;
+        }
+    }
+
+    BenchOptions options;
+    setDefaultBenchOptions(&options);
+
+    if (parseBenchOptions(args, argv, &options) == -1) {
+        return -1;
+    }
+
+    double * const times = malloc(options.repeats * sizeof(double));
+
+    if (!times) {
+        printf(OUT_OF_MEMORY);
+
+        return -1;
+    }
+
+    printf(CSV_HEADER);
+
+    int error = 0;
+
+    for (int s = 0; s < options.sizeCount && !error; s++) {
+        Grid * const input = createGrid(options.sizes[s]);
+        Grid * const values = createGrid(options.sizes[s]);
+
+        if (!input || !values) {
+            error = ENOMEM;
+        } else {
+            error = generateGrid(
+                input,
+                GENERATE_UNIFORM,
+                options.seed,
+                options.threads[options.threadCount - 1]
+            );
+        }
+
+        if (!error) {
+            error = runSize(input, values, &options, times);
+        }
+
+        if (error == ENOMEM) {
+            fprintf(stderr, OUT_OF_MEMORY);
+        } else if (error) {
+            fprintf(stderr, SOLVE_ERROR, error);
+        }
+
+        if (values) {
+            freeGrid(values);
+        }
+
+        if (input) {
+            freeGrid(input);
+        }
+    }
+
+    free(times);
+
+    return error ? -1 : 0;
+}
@@ -0,0 +1,446 @@
+/**
+ * Checkpoints of long solves, so a job that hits its time limit can be
+ * resumed (see --resume in src/main.c).
+ *
+ * Taking a checkpoint only costs the solve a copy of the grid into a
+ * snapshot: the solver copies the grid, hands the snapshot to a writer thread
+ * and carries on sweeping. The writer saves it to a temporary file and
+ * renames it over the checkpoint file, so the checkpoint file is always
+ * either the old or the new checkpoint, never half written. While a snapshot
+ * is being written no new checkpoint is due, so a slow disk means fewer
+ * checkpoints rather than a stalled solve.
+ */
+
+// Needed for fsync when compiling with -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../array/array.h"
+#include "../utility/utility.h"
+#include "checkpoint.h"
+
+// Appended to the checkpoint path for the file being written
+#define TEMPORARY_SUFFIX ".tmp"
+
+struct Checkpointer {
+    char * path; // Path of the checkpoint file
+    char * temporaryPath; // Path of the file being written
+    Grid * snapshot; // Copy of the grid being written (or about to be)
+    double interval; // Seconds between checkpoints
+    double lastTime; // Time of the last checkpoint (or creation)
+    CheckpointHeader header; // Header of the snapshot
+    int sweepOffset; // Sweeps done before this solve
+    int written; // Checkpoints written
+    int error; // Error code of the first failed write, or 0
+    int pending; // Flag - is there a snapshot to write
+    int shutdown; // Flag - should the writer thread exit
+    pthread_mutex_t lock; // Lock on pending, shutdown, written and error
+    pthread_cond_t changed; // Signalled when pending or shutdown change
+    pthread_t writer; // The writer thread
+};
+
+/**
+ * Write the snapshot to the temporary file, then rename it over the
+ * checkpoint file.
+ *
+ * @param  checkpointer The checkpointer
+ *
+ * @return              0 on success, or an error code otherwise
+ */
+static int writeSnapshot(Checkpointer * const checkpointer)
+{
+    const Grid * const snapshot = checkpointer->snapshot;
+    const size_t values = (size_t)snapshot->dimension * snapshot->stride;
+
+    FILE * const f = fopen(checkpointer->temporaryPath, "wb");
+
+    if (!f) {
+        return errno;
+    }
+
+    int error = 0;
+
+    if (fwrite(&checkpointer->header, sizeof(CheckpointHeader), 1, f) != 1
+        || fwrite(snapshot->data, sizeof(double), values, f) != values
+        || fflush(f) != 0
+        || fsync(fileno(f)) != 0
+    ) {
+        error = EIO;
+    }
+
+    if (fclose(f) != 0 && !error) {
+        error = EIO;
+    }
+
+    if (!error && rename(checkpointer->temporaryPath, checkpointer->path)) {
+        error = errno;
+    }
+
+    return error;
+}
+
+/**
+ * Main loop of the writer thread. Waits for a snapshot, writes it, and marks
+ * it as written so the next checkpoint can be taken.
+ *
+ * @param  args The checkpointer
+ *
+ * @return      NULL
+ */
+static void *writerLoop(void *args)
+{
+    Checkpointer * const checkpointer = (Checkpointer *) args;
+
+    pthread_mutex_lock(&checkpointer->lock);
+
+    while (1) {
+        while (!checkpointer->pending && !checkpointer->shutdown) {
+            pthread_cond_wait(&checkpointer->changed, &checkpointer->lock);
+        }
+
+        if (!checkpointer->pending) {
+            break;
+        }
+
+        // The solver does not touch the snapshot while it is pending
+        pthread_mutex_unlock(&checkpointer->lock);
+        const int error = writeSnapshot(checkpointer);
+        pthread_mutex_lock(&checkpointer->lock);
+
+        if (error && !checkpointer->error) {
+            checkpointer->error = error;
+        }
+
+        if (!error) {
+            checkpointer->written++;
+        }
+
+        checkpointer->pending = 0;
+        pthread_cond_broadcast(&checkpointer->changed);
+    }
+
+    pthread_mutex_unlock(&checkpointer->lock);
+
+    return NULL;
+}
+
+/**
+ * Create a checkpointer, which saves snapshots of a grid to a file from a
+ * thread of its own, so the solve does not wait for the file to be written.
+ * Should always be followed later in the calling code with freeCheckpointer.
+ *
+ * @param  path        The path of the checkpoint file to write
+ * @param  values      The grid that will be solved (its edges are copied)
+ * @param  interval    Seconds to wait between checkpoints
+ * @param  sweepOffset Sweeps done before this solve (if resumed)
+ * @param  error       Set to 0 on success, or an error code otherwise
+ *
+ * @return             Pointer to the checkpointer, or NULL on error
+ */
+Checkpointer *createCheckpointer(
+    const char * const path,
+    const Grid * const values,
+    const double interval,
+    const int sweepOffset,
+    int * const error
+)
+{
+    Checkpointer * const checkpointer = calloc(1, sizeof(Checkpointer));
+
+    if (!checkpointer) {
+        *error = ENOMEM;
+
+        return NULL;
+    }
+
+    checkpointer->path = malloc(strlen(path) + 1);
+    checkpointer->temporaryPath = malloc(
+        strlen(path) + sizeof(TEMPORARY_SUFFIX)
+    );
+    checkpointer->snapshot = createGrid(values->dimension);
+
+    if (!checkpointer->path
+        || !checkpointer->temporaryPath
+        || !checkpointer->snapshot
+    ) {
+        *error = ENOMEM;
+    } else {
+        *error = 0;
+    }
+
+    if (!*error) {
+        strcpy(checkpointer->path, path);
+        strcpy(checkpointer->temporaryPath, path);
+        strcat(checkpointer->temporaryPath, TEMPORARY_SUFFIX);
+
+        copyGrid(checkpointer->snapshot, values);
+
+        memcpy(
+            checkpointer->header.magic,
+            CHECKPOINT_MAGIC,
+            sizeof(checkpointer->header.magic)
+        );
+        checkpointer->header.version = CHECKPOINT_VERSION;
+        checkpointer->header.dimension = values->dimension;
+        checkpointer->header.stride = checkpointer->snapshot->stride;
+
+        checkpointer->interval = interval;
+        checkpointer->lastTime = getMonotonicTime();
+        checkpointer->sweepOffset = sweepOffset;
+
+        *error = pthread_mutex_init(&checkpointer->lock, NULL);
+    }
+
+    if (!*error) {
+        *error = pthread_cond_init(&checkpointer->changed, NULL);
+
+        if (*error) {
+            pthread_mutex_destroy(&checkpointer->lock);
+        }
+    }
+
+    if (!*error) {
+        *error = pthread_create(
+            &checkpointer->writer,
+            NULL,
+            writerLoop,
+            checkpointer
+        );
+
+        if (*error) {
+            pthread_cond_destroy(&checkpointer->changed);
+            pthread_mutex_destroy(&checkpointer->lock);
+        }
+    }
+
+    if (*error) {
+        if (checkpointer->snapshot) {
+            freeGrid(checkpointer->snapshot);
+        }
+
+        free(checkpointer->temporaryPath);
+        free(checkpointer->path);
+        free(checkpointer);
+
+        return NULL;
+    }
+
+    return checkpointer;
+}
+
+/**
+ * Check whether a checkpoint should be taken now, i.e. the interval has
+ * passed since the last one and the last one has been written. If so, the
+ * caller must copy the grid into getCheckpointGrid, then call
+ * commitCheckpoint. Only one thread may call this.
+ *
+ * @param  checkpointer The checkpointer
+ *
+ * @return              1 if a checkpoint is due, 0 otherwise
+ */
+int isCheckpointDue(Checkpointer * const checkpointer)
+{
+    const double elapsed = getMonotonicTime() - checkpointer->lastTime;
+
+    if (elapsed < checkpointer->interval) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&checkpointer->lock);
+    const int pending = checkpointer->pending;
+    pthread_mutex_unlock(&checkpointer->lock);
+
+    return !pending;
+}
+
+/**
+ * Get the grid to copy the interior of the values into for a checkpoint. Its
+ * edges already hold the fixed edges of the values.
+ *
+ * @param  checkpointer The checkpointer
+ *
+ * @return              The snapshot grid
+ */
+Grid *getCheckpointGrid(Checkpointer * const checkpointer)
+{
+    return checkpointer->snapshot;
+}
+
+/**
+ * Hand the snapshot grid to the writer thread to save, and return straight
+ * away.
+ *
+ * @param checkpointer The checkpointer
+ * @param sweeps       Sweeps done in this solve before the snapshot
+ * @param change       Largest change of any point in the last sweep
+ */
+void commitCheckpoint(
+    Checkpointer * const checkpointer,
+    const int sweeps,
+    const double change
+)
+{
+    pthread_mutex_lock(&checkpointer->lock);
+
+    checkpointer->header.sweeps = checkpointer->sweepOffset + sweeps;
+    checkpointer->header.change = change;
+    checkpointer->pending = 1;
+    checkpointer->lastTime = getMonotonicTime();
+
+    pthread_cond_broadcast(&checkpointer->changed);
+    pthread_mutex_unlock(&checkpointer->lock);
+}
+
+/**
+ * Get the number of checkpoints written so far.
+ *
+ * @param  checkpointer The checkpointer
+ *
+ * @return              The number of checkpoint files written
+ */
+int getCheckpointsWritten(Checkpointer * const checkpointer)
+{
+    pthread_mutex_lock(&checkpointer->lock);
+    const int written = checkpointer->written;
+    pthread_mutex_unlock(&checkpointer->lock);
+
+    return written;
+}
+
+/**
+ * Wait for any checkpoint being written to finish, then free the given
+ * checkpointer.
+ *
+ * @param  checkpointer The checkpointer to free
+ *
+ * @return              0 if every checkpoint was written, or the error code of
+ *                      the first that failed
+ */
+int freeCheckpointer(Checkpointer * const checkpointer)
+{
+    // The writer finishes any pending snapshot before it sees the shutdown
+    pthread_mutex_lock(&checkpointer->lock);
+    checkpointer->shutdown = 1;
+    pthread_cond_broadcast(&checkpointer->changed);
+    pthread_mutex_unlock(&checkpointer->lock);
+
+    pthread_join(checkpointer->writer, NULL);
+
+    const int error = checkpointer->error;
+
+    pthread_cond_destroy(&checkpointer->changed);
+    pthread_mutex_destroy(&checkpointer->lock);
+    freeGrid(checkpointer->snapshot);
+    free(checkpointer->temporaryPath);
+    free(checkpointer->path);
+    free(checkpointer);
+
+    return error;
+}
+
+/**
+ * Read the header of a checkpoint file and check that it is valid.
+ *
+ * @param  f      The checkpoint file, at its start
+ * @param  header Set to the header
+ *
+ * @return        1 if the header is valid, 0 otherwise
+ */
+static int readHeader(FILE * const f, CheckpointHeader * const header)
+{
+    if (fread(header, sizeof(*header), 1, f) != 1
+        || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0
+        || header->version != CHECKPOINT_VERSION
+        || header->phase != 0
+        || header->sweeps > INT_MAX
+        || header->dimension == 0
+        || header->dimension > INT_MAX
+    ) {
+        return 0;
+    }
+
+    return header->stride == (uint64_t)getGridStride((int)header->dimension);
+}
+
+/**
+ * Read the dimension of the grid in a checkpoint file, without loading the
+ * values, so that the grid to load it into can be created and first touched
+ * (see firstTouchGrid in src/solve/solve.h) first.
+ *
+ * @param  path      The path of the checkpoint file
+ * @param  dimension Set to the number of rows (and columns) on success
+ *
+ * @return           0 on success, EINVAL if the file is not a valid
+ *                   checkpoint, or another error code otherwise
+ */
+int readCheckpointDimension(const char * const path, int * const dimension)
+{
+    FILE * const f = fopen(path, "rb");
+
+    if (!f) {
+        return errno;
+    }
+
+    CheckpointHeader header;
+    const int valid = readHeader(f, &header);
+
+    fclose(f);
+
+    if (!valid) {
+        return EINVAL;
+    }
+
+    *dimension = (int)header.dimension;
+
+    return 0;
+}
+
+/**
+ * Load the grid and sweep count from a checkpoint file into a grid of the
+ * dimension given by readCheckpointDimension.
+ *
+ * @param  path   The path of the checkpoint file
+ * @param  values The grid to load the values into
+ * @param  sweeps Set to the sweeps done before the checkpoint on success
+ *
+ * @return        0 on success, EINVAL if the file is not a valid checkpoint
+ *                of a grid the size of values, or another error code
+ *                otherwise
+ */
+int loadCheckpoint(
+    const char * const path,
+    Grid * const values,
+    int * const sweeps
+)
+{
+    FILE * const f = fopen(path, "rb");
+
+    if (!f) {
+        return errno;
+    }
+
+    CheckpointHeader header;
+    const size_t count = (size_t)values->dimension * values->stride;
+
+    if (!readHeader(f, &header)
+        || header.dimension != (uint64_t)values->dimension
+        || fread(values->data, sizeof(double), count, f) != count
+    ) {
+        fclose(f);
+
+        return EINVAL;
+    }
+
+    fclose(f);
+
+    *sweeps = (int)header.sweeps;
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+
+#include "../array/array.h"
+
+// First bytes of every checkpoint file
+#define CHECKPOINT_MAGIC "RELAXCKP"
+
+// Version of the format described by CheckpointHeader
+#define CHECKPOINT_VERSION 1
+
+/**
+ * Header at the start of a checkpoint file, in the byte order of the machine.
+ * The grid follows at offset sizeof(CheckpointHeader), dimension rows of
+ * stride doubles. Checkpoints are only taken between sweeps, so the colour
+ * phase is always 0 (the next half-sweep is of 'E' points).
+ */
+typedef struct {
+    char magic[8]; // CHECKPOINT_MAGIC, without a terminating 0
+    uint32_t version; // CHECKPOINT_VERSION
+    uint32_t phase; // Colour of the next half-sweep (0 for 'E' points)
+    uint64_t sweeps; // Sweeps done before the checkpoint
+    double change; // Largest change of any point in the last sweep
+    uint64_t dimension; // Number of rows (and columns) of the grid
+    uint64_t stride; // Distance between the start of consecutive rows
+} CheckpointHeader;
+
+typedef struct Checkpointer Checkpointer;
+
+/**
+ * Create a checkpointer, which saves snapshots of a grid to a file from a
+ * thread of its own, so the solve does not wait for the file to be written.
+ * Should always be followed later in the calling code with freeCheckpointer.
+ *
+ * @param  path        The path of the checkpoint file to write
+ * @param  values      The grid that will be solved (its edges are copied)
+ * @param  interval    Seconds to wait between checkpoints
+ * @param  sweepOffset Sweeps done before this solve (if resumed)
+ * @param  error       Set to 0 on success, or an error code otherwise
+ *
+ * @return             Pointer to the checkpointer, or NULL on error
+ */
+Checkpointer *createCheckpointer(
+    const char * const path,
+    const Grid * const values,
+    const double interval,
+    const int sweepOffset,
+    int * const error
+);
+
+/**
+ * Check whether a checkpoint should be taken now, i.e. the interval has
+ * passed since the last one and the last one has been written. If so, the
+ * caller must copy the grid into getCheckpointGrid, then call
+ * commitCheckpoint. Only one thread may call this.
+ *
+ * @param  checkpointer The checkpointer
+ *
+ * @return              1 if a checkpoint is due, 0 otherwise
+ */
+int isCheckpointDue(Checkpointer * const checkpointer);
+
+/**
+ * Get the grid to copy the interior of the values into for a checkpoint. Its
+ * edges already hold the fixed edges of the values.
+ *
+ * @param  checkpointer The checkpointer
+ *
+ * @return              The snapshot grid
+ */
+Grid *getCheckpointGrid(Checkpointer * const checkpointer);
+
+/**
+ * Hand the snapshot grid to the writer thread to save, and return straight
+ * away.
+ *
+ * @param checkpointer The checkpointer
+ * @param sweeps       Sweeps done in this solve before the snapshot
+ * @param change       Largest change of any point in the last sweep
+ */
+void commitCheckpoint(
+    Checkpointer * const checkpointer,
+    const int sweeps,
+    const double change
+);
+
+/**
+ * Get the number of checkpoints written so far.
+ *
+ * @param  checkpointer The checkpointer
+ *
+ * @return              The number of checkpoint files written
+ */
+int getCheckpointsWritten(Checkpointer * const checkpointer);
+
+/**
+ * Wait for any checkpoint being written to finish, then free the given
+ * checkpointer.
+ *
+ * @param  checkpointer The checkpointer to free
+ *
+ * @return              0 if every checkpoint was written, or the error code of
+ *                      the first that failed
+ */
+int freeCheckpointer(Checkpointer * const checkpointer);
+
+/**
+ * Read the dimension of the grid in a checkpoint file, without loading the
+ * values, so that the grid to load it into can be created and first touched
+ * (see firstTouchGrid in src/solve/solve.h) first.
+ *
+ * @param  path      The path of the checkpoint file
+ * @param  dimension Set to the number of rows (and columns) on success
+ *
+ * @return           0 on success, EINVAL if the file is not a valid
+ *                   checkpoint, or another error code otherwise
+ */
+int readCheckpointDimension(const char * const path, int * const dimension);
+
+/**
+ * Load the grid and sweep count from a checkpoint file into a grid of the
+ * dimension given by readCheckpointDimension.
+ *
+ * @param  path   The path of the checkpoint file
+ * @param  values The grid to load the values into
+ * @param  sweeps Set to the sweeps done before the checkpoint on success
+ *
+ * @return        0 on success, EINVAL if the file is not a valid checkpoint
+ *                of a grid the size of values, or another error code
+ *                otherwise
+ */
+int loadCheckpoint(
+    const char * const path,
+    Grid * const values,
+    int * const sweeps
+);
+
+#endif
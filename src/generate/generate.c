@@ -0,0 +1,317 @@
+/**
+ * Synthetic problems of any size, for testing how the solver scales beyond
+ * the built-in problems (see src/problem/problem.c).
+ *
+ * Random values come from a counter-based generator: the value for a point
+ * is a hash (the SplitMix64 finaliser) of the seed and the point's index in
+ * the grid. There is no generator state to share or split between threads,
+ * and the grid does not depend on how the rows are divided up.
+ *
+ * Smooth fields are sums of waves sin(a * y + b * x + phase), which are
+ * worked out as sin(a * y) cos(b * x + phase) + cos(a * y) sin(b * x + phase)
+ * from a table per column and values per row, so there are no calls to sin
+ * or cos per point.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "generate.h"
+
+// Local definition, as M_PI is not part of C99
+#define PI 3.14159265358979323846
+
+// Number of sine waves added up for GENERATE_SMOOTH
+#define SMOOTH_WAVES 4
+
+// Highest frequency (in whole waves across the grid) for GENERATE_SMOOTH
+#define SMOOTH_MAX_FREQUENCY 4
+
+// Largest value generated (the smallest is 0)
+#define GENERATE_MAX_VALUE 100.0
+
+// One sine wave of a GENERATE_SMOOTH field
+typedef struct {
+    double amplitude; // Weight of the wave, all weights add up to 1
+    double rowFrequency; // Radians per row, as a fraction of the grid
+    double colFrequency; // Radians per column, as a fraction of the grid
+    double phase; // Phase in radians
+} Wave;
+
+// struct to pass multiple arguments to the pool task
+typedef struct {
+    Grid * values; // The grid to fill
+    GenerateDistribution distribution; // The kind of grid to fill in
+    uint64_t seedHash; // The hash of the seed for the random values
+    int threads; // The number of workers
+    Wave waves[SMOOTH_WAVES]; // Waves for GENERATE_SMOOTH
+    double * colSin; // sin(b * x + phase) of each wave at each column, for
+                     // GENERATE_SMOOTH, indexed by wave * dimension + col
+    double * colCos; // cos(b * x + phase), in the same way
+} GenerateArgs;
+
+/**
+ * Hash a 64 bit value with the SplitMix64 finaliser. Consecutive inputs give
+ * unrelated outputs.
+ *
+ * @param  value The value to hash
+ *
+ * @return       The hash
+ */
+static uint64_t mix(uint64_t value)
+{
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+
+    return value ^ (value >> 31);
+}
+
+/**
+ * Get the random number for a given counter value and seed.
+ *
+ * @param  seedHash The hash (with mix) of the seed
+ * @param  counter  The counter (e.g. the index of a point)
+ *
+ * @return          Uniformly random number in [0, 1)
+ */
+static double randomAt(const uint64_t seedHash, const uint64_t counter)
+{
+    // Top 53 bits, as many as a double holds
+    return (mix(seedHash ^ counter) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Pick the waves for a GENERATE_SMOOTH field from the seed. Uses counters
+ * past the end of any grid, so they are unrelated to the point values.
+ *
+ * @param waves    The waves to set
+ * @param seedHash The hash of the seed
+ */
+static void pickWaves(Wave * const waves, const uint64_t seedHash)
+{
+    const uint64_t base = UINT64_MAX - 4 * SMOOTH_WAVES;
+
+    double totalAmplitude = 0;
+
+    for (int i = 0; i < SMOOTH_WAVES; i++) {
+        const uint64_t counter = base + 4 * i;
+
+        waves[i].amplitude = 0.5 + randomAt(seedHash, counter);
+        waves[i].rowFrequency = 2 * PI * (int)(
+            1 + randomAt(seedHash, counter + 1) * SMOOTH_MAX_FREQUENCY
+        );
+        waves[i].colFrequency = 2 * PI * (int)(
+            1 + randomAt(seedHash, counter + 2) * SMOOTH_MAX_FREQUENCY
+        );
+        waves[i].phase = 2 * PI * randomAt(seedHash, counter + 3);
+
+        totalAmplitude += waves[i].amplitude;
+    }
+
+    for (int i = 0; i < SMOOTH_WAVES; i++) {
+        waves[i].amplitude /= totalAmplitude;
+    }
+}
+
+/**
+ * Get the position of a row or column as a fraction of the grid.
+ *
+ * @param  index     The index of the row or column
+ * @param  dimension The dimension of the grid
+ *
+ * @return           The position, 0 to 1
+ */
+static double getPosition(const int index, const int dimension)
+{
+    return dimension > 1 ? (double)index / (dimension - 1) : 0;
+}
+
+/**
+ * Work out the per-column part of each wave of a GENERATE_SMOOTH field.
+ *
+ * @param args GenerateArgs with the waves picked and the tables allocated
+ */
+static void fillColumnTables(GenerateArgs * const args)
+{
+    const int dimension = args->values->dimension;
+
+    for (int i = 0; i < SMOOTH_WAVES; i++) {
+        for (int col = 0; col < dimension; col++) {
+            const double angle = args->waves[i].colFrequency
+                                 * getPosition(col, dimension)
+                                 + args->waves[i].phase;
+
+            args->colSin[i * dimension + col] = sin(angle);
+            args->colCos[i * dimension + col] = cos(angle);
+        }
+    }
+}
+
+/**
+ * Fill a row of a GENERATE_SMOOTH field.
+ *
+ * @param args      GenerateArgs shared by all workers
+ * @param valuesRow The row to fill
+ * @param row       The index of the row
+ */
+static void fillSmoothRow(
+    const GenerateArgs * const args,
+    double * const valuesRow,
+    const int row
+)
+{
+    const int dimension = args->values->dimension;
+
+    double rowSin[SMOOTH_WAVES];
+    double rowCos[SMOOTH_WAVES];
+
+    for (int i = 0; i < SMOOTH_WAVES; i++) {
+        const double angle = args->waves[i].rowFrequency
+                             * getPosition(row, dimension);
+
+        rowSin[i] = args->waves[i].amplitude * sin(angle);
+        rowCos[i] = args->waves[i].amplitude * cos(angle);
+    }
+
+    for (int col = 0; col < dimension; col++) {
+        double sum = 0;
+
+        for (int i = 0; i < SMOOTH_WAVES; i++) {
+            sum += rowSin[i] * args->colCos[i * dimension + col]
+                   + rowCos[i] * args->colSin[i * dimension + col];
+        }
+
+        valuesRow[col] = GENERATE_MAX_VALUE * (sum + 1) / 2;
+    }
+}
+
+/**
+ * Fill a row with uniformly random values, apart from the edges of a
+ * GENERATE_EDGES grid.
+ *
+ * @param args      GenerateArgs shared by all workers
+ * @param valuesRow The row to fill
+ * @param row       The index of the row
+ */
+static void fillRandomRow(
+    const GenerateArgs * const args,
+    double * const valuesRow,
+    const int row
+)
+{
+    const int dimension = args->values->dimension;
+    const uint64_t rowCounter = (uint64_t)row * dimension;
+
+    for (int col = 0; col < dimension; col++) {
+        valuesRow[col] = GENERATE_MAX_VALUE * randomAt(
+            args->seedHash,
+            rowCounter + col
+        );
+    }
+
+    if (args->distribution == GENERATE_EDGES) {
+        const int last = dimension - 1;
+
+        for (int col = 0; col < dimension; col++) {
+            if (row == 0 || col == 0) {
+                valuesRow[col] = GENERATE_MAX_VALUE;
+            } else if (row == last || col == last) {
+                valuesRow[col] = 0;
+            }
+        }
+    }
+}
+
+/**
+ * Pool task that fills a contiguous block of rows of the grid, so each
+ * worker is the first to touch the memory of its rows.
+ *
+ * @param workerId The ID of the worker
+ * @param args     GenerateArgs shared by all workers
+ */
+static void runGenerate(const int workerId, void * const args)
+{
+    GenerateArgs * const generateArgs = (GenerateArgs *) args;
+    Grid * const values = generateArgs->values;
+    const int dimension = values->dimension;
+
+    const int rowStart = (int)((long long)dimension * workerId
+                               / generateArgs->threads);
+    const int rowEnd = (int)((long long)dimension * (workerId + 1)
+                             / generateArgs->threads);
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        if (generateArgs->distribution == GENERATE_SMOOTH) {
+            fillSmoothRow(generateArgs, gridRow(values, row), row);
+        } else {
+            fillRandomRow(generateArgs, gridRow(values, row), row);
+        }
+    }
+}
+
+/**
+ * Fill the given grid with a synthetic problem. Every point is worked out
+ * from the seed and its own position only (with a counter-based random
+ * number generator), so the rows can be filled by any number of threads and
+ * the same seed always gives the same grid.
+ *
+ * @param  values       The grid to fill
+ * @param  distribution The kind of grid to fill in
+ * @param  seed         The seed for the random values
+ * @param  threads      The number of threads to fill the grid with
+ *
+ * @return              0 on success, or an error code otherwise
+ */
+int generateGrid(
+    Grid * const values,
+    const GenerateDistribution distribution,
+    const uint64_t seed,
+    const int threads
+)
+{
+    GenerateArgs generateArgs;
+    generateArgs.values = values;
+    generateArgs.distribution = distribution;
+    generateArgs.seedHash = mix(seed);
+    generateArgs.threads = threads;
+    generateArgs.colSin = NULL;
+    generateArgs.colCos = NULL;
+
+    int error = 0;
+
+    if (distribution == GENERATE_SMOOTH) {
+        const size_t tableSize = (size_t)SMOOTH_WAVES * values->dimension;
+
+        pickWaves(generateArgs.waves, generateArgs.seedHash);
+
+        generateArgs.colSin = malloc(tableSize * sizeof(double));
+        generateArgs.colCos = malloc(tableSize * sizeof(double));
+
+        if (!generateArgs.colSin || !generateArgs.colCos) {
+            error = ENOMEM;
+        } else {
+            fillColumnTables(&generateArgs);
+        }
+    }
+
+    if (!error) {
+        // A single task, so there is nothing to gain from spinning
+        ThreadPool * const pool = createThreadPool(threads, 0, &error);
+
+        if (!error) {
+            runThreadPool(pool, runGenerate, &generateArgs);
+
+            error = freeThreadPool(pool);
+        }
+    }
+
+    free(generateArgs.colSin);
+    free(generateArgs.colCos);
+
+    return error;
+}
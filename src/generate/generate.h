@@ -0,0 +1,43 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdint.h>
+
+#include "../array/array.h"
+
+/**
+ * The kinds of grid generateGrid can fill in:
+ *  - GENERATE_UNIFORM: every point uniformly random between 0 and 100, like
+ *                      the built-in problems.
+ *  - GENERATE_SMOOTH:  a smooth field between 0 and 100, made of a few sine
+ *                      waves with random frequencies and phases.
+ *  - GENERATE_EDGES:   hot (100) top and left edges, cold (0) bottom and
+ *                      right edges, and uniformly random interior points.
+ */
+typedef enum {
+    GENERATE_UNIFORM,
+    GENERATE_SMOOTH,
+    GENERATE_EDGES
+} GenerateDistribution;
+
+/**
+ * Fill the given grid with a synthetic problem. Every point is worked out
+ * from the seed and its own position only (with a counter-based random
+ * number generator), so the rows can be filled by any number of threads and
+ * the same seed always gives the same grid.
+ *
+ * @param  values       The grid to fill
+ * @param  distribution The kind of grid to fill in
+ * @param  seed         The seed for the random values
+ * @param  threads      The number of threads to fill the grid with
+ *
+ * @return              0 on success, or an error code otherwise
+ */
+int generateGrid(
+    Grid * const values,
+    const GenerateDistribution distribution,
+    const uint64_t seed,
+    const int threads
+);
+
+#endif
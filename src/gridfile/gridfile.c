@@ -0,0 +1,353 @@
+/**
+ * Binary grid files, so grids of any size can be solved without compiling
+ * them in (see src/problem/problem.c for the built-in problems).
+ *
+ * A file is a GridFileHeader followed by the values. Files written with a
+ * 64 byte data offset and rows padded to the stride createGrid uses (see
+ * getGridStride in src/array/array.h) are mapped and used in place, so
+ * loading takes the same time whatever the size of the grid.
+ */
+
+// Needed for mmap, open and fstat when compiling with -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../array/array.h"
+#include "gridfile.h"
+
+/**
+ * Get the size of one value of a given type.
+ *
+ * @param  type The type of value
+ *
+ * @return      The size in bytes, or 0 if the type is not known
+ */
+static size_t getValueSize(const uint32_t type)
+{
+    switch (type) {
+        case GRID_FILE_FLOAT64:
+            return sizeof(double);
+        case GRID_FILE_FLOAT32:
+            return sizeof(float);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Check that a grid file header is valid for a file of the given size, i.e.
+ * that it describes a square grid whose values all lie within the file, and
+ * that its reserved words are 0.
+ *
+ * @param  header   The header
+ * @param  fileSize The size of the file in bytes
+ *
+ * @return          1 if valid, 0 otherwise
+ */
+static int isValidHeader(
+    const GridFileHeader * const header,
+    const size_t fileSize
+)
+{
+    const size_t valueSize = getValueSize(header->type);
+
+    if (memcmp(header->magic, GRID_FILE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != GRID_FILE_VERSION
+        || valueSize == 0
+        || header->rows != header->cols
+        || header->rows == 0
+        || header->rows > INT_MAX
+        || header->stride < header->cols
+        || header->dataOffset < sizeof(GridFileHeader)
+        || header->dataOffset > fileSize
+        || header->reserved[0] != 0
+        || header->reserved[1] != 0
+        || header->reserved[2] != 0
+    ) {
+        return 0;
+    }
+
+    if (header->alignment != 0
+        && (header->dataOffset % header->alignment != 0
+            || header->stride * valueSize % header->alignment != 0)
+    ) {
+        return 0;
+    }
+
+    // The last row need not be padded to the stride
+    const size_t available = (fileSize - header->dataOffset) / valueSize;
+
+    return header->cols <= available
+           && header->rows - 1 <= (available - header->cols) / header->stride;
+}
+
+/**
+ * Copy the values in a mapped grid file into a grid, converting them to
+ * double if need be.
+ *
+ * @param grid   The grid to copy into
+ * @param header The header of the file
+ * @param values The first value in the mapped file
+ */
+static void copyGridFileValues(
+    Grid * const grid,
+    const GridFileHeader * const header,
+    const char * const values
+)
+{
+    const size_t valueSize = getValueSize(header->type);
+    const size_t rowSize = header->stride * valueSize;
+
+    // Same layout, so a single copy will do
+    if (header->type == GRID_FILE_FLOAT64
+        && header->stride == (uint64_t)grid->stride
+    ) {
+        memcpy(
+            grid->data,
+            values,
+            ((size_t)grid->dimension - 1) * rowSize
+            + grid->dimension * sizeof(double)
+        );
+
+        return;
+    }
+
+    for (int row = 0; row < grid->dimension; row++) {
+        const char * const fileRow = values + row * rowSize;
+        double * const valuesRow = gridRow(grid, row);
+
+        if (header->type == GRID_FILE_FLOAT64) {
+            memcpy(valuesRow, fileRow, grid->dimension * sizeof(double));
+        } else {
+            const float * const floats = (const float *) fileRow;
+
+            for (int col = 0; col < grid->dimension; col++) {
+                valuesRow[col] = floats[col];
+            }
+        }
+    }
+}
+
+/**
+ * Load a grid from a grid file. If the file holds doubles laid out exactly as
+ * createGrid would lay them out, the grid uses a private mapping of the file
+ * directly, so no values are read until they are used, and values written by
+ * the solve are never written back to the file. Otherwise the values are
+ * copied (and converted to double if need be) into a new grid, which is
+ * first passed to prepare if it is given, so that the caller can place its
+ * memory (see firstTouchGrid in src/solve/solve.h). Either way the grid
+ * should be freed with freeGrid.
+ *
+ * @param  path        The path of the grid file
+ * @param  prepare     Run on a copied grid before its values are copied in,
+ *                     or NULL for none
+ * @param  prepareArgs Passed to prepare
+ * @param  grid        Set to the loaded grid on success
+ *
+ * @return             0 on success, EINVAL if the file is not a valid grid
+ *                     file, or another error code otherwise
+ */
+int loadGridFile(
+    const char * const path,
+    const PrepareGridFunction prepare,
+    const void * const prepareArgs,
+    Grid ** const grid
+)
+{
+    const int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return errno;
+    }
+
+    struct stat status;
+
+    if (fstat(fd, &status) == -1) {
+        const int error = errno;
+
+        close(fd);
+
+        return error;
+    }
+
+    const size_t fileSize = (size_t)status.st_size;
+
+    if (fileSize < sizeof(GridFileHeader)) {
+        close(fd);
+
+        return EINVAL;
+    }
+
+    // Private and writable, so the solve can update the values in place
+    void * const mapping = mmap(
+        NULL,
+        fileSize,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE,
+        fd,
+        0
+    );
+
+    // The mapping stays valid after the file is closed
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return errno;
+    }
+
+    const GridFileHeader * const header = (const GridFileHeader *) mapping;
+
+    if (!isValidHeader(header, fileSize)) {
+        munmap(mapping, fileSize);
+
+        return EINVAL;
+    }
+
+    char * const values = (char *) mapping + header->dataOffset;
+
+    const int dimension = (int)header->rows;
+
+    // Laid out as createGrid would, so use the mapped values in place
+    if (header->type == GRID_FILE_FLOAT64
+        && header->dataOffset % GRID_ALIGNMENT == 0
+        && header->stride == (uint64_t)getGridStride(dimension)
+        && header->dataOffset + (size_t)dimension * header->stride
+                                * sizeof(double) <= fileSize
+    ) {
+        Grid * const mapped = malloc(sizeof(Grid));
+
+        if (!mapped) {
+            munmap(mapping, fileSize);
+
+            return ENOMEM;
+        }
+
+        mapped->data = (double *) values;
+        mapped->dimension = dimension;
+        mapped->stride = (int)header->stride;
+        mapped->mapping = mapping;
+        mapped->mappingSize = fileSize;
+
+        *grid = mapped;
+
+        return 0;
+    }
+
+    Grid * const copy = createGrid(dimension);
+
+    if (!copy) {
+        munmap(mapping, fileSize);
+
+        return ENOMEM;
+    }
+
+    const int error = prepare ? prepare(copy, prepareArgs) : 0;
+
+    if (error) {
+        munmap(mapping, fileSize);
+        freeGrid(copy);
+
+        return error;
+    }
+
+    copyGridFileValues(copy, header, values);
+
+    munmap(mapping, fileSize);
+
+    *grid = copy;
+
+    return 0;
+}
+
+/**
+ * Read the dimension of the grid in a grid file, without loading the values.
+ *
+ * @param  path      The path of the grid file
+ * @param  dimension Set to the number of rows (and columns) on success
+ *
+ * @return           0 on success, EINVAL if the file is not a valid grid file,
+ *                   or another error code otherwise
+ */
+int readGridFileDimension(const char * const path, int * const dimension)
+{
+    const int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return errno;
+    }
+
+    struct stat status;
+    GridFileHeader header;
+    int error = 0;
+
+    if (fstat(fd, &status) == -1) {
+        error = errno;
+    } else if (read(fd, &header, sizeof(header)) != sizeof(header)
+               || !isValidHeader(&header, (size_t)status.st_size)
+    ) {
+        error = EINVAL;
+    }
+
+    close(fd);
+
+    if (!error) {
+        *dimension = (int)header.rows;
+    }
+
+    return error;
+}
+
+/**
+ * Save a grid to a grid file of doubles, laid out so that loadGridFile can
+ * use it in place. The rows are written with a single write, padding
+ * included.
+ *
+ * @param  path The path of the grid file to create or replace
+ * @param  grid The grid to save
+ *
+ * @return      0 on success, or an error code otherwise
+ */
+int saveGridFile(const char * const path, const Grid * const grid)
+{
+    GridFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GRID_FILE_MAGIC, sizeof(GRID_FILE_MAGIC));
+    header.version = GRID_FILE_VERSION;
+    header.type = GRID_FILE_FLOAT64;
+    header.rows = grid->dimension;
+    header.cols = grid->dimension;
+    header.stride = grid->stride;
+    header.dataOffset = sizeof(GridFileHeader);
+    header.alignment = GRID_ALIGNMENT;
+
+    FILE * const f = fopen(path, "wb");
+
+    if (!f) {
+        return errno;
+    }
+
+    const size_t values = (size_t)grid->dimension * grid->stride;
+
+    int error = 0;
+
+    if (fwrite(&header, sizeof(header), 1, f) != 1
+        || fwrite(grid->data, sizeof(double), values, f) != values
+    ) {
+        error = EIO;
+    }
+
+    if (fclose(f) != 0 && !error) {
+        error = EIO;
+    }
+
+    return error;
+}
@@ -0,0 +1,97 @@
+#ifndef GRIDFILE_H
+#define GRIDFILE_H
+
+#include <stdint.h>
+
+#include "../array/array.h"
+
+// First bytes of every grid file
+#define GRID_FILE_MAGIC "GRIDBIN"
+
+// Version of the format described by GridFileHeader
+#define GRID_FILE_VERSION 1
+
+// Types of value a grid file can hold
+typedef enum {
+    GRID_FILE_FLOAT64 = 1,
+    GRID_FILE_FLOAT32 = 2
+} GridFileType;
+
+/**
+ * Header at the start of a grid file. All fields are in the byte order of the
+ * machine (little-endian on x86-64), so a file from a machine of the other
+ * byte order is rejected by the version check. The values follow at
+ * dataOffset, row by row, with stride values from the start of one row to
+ * the start of the next.
+ */
+typedef struct {
+    char magic[8]; // GRID_FILE_MAGIC, including the terminating 0
+    uint32_t version; // GRID_FILE_VERSION
+    uint32_t type; // GridFileType of the values
+    uint64_t rows; // Number of rows
+    uint64_t cols; // Number of columns, which must equal rows
+    uint64_t stride; // Distance between the start of consecutive rows, in
+                     // values
+    uint64_t dataOffset; // Offset of the first row from the start of the file,
+                         // in bytes
+    uint32_t alignment; // Alignment of dataOffset and of each row, in bytes
+    uint32_t reserved[3]; // Must be 0, or the file is rejected
+} GridFileHeader;
+
+/**
+ * Callback run on a grid that loadGridFile copies a file into, before the
+ * values are copied. Returns 0 on success, or an error code that
+ * loadGridFile then returns.
+ */
+typedef int (*PrepareGridFunction)(Grid * const grid, const void * const args);
+
+/**
+ * Load a grid from a grid file. If the file holds doubles laid out exactly as
+ * createGrid would lay them out, the grid uses a private mapping of the file
+ * directly, so no values are read until they are used, and values written by
+ * the solve are never written back to the file. Otherwise the values are
+ * copied (and converted to double if need be) into a new grid, which is
+ * first passed to prepare if it is given, so that the caller can place its
+ * memory (see firstTouchGrid in src/solve/solve.h). Either way the grid
+ * should be freed with freeGrid.
+ *
+ * @param  path        The path of the grid file
+ * @param  prepare     Run on a copied grid before its values are copied in,
+ *                     or NULL for none
+ * @param  prepareArgs Passed to prepare
+ * @param  grid        Set to the loaded grid on success
+ *
+ * @return             0 on success, EINVAL if the file is not a valid grid
+ *                     file, or another error code otherwise
+ */
+int loadGridFile(
+    const char * const path,
+    const PrepareGridFunction prepare,
+    const void * const prepareArgs,
+    Grid ** const grid
+);
+
+/**
+ * Read the dimension of the grid in a grid file, without loading the values.
+ *
+ * @param  path      The path of the grid file
+ * @param  dimension Set to the number of rows (and columns) on success
+ *
+ * @return           0 on success, EINVAL if the file is not a valid grid file,
+ *                   or another error code otherwise
+ */
+int readGridFileDimension(const char * const path, int * const dimension);
+
+/**
+ * Save a grid to a grid file of doubles, laid out so that loadGridFile can
+ * use it in place. The rows are written with a single write, padding
+ * included.
+ *
+ * @param  path The path of the grid file to create or replace
+ * @param  grid The grid to save
+ *
+ * @return      0 on success, or an error code otherwise
+ */
+int saveGridFile(const char * const path, const Grid * const grid);
+
+#endif
@@ -1,16 +1,104 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "output/output.h"
+#include "affinity/affinity.h"
 #include "array/array.h"
 #include "problem/problem.h"
+#include "gridfile/gridfile.h"
+#include "generate/generate.h"
 #include "solve/solve.h"
+#include "solve/kernel.h"
+#include "batch/batch.h"
+#include "utility/utility.h"
 
 #define HELP "Argument order:\n"\
-             " - Problem ID (1, 2, 3, 4, 5 or 6. See src/problem/problem.c).\n"\
-             " - Number of threads to use.\n"\
-             " - Precision to work to.\n"
+             " - Problem ID (1, 2, 3, 4, 5 or 6. See src/problem/problem.c),\n"\
+             "   or the path of a grid file (see src/gridfile/gridfile.h),\n"\
+             "   or uniform, smooth or edges to generate a grid (see\n"\
+             "   src/generate/generate.h).\n"\
+             " - Number of threads to use, or auto for one per CPU this\n"\
+             "   process may run on.\n"\
+             " - Precision to work to.\n"\
+             "Optional flags (after the above):\n"\
+             " --method=relax|vcycle|fmg|cg|jacobi\n"\
+             "                        Numerical method (default relax,\n"\
+             "                        vcycle and fmg are multigrid, cg is\n"\
+             "                        conjugate gradient, jacobi gives the\n"\
+             "                        same result for any thread count).\n"\
+             " --preconditioner=jacobi|ssor\n"\
+             "                        Preconditioner for cg (default ssor).\n"\
+             " --omega=X|auto         Relaxation factor for relax, between 0\n"\
+             "                        and 2 (default 1, Gauss-Seidel). auto\n"\
+             "                        picks the best one for the grid size.\n"\
+             " --mode=dispatch|bands|blocked\n"\
+             "                        How work is split between threads\n"\
+             "                        (default dispatch).\n"\
+             " --layout=natural|split How the grid is stored while solving\n"\
+             "                        (default natural, split needs bands\n"\
+             "                        or blocked).\n"\
+             " --kernel=auto|scalar|sse2|avx2|avx512\n"\
+             "                        Relaxation kernel to use (default\n"\
+             "                        auto, the widest the CPU supports).\n"\
+             " --spin=N               How many times waiting threads check\n"\
+             "                        a barrier before blocking (0 blocks\n"\
+             "                        straight away, default spins only\n"\
+             "                        if there is a CPU per thread).\n"\
+             " --block-sweeps=N       Sweeps per block in blocked mode\n"\
+             "                        (default picked from the grid size).\n"\
+             " --float=double|mixed   Do all relax sweeps in double\n"\
+             "                        (default) or most of them in float\n"\
+             "                        first.\n"\
+             " --size=N               Dimension of generated grids (default\n"\
+             "                        1000).\n"\
+             " --seed=N               Seed for generated grids (default 1).\n"\
+             " --format=text|binary   Write output.txt (default) or\n"\
+             "                        output.grid, a grid file.\n"\
+             " --write-input=yes|no   Also write the input grid, to\n"\
+             "                        output.txt or input.grid (default\n"\
+             "                        yes).\n"\
+             " --dimensions=2|3       Solve the problem as a square\n"\
+             "                        (default) or as a cube built from it\n"\
+             "                        (relax only, mode and layout are\n"\
+             "                        ignored).\n"\
+             " --checkpoint=PATH      Save the grid to PATH every so often\n"\
+             "                        while solving (relax only).\n"\
+             " --checkpoint-interval=SECONDS\n"\
+             "                        Time between checkpoints (default 60).\n"\
+             " --resume=PATH          Carry on from the checkpoint at PATH\n"\
+             "                        instead of the first argument.\n"\
+             " --affinity=none|compact|scatter\n"\
+             "                        Pin threads to CPUs, filling one\n"\
+             "                        socket at a time or spreading them\n"\
+             "                        over sockets (default none).\n"\
+             " --stats=PATH           Write statistics of the solve to PATH\n"\
+             "                        as JSON.\n"\
+             " --stats-every=N        Also write a line of JSON to stderr\n"\
+             "                        every N sweeps while solving.\n"\
+             " --warm-start=coarse|PATH\n"\
+             "                        Start from a coarse grid solve\n"\
+             "                        interpolated up, or from the solution\n"\
+             "                        in the grid file at PATH.\n"\
+             " --criterion=change|change-l2|residual|residual-l2|relative\n"\
+             "                        When relax and jacobi stop: largest\n"\
+             "                        or root mean square change, largest\n"\
+             "                        or root mean square residual, or\n"\
+             "                        residual relative to the first check\n"\
+             "                        (default change).\n"\
+             " --check-every=N        Test the criterion every N sweeps\n"\
+             "                        (default 1).\n"\
+             "Batch mode:\n"\
+             " bin/solve --batch=MANIFEST THREADS [flags]\n"\
+             "                        Solve every job in MANIFEST, one per\n"\
+             "                        line: input, precision, output path,\n"\
+             "                        then any flags for that job. Flags\n"\
+             "                        on the command line apply to every\n"\
+             "                        job. Prints the time of each job.\n"\
+             " --split-size=N         Grids of at least N points square are\n"\
+             "                        split across all threads, smaller ones\n"\
+             "                        get one thread each (default 512).\n"
 
 #define INVALID_NUM_ARGS "You must specify problem ID, "\
                          "number of threads and precision.\n"
@@ -18,85 +106,1560 @@
 #define INVALID_PROBLEM_ID "Invalid problem id given. "\
                            "Must be 1, 2, 3, 4, 5 or 6.\n"
 
-#define INVALID_THREADS "Threads must be an integer greater than 0\n"
+#define INVALID_GRID_FILE "%s is not a valid grid file\n"
+
+#define GRID_FILE_ERROR "Could not load %s: %s\n"
+
+#define INVALID_FILE_DIMENSIONS "--dimensions=3 needs a problem ID, not a "\
+                                "grid file or generated grid\n"
+
+#define INVALID_FORMAT "Format must be one of text or binary\n"
+
+#define INVALID_WRITE_INPUT "Write input must be one of yes or no\n"
+
+#define INVALID_FORMAT_DIMENSIONS "--format=binary can only be used with "\
+                                  "--dimensions=2\n"
+
+#define OUTPUT_ERROR "Could not write %s: %s\n"
+
+#define INVALID_SIZE "Size must be an integer of at least 3\n"
+
+#define INVALID_SEED "Seed must be a non-negative integer\n"
+
+#define INVALID_THREADS "Threads must be auto or an integer greater than 0\n"
+
+#define OVERSUBSCRIBED "Warning: %d threads but only %d CPUs available\n"
+
+#define INVALID_AFFINITY "Affinity must be one of none, compact or scatter\n"
 
 #define INVALID_PRECISION "Precision must be a decimal greater than 0\n"
 
-#define PTHREAD_ERROR "Something went wrong. Error code: %d\n"
+#define INVALID_METHOD "Method must be one of relax, vcycle, fmg, cg or "\
+                       "jacobi\n"
+
+#define INVALID_PRECONDITIONER "Preconditioner must be one of jacobi or ssor\n"
+
+#define INVALID_METHOD_LAYOUT "The split layout can only be used with "\
+                              "--method=relax\n"
+
+#define INVALID_OMEGA "Omega must be auto or a decimal between 0 and 2\n"
+
+#define INVALID_MODE "Mode must be one of dispatch, bands or blocked\n"
+
+#define INVALID_LAYOUT "Layout must be one of natural or split\n"
+
+#define INVALID_LAYOUT_MODE "The split layout can only be used with "\
+                            "--mode=bands or --mode=blocked\n"
+
+#define INVALID_KERNEL "Kernel must be one of auto, scalar, sse2, avx2 "\
+                       "or avx512\n"
+
+#define UNSUPPORTED_KERNEL "The requested kernel is not supported by this "\
+                           "CPU\n"
+
+#define INVALID_SPIN "Spin must be an integer of at least 0\n"
+
+#define INVALID_BLOCK_SWEEPS "Block sweeps must be an integer greater than 0\n"
+
+#define INVALID_FLOAT "Float must be one of double or mixed\n"
+
+#define INVALID_METHOD_FLOAT "--float=mixed can only be used with "\
+                             "--method=relax and --dimensions=2\n"
+
+#define INVALID_DIMENSIONS "Dimensions must be 2 or 3\n"
+
+#define INVALID_METHOD_DIMENSIONS "Only --method=relax can be used with "\
+                                  "--dimensions=3\n"
+
+#define INVALID_CHECKPOINT_INTERVAL "Checkpoint interval must be a decimal "\
+                                    "greater than 0\n"
+
+#define INVALID_METHOD_CHECKPOINT "--checkpoint and --resume can only be "\
+                                  "used with --method=relax, --float=double "\
+                                  "and --dimensions=2\n"
+
+#define INVALID_CHECKPOINT "%s is not a valid checkpoint\n"
+
+#define CHECKPOINT_ERROR "Could not load %s: %s\n"
+
+#define INVALID_STATS_EVERY "Stats every must be an integer greater than 0\n"
+
+#define INVALID_STATS_DIMENSIONS "--stats can only be used with "\
+                                 "--dimensions=2\n"
+
+#define INVALID_OPTION "Unknown option: %s\n"
+
+#define INVALID_WARM_START "--warm-start cannot be used with --resume or "\
+                           "--dimensions=3\n"
+
+#define INVALID_CRITERION "Criterion must be one of change, change-l2, "\
+                          "residual, residual-l2 or relative\n"
+
+#define INVALID_METHOD_CRITERION "--criterion can only be used with "\
+                                 "--method=relax or jacobi in 2 dimensions\n"
+
+#define INVALID_CHECK_EVERY "Check every must be an integer greater than 0\n"
+
+#define INVALID_SPLIT_SIZE "Split size must be an integer of at least 3\n"
+
+#define INVALID_BATCH_ARGS "You must specify the number of threads after "\
+                           "--batch.\n"
+
+#define MANIFEST_ERROR "Could not read %s: %s\n"
+
+#define INVALID_MANIFEST_LINE "(on line %d of %s)\n"
+
+#define INVALID_JOB "Each job needs an input, precision and output path\n"
+
+#define INVALID_BATCH_OPTION "--checkpoint, --resume, --stats, "\
+                             "--stats-every and --dimensions=3 cannot be "\
+                             "used with --batch\n"
+
+#define INVALID_JOB_OPTION "--affinity, --spin and --split-size apply to "\
+                           "the whole batch, so can only be given on the "\
+                           "command line\n"
+
+#define JOB_ERROR "Job on line %d failed. Error code: %d\n"
+
+#define BATCH_HEADER "line,input,output,size,threads,iterations,"\
+                     "final_change,load_seconds,solve_seconds,"\
+                     "write_seconds,status\n"
+
+#define BATCH_ROW "%d,%s,%s,%d,%d,%d,%g,%.6f,%.6f,%.6f,%s\n"
+
+#define BATCH_SUMMARY "Jobs: %d (%d failed)\n"\
+                      "Total time: %f seconds\n"\
+                      "Jobs per second: %.1f\n"
+
+#define TEXT_OUTPUT_FILE "./output.txt"
+
+#define INPUT_GRID_FILE "./input.grid"
+
+#define SOLUTION_GRID_FILE "./output.grid"
+
+#define OUT_OF_MEMORY "Not enough memory to solve the problem\n"
+
+#define PTHREAD_ERROR "Something went wrong. Error code: %d\n"
+
+#define ITERATIONS "Iterations: %d\n"
+
+#define OMEGA "Omega: %f\n"
+
+#define FLOAT_ITERATIONS "Float iterations: %d\n"
+
+#define COARSE_ITERATIONS "Coarse iterations: %d\n"
+
+#define FINAL_CHANGE "Final change: %g\n"
+
+#define FINAL_MEASURE "Final %s: %g\n"
+
+#define CHECKPOINTS_WRITTEN "Checkpoints written: %d\n"
+
+// Format of the files the command line tool writes grids to
+typedef enum {
+    OUTPUT_TEXT, // Input and solution as text in TEXT_OUTPUT_FILE
+    OUTPUT_BINARY // Grid files INPUT_GRID_FILE and SOLUTION_GRID_FILE
+} OutputFormat;
+
+// Options for the command line tool that are not passed on to solve
+typedef struct {
+    int dimensions; // Number of dimensions to solve in (2 or 3)
+    OutputFormat format; // Format to write grids in
+    int writeInput; // 1 to write the input grid as well as the solution
+    int size; // Dimension of generated grids
+    unsigned long long seed; // Seed for generated grids
+    const char * checkpointPath; // Path to save checkpoints to, or NULL
+    double checkpointInterval; // Seconds between checkpoints
+    const char * resumePath; // Path of a checkpoint to resume from, or NULL
+    const char * statsPath; // Path to write statistics to, or NULL
+    int statsEvery; // Sweeps between statistics streamed, or 0 for none
+    int splitSize; // Dimension from which batch jobs use all threads
+    const char * warmStartPath; // Grid file of a previous solution to start
+                                // from, or NULL
+    const char * criterionName; // Name of the criterion, to print its final
+                                // measure, or NULL for the change
+} RunOptions;
+
+/**
+ * Checks if any of the parameters passed via CLI are --help or -h
+ *
+ * @param  args Number of command line argmuments
+ * @param  argv Array of command line arguments
+ *
+ * @return      1 if true (help flag specified), 0 otherwise
+ */
+static const int isHelpFlag(int args, char *argv[])
+{
+    for (int i = 0; i < args; i++) {
+        if (strcmp(argv[i], "--help") == 0
+            || strcmp(argv[i], "-h") == 0) {
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Checks if a command line argument is an optional flag (starts with --).
+ *
+ * @param  arg The command line argument
+ *
+ * @return     1 if flag, 0 otherwise
+ */
+static int isFlag(const char * const arg)
+{
+    return strncmp(arg, "--", 2) == 0;
+}
+
+/**
+ * Parse the optional flags given after the positional arguments into the
+ * given options. Prints an error message if a flag is unknown or invalid.
+ *
+ * @param  args    Number of command line arguments
+ * @param  argv    Array of command line arguments
+ * @param  first   Index of the first optional flag in argv
+ * @param  options The options to update
+ * @param  run     The options outside solve to update
+ *
+ * @return         0 if success, -1 if error
+ */
+static int parseOptions(
+    int args,
+    char *argv[],
+    const int first,
+    SolveOptions * const options,
+    RunOptions * const run
+)
+{
+    const char *value;
+
+    for (int i = first; i < args; i++) {
+        if ((value = getOptionValue(argv[i], "--method"))) {
+            if (strcmp(value, "relax") == 0) {
+                options->method = SOLVE_METHOD_RELAX;
+            } else if (strcmp(value, "vcycle") == 0) {
+                options->method = SOLVE_METHOD_VCYCLE;
+            } else if (strcmp(value, "fmg") == 0) {
+                options->method = SOLVE_METHOD_FMG;
+            } else if (strcmp(value, "cg") == 0) {
+                options->method = SOLVE_METHOD_CG;
+            } else if (strcmp(value, "jacobi") == 0) {
+                options->method = SOLVE_METHOD_JACOBI;
+            } else {
+                printf(INVALID_METHOD);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--preconditioner"))) {
+            if (strcmp(value, "jacobi") == 0) {
+                options->preconditioner = SOLVE_PRECONDITIONER_JACOBI;
+            } else if (strcmp(value, "ssor") == 0) {
+                options->preconditioner = SOLVE_PRECONDITIONER_SSOR;
+            } else {
+                printf(INVALID_PRECONDITIONER);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--omega"))) {
+            if (strcmp(value, "auto") == 0) {
+                options->omega = SOLVE_OMEGA_AUTO;
+            } else {
+                options->omega = atof(value);
+
+                if (options->omega <= 0 || options->omega >= 2) {
+                    printf(INVALID_OMEGA);
+
+                    return -1;
+                }
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--mode"))) {
+            if (strcmp(value, "dispatch") == 0) {
+                options->mode = SOLVE_MODE_DISPATCH;
+            } else if (strcmp(value, "bands") == 0) {
+                options->mode = SOLVE_MODE_BANDS;
+            } else if (strcmp(value, "blocked") == 0) {
+                options->mode = SOLVE_MODE_BLOCKED;
+            } else {
+                printf(INVALID_MODE);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--layout"))) {
+            if (strcmp(value, "natural") == 0) {
+                options->layout = SOLVE_LAYOUT_NATURAL;
+            } else if (strcmp(value, "split") == 0) {
+                options->layout = SOLVE_LAYOUT_SPLIT;
+            } else {
+                printf(INVALID_LAYOUT);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--kernel"))) {
+            if (strcmp(value, "auto") == 0) {
+                options->kernel = SOLVE_KERNEL_AUTO;
+            } else if (strcmp(value, "scalar") == 0) {
+                options->kernel = SOLVE_KERNEL_SCALAR;
+            } else if (strcmp(value, "sse2") == 0) {
+                options->kernel = SOLVE_KERNEL_SSE2;
+            } else if (strcmp(value, "avx2") == 0) {
+                options->kernel = SOLVE_KERNEL_AVX2;
+            } else if (strcmp(value, "avx512") == 0) {
+                options->kernel = SOLVE_KERNEL_AVX512;
+            } else {
+                printf(INVALID_KERNEL);
+
+                return -1;
+            }
+
+            if (!getRelaxKernels(options->kernel)) {
+                printf(UNSUPPORTED_KERNEL);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--spin"))) {
+            options->spinCount = atoi(value);
+
+            if (options->spinCount < 0) {
+                printf(INVALID_SPIN);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--block-sweeps"))) {
+            options->blockSweeps = atoi(value);
+
+            if (options->blockSweeps <= 0) {
+                printf(INVALID_BLOCK_SWEEPS);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--affinity"))) {
+            if (strcmp(value, "none") == 0) {
+                options->affinity = AFFINITY_NONE;
+            } else if (strcmp(value, "compact") == 0) {
+                options->affinity = AFFINITY_COMPACT;
+            } else if (strcmp(value, "scatter") == 0) {
+                options->affinity = AFFINITY_SCATTER;
+            } else {
+                printf(INVALID_AFFINITY);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--float"))) {
+            if (strcmp(value, "double") == 0) {
+                options->floats = SOLVE_FLOAT_DOUBLE;
+            } else if (strcmp(value, "mixed") == 0) {
+                options->floats = SOLVE_FLOAT_MIXED;
+            } else {
+                printf(INVALID_FLOAT);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--format"))) {
+            if (strcmp(value, "text") == 0) {
+                run->format = OUTPUT_TEXT;
+            } else if (strcmp(value, "binary") == 0) {
+                run->format = OUTPUT_BINARY;
+            } else {
+                printf(INVALID_FORMAT);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--write-input"))) {
+            if (strcmp(value, "yes") == 0) {
+                run->writeInput = 1;
+            } else if (strcmp(value, "no") == 0) {
+                run->writeInput = 0;
+            } else {
+                printf(INVALID_WRITE_INPUT);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--size"))) {
+            run->size = atoi(value);
+
+            if (run->size < 3) {
+                printf(INVALID_SIZE);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--seed"))) {
+            char *end;
+
+            run->seed = strtoull(value, &end, 10);
+
+            if (value[0] == '\0' || value[0] == '-' || *end != '\0') {
+                printf(INVALID_SEED);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--dimensions"))) {
+            run->dimensions = atoi(value);
+
+            if (run->dimensions != 2 && run->dimensions != 3) {
+                printf(INVALID_DIMENSIONS);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--checkpoint"))) {
+            run->checkpointPath = value;
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--checkpoint-interval"))) {
+            run->checkpointInterval = atof(value);
+
+            if (run->checkpointInterval <= 0) {
+                printf(INVALID_CHECKPOINT_INTERVAL);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--resume"))) {
+            run->resumePath = value;
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--stats"))) {
+            run->statsPath = value;
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--warm-start"))) {
+            if (strcmp(value, "coarse") == 0) {
+                options->warmStart = SOLVE_WARM_START_COARSE;
+                run->warmStartPath = NULL;
+            } else {
+                options->warmStart = SOLVE_WARM_START_NONE;
+                run->warmStartPath = value;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--criterion"))) {
+            if (strcmp(value, "change") == 0) {
+                options->criterion = SOLVE_CRITERION_CHANGE;
+            } else if (strcmp(value, "change-l2") == 0) {
+                options->criterion = SOLVE_CRITERION_CHANGE_L2;
+            } else if (strcmp(value, "residual") == 0) {
+                options->criterion = SOLVE_CRITERION_RESIDUAL;
+            } else if (strcmp(value, "residual-l2") == 0) {
+                options->criterion = SOLVE_CRITERION_RESIDUAL_L2;
+            } else if (strcmp(value, "relative") == 0) {
+                options->criterion = SOLVE_CRITERION_RELATIVE;
+            } else {
+                printf(INVALID_CRITERION);
+
+                return -1;
+            }
+
+            run->criterionName = options->criterion == SOLVE_CRITERION_CHANGE
+                                 ? NULL
+                                 : value;
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--check-every"))) {
+            options->checkEvery = atoi(value);
+
+            if (options->checkEvery <= 0) {
+                printf(INVALID_CHECK_EVERY);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--split-size"))) {
+            run->splitSize = atoi(value);
+
+            if (run->splitSize < 3) {
+                printf(INVALID_SPLIT_SIZE);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        if ((value = getOptionValue(argv[i], "--stats-every"))) {
+            run->statsEvery = atoi(value);
+
+            if (run->statsEvery <= 0) {
+                printf(INVALID_STATS_EVERY);
+
+                return -1;
+            }
+
+            continue;
+        }
+
+        printf(INVALID_OPTION, argv[i]);
+
+        return -1;
+    }
+
+    if (options->layout == SOLVE_LAYOUT_SPLIT
+        && options->mode == SOLVE_MODE_DISPATCH
+    ) {
+        printf(INVALID_LAYOUT_MODE);
+
+        return -1;
+    }
+
+    if (options->layout == SOLVE_LAYOUT_SPLIT
+        && options->method != SOLVE_METHOD_RELAX
+    ) {
+        printf(INVALID_METHOD_LAYOUT);
+
+        return -1;
+    }
+
+    if (run->dimensions == 3 && options->method != SOLVE_METHOD_RELAX) {
+        printf(INVALID_METHOD_DIMENSIONS);
+
+        return -1;
+    }
+
+    if (options->floats == SOLVE_FLOAT_MIXED
+        && (options->method != SOLVE_METHOD_RELAX || run->dimensions == 3)
+    ) {
+        printf(INVALID_METHOD_FLOAT);
+
+        return -1;
+    }
+
+    if (run->format == OUTPUT_BINARY && run->dimensions == 3) {
+        printf(INVALID_FORMAT_DIMENSIONS);
+
+        return -1;
+    }
+
+    if ((run->checkpointPath || run->resumePath)
+        && (options->method != SOLVE_METHOD_RELAX
+            || options->floats != SOLVE_FLOAT_DOUBLE
+            || run->dimensions == 3)
+    ) {
+        printf(INVALID_METHOD_CHECKPOINT);
+
+        return -1;
+    }
+
+    if ((run->statsPath || run->statsEvery) && run->dimensions == 3) {
+        printf(INVALID_STATS_DIMENSIONS);
+
+        return -1;
+    }
+
+    if (options->criterion != SOLVE_CRITERION_CHANGE
+        && ((options->method != SOLVE_METHOD_RELAX
+             && options->method != SOLVE_METHOD_JACOBI)
+            || run->dimensions == 3)
+    ) {
+        printf(INVALID_METHOD_CRITERION);
+
+        return -1;
+    }
+
+    if ((options->warmStart != SOLVE_WARM_START_NONE || run->warmStartPath)
+        && (run->resumePath || run->dimensions == 3)
+    ) {
+        printf(INVALID_WARM_START);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Checks if a command line argument is a problem ID rather than the path of a
+ * grid file, i.e. is made up only of digits.
+ *
+ * @param  arg The command line argument
+ *
+ * @return     1 if a problem ID, 0 otherwise
+ */
+static int isProblemId(const char * const arg)
+{
+    return arg[0] != '\0' && strspn(arg, "0123456789") == strlen(arg);
+}
+
+/**
+ * Checks if a command line argument is the name of a generated grid, and if
+ * so which kind.
+ *
+ * @param  arg          The command line argument
+ * @param  distribution Set to the kind of grid if it is one
+ *
+ * @return              1 if the name of a generated grid, 0 otherwise
+ */
+static int isGeneratedGrid(
+    const char * const arg,
+    GenerateDistribution * const distribution
+)
+{
+    if (strcmp(arg, "uniform") == 0) {
+        *distribution = GENERATE_UNIFORM;
+    } else if (strcmp(arg, "smooth") == 0) {
+        *distribution = GENERATE_SMOOTH;
+    } else if (strcmp(arg, "edges") == 0) {
+        *distribution = GENERATE_EDGES;
+    } else {
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Touch a grid copied from a grid file before its values are copied in, so
+ * that it is placed in the same way as other input grids (see
+ * firstTouchGrid). Used as the PrepareGridFunction of loadGridFile.
+ *
+ * @param  values  The grid
+ * @param  options The SolveOptions the grid will be solved with
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+static int firstTouchCopiedGrid(Grid * const values, const void * const options)
+{
+    return firstTouchGrid(values, (const SolveOptions *) options);
+}
+
+/**
+ * Builds the grid of values to solve, from the problem with the given ID, by
+ * generating one, or by loading the given grid file. Prints an error message
+ * on failure.
+ *
+ * @param  input   Problem ID, kind of generated grid or path of a grid file
+ * @param  options Options to solve with (threads and affinity are used to
+ *                 place and generate the grid)
+ * @param  run     Options for generated grids (size and seed)
+ *
+ * @return         The grid, or NULL if error
+ */
+static Grid *createInputGrid(
+    const char * const input,
+    const SolveOptions * const options,
+    const RunOptions * const run
+)
+{
+    GenerateDistribution distribution;
+
+    if (isGeneratedGrid(input, &distribution)) {
+        Grid * const values = createGrid(run->size);
+
+        if (!values) {
+            printf(OUT_OF_MEMORY);
+
+            return NULL;
+        }
+
+        int error = firstTouchGrid(values, options);
+
+        if (!error) {
+            error = generateGrid(
+                values,
+                distribution,
+                run->seed,
+                options->threads
+            );
+        }
+
+        if (error) {
+            printf(PTHREAD_ERROR, error);
+            freeGrid(values);
+
+            return NULL;
+        }
+
+        return values;
+    }
+
+    if (!isProblemId(input)) {
+        Grid *values;
+        const int error = loadGridFile(
+            input,
+            firstTouchCopiedGrid,
+            options,
+            &values
+        );
+
+        if (error == EINVAL) {
+            printf(INVALID_GRID_FILE, input);
+        } else if (error) {
+            printf(GRID_FILE_ERROR, input, strerror(error));
+        }
+
+        return error ? NULL : values;
+    }
+
+    const int problemId = atoi(input);
+    const int dimension = getProblemDimension(problemId);
+
+    if (dimension == -1) {
+        printf(INVALID_PROBLEM_ID);
+
+        return NULL;
+    }
+
+    Grid * const values = createGrid(dimension);
+
+    if (!values) {
+        printf(OUT_OF_MEMORY);
+
+        return NULL;
+    }
+
+    const int error = firstTouchGrid(values, options);
+
+    if (error) {
+        printf(PTHREAD_ERROR, error);
+        freeGrid(values);
+
+        return NULL;
+    }
+
+    fillProblemArray(values, problemId);
+
+    return values;
+}
+
+/**
+ * Loads the grid of values to solve from the checkpoint at the given path,
+ * into a grid first touched for the given options. Prints an error message
+ * on failure.
+ *
+ * @param  path    Path of the checkpoint file
+ * @param  options Options to solve with (threads and affinity are used to
+ *                 place the grid)
+ * @param  sweeps  Set to the sweeps done before the checkpoint
+ *
+ * @return         The grid, or NULL if error
+ */
+static Grid *loadResumeGrid(
+    const char * const path,
+    const SolveOptions * const options,
+    int * const sweeps
+)
+{
+    int dimension;
+    int error = readCheckpointDimension(path, &dimension);
+    Grid *values = NULL;
+
+    if (!error) {
+        values = createGrid(dimension);
+
+        if (!values) {
+            printf(OUT_OF_MEMORY);
+
+            return NULL;
+        }
+
+        error = firstTouchGrid(values, options);
+
+        if (error) {
+            printf(PTHREAD_ERROR, error);
+            freeGrid(values);
+
+            return NULL;
+        }
+
+        error = loadCheckpoint(path, values, sweeps);
+    }
+
+    if (error == EINVAL) {
+        printf(INVALID_CHECKPOINT, path);
+    } else if (error) {
+        printf(CHECKPOINT_ERROR, path, strerror(error));
+    }
+
+    if (error && values) {
+        freeGrid(values);
+    }
+
+    return error ? NULL : values;
+}
+
+/**
+ * Seeds the interior of the given values from the previous solution in the
+ * grid file at the given path (see warmStartGrid). Prints an error message
+ * on failure.
+ *
+ * @param  values The grid of values to seed
+ * @param  path   The path of the grid file
+ *
+ * @return        0 if success, -1 if error
+ */
+static int loadWarmStart(Grid * const values, const char * const path)
+{
+    Grid *previous;
+    int error = loadGridFile(path, NULL, NULL, &previous);
+
+    if (!error) {
+        error = warmStartGrid(values, previous);
+        freeGrid(previous);
+    }
+
+    if (error == EINVAL) {
+        printf(INVALID_GRID_FILE, path);
+    } else if (error) {
+        printf(GRID_FILE_ERROR, path, strerror(error));
+    }
+
+    return error ? -1 : 0;
+}
+
+/**
+ * Write a grid to the text output file under a heading or, if there is no
+ * text output file, to a grid file. Prints an error message on failure.
+ *
+ * @param  f        The text output file, or NULL to write a grid file
+ * @param  path     The path of the text output file, or of the grid file
+ * @param  heading  The heading for the text output file
+ * @param  values   The grid to write
+ * @param  threads  The number of threads to format text with
+ *
+ * @return          0 if success, -1 if error
+ */
+static int writeOutputGrid(
+    FILE * const f,
+    const char * const path,
+    const char * const heading,
+    const Grid * const values,
+    const int threads
+)
+{
+    int error;
+
+    if (f) {
+        fputs(heading, f);
+        error = writeGrid(f, values, threads);
+    } else {
+        error = saveGridFile(path, values);
+    }
+
+    if (error) {
+        printf(OUTPUT_ERROR, path, strerror(error));
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Write the statistics of a solve to the given path as JSON. Prints an error
+ * message on failure.
+ *
+ * @param  path  The path to write to
+ * @param  stats The statistics to write
+ *
+ * @return       0 if success, -1 if error
+ */
+static int writeStatsFile(
+    const char * const path,
+    const SolveStats * const stats
+)
+{
+    FILE * const f = fopen(path, "w");
+    int error = f ? writeSolveStats(f, stats) : errno;
+
+    if (f && fclose(f) != 0 && !error) {
+        error = EIO;
+    }
+
+    if (error) {
+        printf(OUTPUT_ERROR, path, strerror(error));
+
+        return -1;
+    }
+
+    return 0;
+}
 
 /**
- * Checks if any of the parameters passed via CLI are --help or -h
+ * Builds array of values from the problem ID, generated grid or grid file
+ * given (or the checkpoint to resume from), runs solve on these values and
+ * writes the solution to file.
  *
- * @param  args Number of command line argmuments
- * @param  argv Array of command line arguments
+ * @param  input   Problem ID, kind of generated grid or path of a grid file
+ * @param  options Options to solve with (threads, precision etc.)
+ * @param  run     Options outside solve (size and seed of generated grids,
+ *                 checkpoints)
  *
- * @return      1 if true (help flag specified), 0 otherwise
+ * @return         0 if success, -1 if error
  */
-static const int isHelpFlag(int args, char *argv[])
+static int runSolve(
+    const char * const input,
+    const SolveOptions * const options,
+    const RunOptions * const run
+)
 {
-    for (int i = 0; i < args; i++) {
-        if (strcmp(argv[i], "--help") == 0
-            || strcmp(argv[i], "-h") == 0) {
+    // Sweeps done before the checkpoint resumed from
+    int resumedSweeps = 0;
 
-            return 1;
+    Grid * const values = run->resumePath
+                          ? loadResumeGrid(
+                                run->resumePath,
+                                options,
+                                &resumedSweeps
+                            )
+                          : createInputGrid(input, options, run);
+
+    if (!values) {
+        return -1;
+    }
+
+    FILE *f = NULL;
+
+    if (run->format == OUTPUT_TEXT) {
+        f = fopen(TEXT_OUTPUT_FILE, "w");
+
+        if (!f) {
+            printf(OUTPUT_ERROR, TEXT_OUTPUT_FILE, strerror(errno));
+            freeGrid(values);
+
+            return -1;
         }
     }
 
-    return 0;
+    // Log input
+    if (run->writeInput) {
+        const int outputError = writeOutputGrid(
+            f,
+            f ? TEXT_OUTPUT_FILE : INPUT_GRID_FILE,
+            "Input:\n",
+            values,
+            options->threads
+        );
+
+        if (outputError) {
+            if (f) {
+                fclose(f);
+            }
+
+            freeGrid(values);
+
+            return -1;
+        }
+    }
+
+    if (run->warmStartPath && loadWarmStart(values, run->warmStartPath)) {
+        if (f) {
+            fclose(f);
+        }
+
+        freeGrid(values);
+
+        return -1;
+    }
+
+    SolveOptions solveOptions = *options;
+    int error = 0;
+
+    if (run->statsPath || run->statsEvery) {
+        solveOptions.stats = createSolveStats(
+            options->threads,
+            run->statsEvery ? stderr : NULL,
+            run->statsEvery
+        );
+
+        if (!solveOptions.stats) {
+            error = ENOMEM;
+        }
+    }
+
+    if (run->checkpointPath && !error) {
+        solveOptions.checkpointer = createCheckpointer(
+            run->checkpointPath,
+            values,
+            run->checkpointInterval,
+            resumedSweeps,
+            &error
+        );
+    }
+
+    // Solve and update values
+    SolveResult result;
+
+    if (!error) {
+        error = solve(values, &solveOptions, &result);
+    }
+
+    int checkpoints = 0;
+
+    if (solveOptions.checkpointer) {
+        checkpoints = getCheckpointsWritten(solveOptions.checkpointer);
+
+        const int checkpointError = freeCheckpointer(
+            solveOptions.checkpointer
+        );
+
+        if (checkpointError) {
+            printf(
+                OUTPUT_ERROR,
+                run->checkpointPath,
+                strerror(checkpointError)
+            );
+        }
+    }
+
+    if (error) {
+        printf(PTHREAD_ERROR, error);
+    } else {
+        if (options->floats == SOLVE_FLOAT_MIXED) {
+            printf(FLOAT_ITERATIONS, result.floatIterations);
+        }
+
+        if (options->warmStart == SOLVE_WARM_START_COARSE) {
+            printf(COARSE_ITERATIONS, result.coarseIterations);
+        }
+
+        printf(ITERATIONS, resumedSweeps + result.iterations);
+
+        if (options->method == SOLVE_METHOD_RELAX && result.omega != 1) {
+            printf(OMEGA, result.omega);
+        }
+
+        printf(FINAL_CHANGE, result.change);
+
+        if (run->criterionName) {
+            printf(FINAL_MEASURE, run->criterionName, result.measure);
+        }
+
+        if (run->checkpointPath) {
+            printf(CHECKPOINTS_WRITTEN, checkpoints);
+        }
+    }
+
+    int statsError = 0;
+
+    if (solveOptions.stats) {
+        if (run->statsPath && !error) {
+            statsError = writeStatsFile(run->statsPath, solveOptions.stats);
+        }
+
+        freeSolveStats(solveOptions.stats);
+    }
+
+    // Log solution
+    const int outputError = writeOutputGrid(
+        f,
+        f ? TEXT_OUTPUT_FILE : SOLUTION_GRID_FILE,
+        "Solution:\n",
+        values,
+        options->threads
+    );
+
+    if (f) {
+        fclose(f);
+    }
+
+    // Free memory
+    freeGrid(values);
+
+    if (error) {
+        return error;
+    }
+
+    return outputError || statsError ? -1 : 0;
 }
 
 /**
- * Builds array of values based on the problemId given. Checks this is valid,
- * runs solve on these values and writes the solution to file.
+ * Builds a cube of values from the problemId given. Checks this is valid,
+ * runs solve3D on these values and writes the solution to file.
  *
- * @param  problemId ID of problem to solve
- * @param  threads   Number of threads to use (upper bound)
- * @param  precision Precision to work solution to
+ * @param  problemId ID of problem to build the cube from
+ * @param  options   Options to solve with (threads, precision etc.)
+ * @param  run       Options outside solve (whether to write the input)
  *
  * @return           0 if success, -1 if error
  */
-static int runSolve(
+static int runSolve3D(
     const int problemId,
-    const int threads,
-    const double precision
+    const SolveOptions * const options,
+    const RunOptions * const run
 )
 {
     const int dimension = getProblemDimension(problemId);
 
-    double ** const values = createTwoDDoubleArray(dimension);
-    const int result = fillProblemArray(values, problemId);
-
-    if (result == -1) {
+    if (dimension == -1) {
         printf(INVALID_PROBLEM_ID);
 
         return -1;
     }
 
-    FILE * const f = fopen("./output.txt", "w");
+    Grid3D * const values = createGrid3D(dimension);
+
+    if (!values) {
+        printf(OUT_OF_MEMORY);
+
+        return -1;
+    }
+
+    fillProblemGrid3D(values, problemId);
+
+    FILE * const f = fopen(TEXT_OUTPUT_FILE, "w");
+
+    if (!f) {
+        printf(OUTPUT_ERROR, TEXT_OUTPUT_FILE, strerror(errno));
+        freeGrid3D(values);
+
+        return -1;
+    }
 
     // Log input
-    fprintf(f, "Input:\n");
-    write2dDoubleArray(f, values, dimension);
+    if (run->writeInput) {
+        fprintf(f, "Input:\n");
+        writeGrid3D(f, values);
+    }
 
     // Solve and update values
-    int error = solve(values, dimension, threads, precision);
+    SolveResult result;
+    int error = solve3D(values, options, &result);
 
     if (error) {
         printf(PTHREAD_ERROR, error);
+    } else {
+        printf(ITERATIONS, result.iterations);
+
+        if (result.omega != 1) {
+            printf(OMEGA, result.omega);
+        }
+
+        printf(FINAL_CHANGE, result.change);
     }
 
     // Log solution
     fprintf(f, "Solution:\n");
-    write2dDoubleArray(f, values, dimension);
+    writeGrid3D(f, values);
 
     fclose(f);
 
     // Free memory
-    freeTwoDDoubleArray(values, dimension);
+    freeGrid3D(values);
 
     return error ? error : 0;
 }
 
+// A job of a batch, and what happened when it ran
+typedef struct {
+    const ManifestLine * line; // The manifest line (input, precision, output)
+    SolveOptions options; // Options to solve with
+    RunOptions run; // Options outside solve
+    int size; // The dimension of the grid
+    int threads; // Threads the job was solved with
+    int done; // Flag - did the job finish without error
+    SolveResult result; // Result of the solve
+    double loadSeconds; // Time to build or load the grid
+    double solveSeconds; // Time to solve
+    double writeSeconds; // Time to write the output file
+} BatchJob;
+
+/**
+ * Checks that none of the options that cannot be used in a batch are set.
+ * Prints an error message if one is.
+ *
+ * @param  run The options outside solve
+ *
+ * @return     0 if success, -1 if error
+ */
+static int checkBatchOptions(const RunOptions * const run)
+{
+    if (run->checkpointPath
+        || run->resumePath
+        || run->statsPath
+        || run->statsEvery
+        || run->dimensions == 3
+    ) {
+        printf(INVALID_BATCH_OPTION);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Parse a line of a manifest into a batch job, on top of the options given
+ * on the command line, and work out the dimension of its grid. Prints an
+ * error message if the line is invalid.
+ *
+ * @param  line    The line
+ * @param  options Options given on the command line
+ * @param  run     Options outside solve given on the command line
+ * @param  job     Set to the job
+ *
+ * @return         0 if success, -1 if error
+ */
+static int parseBatchJob(
+    const ManifestLine * const line,
+    const SolveOptions * const options,
+    const RunOptions * const run,
+    BatchJob * const job
+)
+{
+    job->line = line;
+    job->options = *options;
+    job->run = *run;
+    job->done = 0;
+
+    if (line->fieldCount < 3) {
+        printf(INVALID_JOB);
+
+        return -1;
+    }
+
+    const char * const input = line->fields[0];
+
+    if (isProblemId(input) && atoi(input) <= 0) {
+        printf(INVALID_PROBLEM_ID);
+
+        return -1;
+    }
+
+    job->options.precision = atof(line->fields[1]);
+
+    if (job->options.precision <= 0) {
+        printf(INVALID_PRECISION);
+
+        return -1;
+    }
+
+    if (parseOptions(
+            line->fieldCount,
+            line->fields,
+            3,
+            &job->options,
+            &job->run
+        ) == -1
+        || checkBatchOptions(&job->run) == -1
+    ) {
+        return -1;
+    }
+
+    if (job->options.affinity != options->affinity
+        || job->options.spinCount != options->spinCount
+        || job->run.splitSize != run->splitSize
+    ) {
+        printf(INVALID_JOB_OPTION);
+
+        return -1;
+    }
+
+    GenerateDistribution distribution;
+
+    if (isProblemId(input)) {
+        job->size = getProblemDimension(atoi(input));
+
+        if (job->size == -1) {
+            printf(INVALID_PROBLEM_ID);
+
+            return -1;
+        }
+    } else if (isGeneratedGrid(input, &distribution)) {
+        job->size = job->run.size;
+    } else {
+        const int error = readGridFileDimension(input, &job->size);
+
+        if (error == EINVAL) {
+            printf(INVALID_GRID_FILE, input);
+        } else if (error) {
+            printf(GRID_FILE_ERROR, input, strerror(error));
+        }
+
+        if (error) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Batch task that runs one job: builds or loads its grid, solves it and
+ * writes the solution (after the input, for text with --write-input=yes)
+ * to its output path, timing each step.
+ *
+ * @param job     The index of the job
+ * @param threads The number of threads to solve with
+ * @param context The solve context to solve with
+ * @param args    The array of BatchJobs
+ */
+static void runBatchJob(
+    const int job,
+    const int threads,
+    SolveContext * const context,
+    void * const args
+)
+{
+    BatchJob * const batchJob = &((BatchJob *) args)[job];
+    const char * const output = batchJob->line->fields[2];
+
+    SolveOptions options = batchJob->options;
+    options.threads = threads;
+    options.context = context;
+
+    batchJob->threads = threads;
+
+    const double loadStart = getMonotonicTime();
+
+    Grid * const values = createInputGrid(
+        batchJob->line->fields[0],
+        &options,
+        &batchJob->run
+    );
+
+    batchJob->loadSeconds = getMonotonicTime() - loadStart;
+
+    if (!values) {
+        return;
+    }
+
+    double writeSeconds = 0;
+    double writeStart = getMonotonicTime();
+    int failed = 0; // Flag - did writing or loading anything fail
+    FILE *f = NULL;
+
+    if (batchJob->run.format == OUTPUT_TEXT) {
+        f = fopen(output, "w");
+
+        if (!f) {
+            printf(OUTPUT_ERROR, output, strerror(errno));
+            freeGrid(values);
+
+            return;
+        }
+
+        if (batchJob->run.writeInput) {
+            failed = writeOutputGrid(f, output, "Input:\n", values, 1);
+        }
+    }
+
+    writeSeconds += getMonotonicTime() - writeStart;
+
+    // Loading the previous solution counts as loading
+    const double warmStart = getMonotonicTime();
+
+    if (!failed && batchJob->run.warmStartPath) {
+        failed = loadWarmStart(values, batchJob->run.warmStartPath);
+    }
+
+    batchJob->loadSeconds += getMonotonicTime() - warmStart;
+
+    const double solveStart = getMonotonicTime();
+    int error = failed ? 0 : solve(values, &options, &batchJob->result);
+    batchJob->solveSeconds = getMonotonicTime() - solveStart;
+
+    if (error) {
+        printf(JOB_ERROR, batchJob->line->lineNumber, error);
+    }
+
+    writeStart = getMonotonicTime();
+
+    if (!error && !failed) {
+        failed = writeOutputGrid(
+            f,
+            output,
+            "Solution:\n",
+            values,
+            threads
+        );
+    }
+
+    if (f) {
+        fclose(f);
+    }
+
+    batchJob->writeSeconds = writeSeconds + getMonotonicTime() - writeStart;
+    batchJob->done = !error && !failed;
+
+    freeGrid(values);
+}
+
+/**
+ * Reads a job manifest, solves every job in it with runBatch, then prints
+ * a line of CSV for each job (in manifest order) and the throughput of the
+ * whole batch. Every line is checked before any job is run.
+ *
+ * @param  path    The path of the manifest
+ * @param  options Options given on the command line (threads etc.)
+ * @param  run     Options outside solve given on the command line
+ *
+ * @return         0 if every job succeeded, -1 otherwise
+ */
+static int runBatchSolve(
+    const char * const path,
+    const SolveOptions * const options,
+    const RunOptions * const run
+)
+{
+    if (checkBatchOptions(run) == -1) {
+        return -1;
+    }
+
+    ManifestLine *lines;
+    int count;
+    int error = readManifest(path, &lines, &count);
+
+    if (error) {
+        printf(MANIFEST_ERROR, path, strerror(error));
+
+        return -1;
+    }
+
+    BatchJob * const jobs = malloc(count * sizeof(BatchJob));
+    int * const sizes = malloc(count * sizeof(int));
+
+    if (count > 0 && (!jobs || !sizes)) {
+        printf(OUT_OF_MEMORY);
+        error = -1;
+    }
+
+    for (int i = 0; i < count && !error; i++) {
+        error = parseBatchJob(&lines[i], options, run, &jobs[i]);
+        sizes[i] = jobs[i].size;
+
+        if (error) {
+            printf(INVALID_MANIFEST_LINE, lines[i].lineNumber, path);
+        }
+    }
+
+    if (!error) {
+        const double start = getMonotonicTime();
+
+        error = runBatch(
+            sizes,
+            count,
+            options,
+            run->splitSize,
+            runBatchJob,
+            jobs
+        );
+
+        const double seconds = getMonotonicTime() - start;
+
+        if (error) {
+            printf(PTHREAD_ERROR, error);
+        }
+
+        printf(BATCH_HEADER);
+
+        int failed = 0;
+
+        for (int i = 0; i < count; i++) {
+            const BatchJob * const job = &jobs[i];
+
+            failed += !job->done;
+
+            printf(
+                BATCH_ROW,
+                job->line->lineNumber,
+                job->line->fields[0],
+                job->line->fields[2],
+                job->size,
+                job->done ? job->threads : 0,
+                job->done ? job->result.iterations : 0,
+                job->done ? job->result.change : 0,
+                job->done ? job->loadSeconds : 0,
+                job->done ? job->solveSeconds : 0,
+                job->done ? job->writeSeconds : 0,
+                job->done ? "ok" : "failed"
+            );
+        }
+
+        printf(
+            BATCH_SUMMARY,
+            count,
+            failed,
+            seconds,
+            seconds > 0 ? count / seconds : 0
+        );
+
+        if (failed) {
+            error = -1;
+        }
+    }
+
+    free(sizes);
+    free(jobs);
+    freeManifest(lines, count);
+
+    return error ? -1 : 0;
+}
+
 /**
  * Main function. Runs simple CLI tool that allows --help/-h, and reports an
  * error if not enough/too many command line parameters are passed.
@@ -113,17 +1676,33 @@ int main(int args, char *argv[])
         return 0;
     }
 
-    if (args != 4) {
+    const char * const manifest = args > 1
+                                  ? getOptionValue(argv[1], "--batch")
+                                  : NULL;
+
+    if (manifest && (args < 3 || isFlag(argv[2]))) {
+        printf(INVALID_BATCH_ARGS);
+
+        return -1;
+    }
+
+    if (!manifest
+        && (args < 4 || isFlag(argv[1]) || isFlag(argv[2]) || isFlag(argv[3]))
+    ) {
         printf(INVALID_NUM_ARGS);
 
         return -1;
     }
 
-    const int problemId = atoi(argv[1]);
-    const int threads = atoi(argv[2]);
-    const double precision = atof(argv[3]);
+    // In batch mode the input and precision are given for each job
+    const char * const input = manifest ? "1" : argv[1];
+    const int availableCpus = getAvailableCpus();
+    const int threads = strcmp(argv[2], "auto") == 0
+                        ? availableCpus
+                        : atoi(argv[2]);
+    const double precision = manifest ? 1 : atof(argv[3]);
 
-    if (problemId <= 0) {
+    if (isProblemId(input) && atoi(input) <= 0) {
         printf(INVALID_PROBLEM_ID);
 
         return -1;
@@ -141,5 +1720,48 @@ int main(int args, char *argv[])
         return -1;
     }
 
-    return runSolve(problemId, threads, precision);
+    SolveOptions options;
+    setDefaultSolveOptions(&options);
+
+    options.threads = threads;
+    options.precision = precision;
+
+    RunOptions run;
+    run.dimensions = 2;
+    run.format = OUTPUT_TEXT;
+    run.writeInput = 1;
+    run.size = 1000;
+    run.seed = 1;
+    run.checkpointPath = NULL;
+    run.checkpointInterval = 60;
+    run.resumePath = NULL;
+    run.statsPath = NULL;
+    run.statsEvery = 0;
+    run.splitSize = 512;
+    run.warmStartPath = NULL;
+    run.criterionName = NULL;
+
+    if (parseOptions(args, argv, manifest ? 3 : 4, &options, &run) == -1) {
+        return -1;
+    }
+
+    if (threads > availableCpus) {
+        printf(OVERSUBSCRIBED, threads, availableCpus);
+    }
+
+    if (manifest) {
+        return runBatchSolve(manifest, &options, &run);
+    }
+
+    if (run.dimensions == 3) {
+        if (!isProblemId(input)) {
+            printf(INVALID_FILE_DIMENSIONS);
+
+            return -1;
+        }
+
+        return runSolve3D(atoi(input), &options, &run);
+    }
+
+    return runSolve(input, &options, &run);
 }
@@ -1,22 +1,351 @@
+/**
+ * Text output of grids. Formatting each value with printf is by far the
+ * slowest part of writing a large grid, so writeGrid has each thread format
+ * a block of rows into its own buffer, then writes the buffers in row order
+ * with one large write each, and repeats until every row is written.
+ *
+ * Values are formatted by formatValue rather than printf where possible. It
+ * works out the six decimal places exactly from the bits of the double, with
+ * ties rounded to even as glibc does, so the output is exactly the same as
+ * formatting each value with "%10f ". It needs 128 bit integers, so with
+ * compilers that lack them every value is formatted with snprintf.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "output.h"
+
+// Roughly how many bytes of text each thread formats at a time
+#define OUTPUT_BLOCK_SIZE (1024 * 1024)
+
+// Characters each value takes up ("%10f "), unless it is very large
+#define VALUE_WIDTH 11
+
+// Values at least this large (2^43) are left to printf, so the value in
+// millionths always fits in 64 bits
+#define FORMAT_LIMIT 8796093022208.0
+
+// 10 to the power of the number of decimal places printed
+#define DECIMAL_SCALE 1000000
+
+// Text formatted by one worker
+typedef struct {
+    char * data; // The text
+    size_t length; // Bytes of text in data
+    size_t capacity; // Size of data in bytes
+    int error; // Set if the worker ran out of memory
+} OutputBuffer;
+
+// struct to pass multiple arguments to the pool task
+typedef struct {
+    const Grid * grid; // The grid being written
+    int firstRow; // First row of the block of worker 0
+    int blockRows; // Rows in each worker's block
+    OutputBuffer * buffers; // Buffer of each worker
+} FormatArgs;
+
+/**
+ * Make sure a buffer has room for a number of bytes after its text, growing
+ * it if need be.
+ *
+ * @param  buffer The buffer
+ * @param  bytes  The number of bytes needed
+ *
+ * @return        0 on success, or ENOMEM
+ */
+static int reserve(OutputBuffer * const buffer, const size_t bytes)
+{
+    if (buffer->capacity - buffer->length >= bytes) {
+        return 0;
+    }
+
+    const size_t capacity = 2 * buffer->capacity + bytes;
+    char * const data = realloc(buffer->data, capacity);
+
+    if (!data) {
+        return ENOMEM;
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+
+    return 0;
+}
+
+#ifdef __SIZEOF_INT128__
+
+/**
+ * Format a value the same way as "%10f " would, if it is finite and less
+ * than FORMAT_LIMIT in size. The double is exactly m * 2^-k for integers m
+ * and k, so the value in millionths is m * 10^6 / 2^k, which is worked out
+ * exactly in 128 bit integers and rounded half to even.
+ *
+ * @param  text  Where to write the text, with room for VALUE_WIDTH + 22
+ *               bytes
+ * @param  value The value to format
+ *
+ * @return       The length of the text, or 0 if the value is too large
+ */
+static int formatValue(char * const text, const double value)
+{
+    if (!(fabs(value) < FORMAT_LIMIT)) {
+        return 0;
+    }
+
+    int exponent;
+    const double fraction = frexp(fabs(value), &exponent);
+
+    // value = mantissa * 2^-shift, with mantissa < 2^53 and shift > 0
+    const uint64_t mantissa = (uint64_t)ldexp(fraction, 53);
+    const int shift = 53 - exponent;
+
+    const unsigned __int128 scaled = (unsigned __int128)mantissa
+                                     * DECIMAL_SCALE;
+    uint64_t millionths;
+
+    if (shift >= 128) {
+        millionths = 0;
+    } else {
+        const unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+        const unsigned __int128 remainder = scaled & (2 * half - 1);
+
+        millionths = (uint64_t)(scaled >> shift);
+
+        if (remainder > half || (remainder == half && (millionths & 1))) {
+            millionths++;
+        }
+    }
+
+    // Digits from the right, then the sign, then pad to the width
+    char digits[32];
+    int length = 0;
+
+    for (int i = 0; i < 6; i++) {
+        digits[length++] = '0' + millionths % 10;
+        millionths /= 10;
+    }
+
+    digits[length++] = '.';
+
+    do {
+        digits[length++] = '0' + millionths % 10;
+        millionths /= 10;
+    } while (millionths);
+
+    // printf keeps the sign of negative values that round to 0
+    if (signbit(value)) {
+        digits[length++] = '-';
+    }
+
+    int position = 0;
+
+    while (position + length < VALUE_WIDTH - 1) {
+        text[position++] = ' ';
+    }
+
+    while (length) {
+        text[position++] = digits[--length];
+    }
+
+    text[position++] = ' ';
+
+    return position;
+}
+
+#endif
+
+/**
+ * Append a value to a buffer, formatted as "%10f ".
+ *
+ * @param  buffer The buffer
+ * @param  value  The value to append
+ *
+ * @return        0 on success, or ENOMEM
+ */
+static int appendValue(OutputBuffer * const buffer, const double value)
+{
+#ifdef __SIZEOF_INT128__
+    char text[VALUE_WIDTH + 22];
+    const int length = formatValue(text, value);
+
+    if (length) {
+        if (reserve(buffer, length)) {
+            return ENOMEM;
+        }
+
+        memcpy(buffer->data + buffer->length, text, length);
+        buffer->length += length;
+
+        return 0;
+    }
+#endif
+
+    while (1) {
+        const size_t space = buffer->capacity - buffer->length;
+        const int length = snprintf(
+            buffer->data + buffer->length,
+            space,
+            "%10f ",
+            value
+        );
+
+        if ((size_t)length < space) {
+            buffer->length += length;
+
+            return 0;
+        }
+
+        // Too long to fit, so grow the buffer and format it again
+        if (reserve(buffer, length + 1)) {
+            return ENOMEM;
+        }
+    }
+}
+
+/**
+ * Pool task that formats one block of rows into the worker's buffer.
+ *
+ * @param workerId The ID of the worker
+ * @param args     FormatArgs shared by all workers
+ */
+static void runFormat(const int workerId, void * const args)
+{
+    FormatArgs * const formatArgs = (FormatArgs *) args;
+    const Grid * const grid = formatArgs->grid;
+    OutputBuffer * const buffer = &formatArgs->buffers[workerId];
+
+    const int rowStart = formatArgs->firstRow
+                         + workerId * formatArgs->blockRows;
+    const int rowEnd = rowStart + formatArgs->blockRows < grid->dimension
+                       ? rowStart + formatArgs->blockRows
+                       : grid->dimension;
+
+    buffer->length = 0;
+
+    for (int row = rowStart; row < rowEnd && !buffer->error; row++) {
+        const double * const values = gridRow(grid, row);
+
+        for (int col = 0; col < grid->dimension && !buffer->error; col++) {
+            buffer->error = appendValue(buffer, values[col]);
+        }
+
+        if (!buffer->error) {
+            buffer->error = reserve(buffer, 1);
+        }
+
+        if (!buffer->error) {
+            buffer->data[buffer->length++] = '\n';
+        }
+    }
+}
+
+/**
+ * Write a grid of doubles to a given file as text, formatting blocks of rows
+ * on several threads and writing them in order.
+ *
+ * @param  f       File handle to write to
+ * @param  grid    Grid of doubles to write to file
+ * @param  threads The number of threads to format with
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int writeGrid(FILE * const f, const Grid * const grid, const int threads)
+{
+    const size_t rowSize = (size_t)grid->dimension * VALUE_WIDTH + 1;
+
+    FormatArgs formatArgs;
+    formatArgs.grid = grid;
+    formatArgs.blockRows = OUTPUT_BLOCK_SIZE / rowSize > 0
+                           ? (int)(OUTPUT_BLOCK_SIZE / rowSize)
+                           : 1;
+    formatArgs.buffers = calloc(threads, sizeof(OutputBuffer));
+
+    if (!formatArgs.buffers) {
+        return ENOMEM;
+    }
+
+    int error = 0;
+
+    for (int i = 0; i < threads && !error; i++) {
+        formatArgs.buffers[i].capacity = formatArgs.blockRows * rowSize + 1;
+        formatArgs.buffers[i].data = malloc(formatArgs.buffers[i].capacity);
+
+        if (!formatArgs.buffers[i].data) {
+            error = ENOMEM;
+        }
+    }
+
+    // A new task per block of rows, so there is nothing to gain from spinning
+    ThreadPool * const pool = error
+                              ? NULL
+                              : createThreadPool(threads, 0, &error);
+
+    for (int firstRow = 0;
+         !error && firstRow < grid->dimension;
+         firstRow += threads * formatArgs.blockRows
+    ) {
+        formatArgs.firstRow = firstRow;
+
+        runThreadPool(pool, runFormat, &formatArgs);
+
+        for (int i = 0; i < threads && !error; i++) {
+            const OutputBuffer * const buffer = &formatArgs.buffers[i];
+
+            if (buffer->error) {
+                error = buffer->error;
+            } else if (fwrite(buffer->data, 1, buffer->length, f)
+                       != buffer->length
+            ) {
+                error = EIO;
+            }
+        }
+    }
+
+    if (pool) {
+        const int poolError = freeThreadPool(pool);
+
+        if (!error) {
+            error = poolError;
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        free(formatArgs.buffers[i].data);
+    }
+
+    free(formatArgs.buffers);
+
+    return error;
+}
 
 /**
- * Write a two dimensional array of doubles to a given file
+ * Write a cube of doubles to a given file, one plane after another with a
+ * blank line between them.
  *
- * @param f         File handle to write to
- * @param array     Two dimensional array of doubles to write to file
- * @param dimension Dimension of array
+ * @param f    File handle to write to
+ * @param grid Cube of doubles to write to file
  */
-void write2dDoubleArray(
-    FILE * const f,
-    double ** const array,
-    const int dimension
-)
+void writeGrid3D(FILE * const f, const Grid3D * const grid)
 {
-    for (int row = 0; row < dimension; ++row) {
-        for (int col = 0; col < dimension; ++col) {
-            fprintf(f, "%10f ", array[row][col]);
+    for (int plane = 0; plane < grid->dimension; ++plane) {
+        if (plane > 0) {
+            fputs("\n", f);
+        }
+
+        for (int row = 0; row < grid->dimension; ++row) {
+            const double * const values = grid3DRow(grid, plane, row);
+
+            for (int col = 0; col < grid->dimension; ++col) {
+                fprintf(f, "%10f ", values[col]);
+            }
+            fputs("\n", f);
         }
-        fputs("\n", f);
     }
 }
@@ -1,12 +1,29 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+
+#include "../array/array.h"
+
 /**
- * Write a two dimensional array of doubles to a given file
+ * Write a grid of doubles to a given file as text, formatting blocks of rows
+ * on several threads and writing them in order.
  *
- * @param f         File handle to write to
- * @param array     Two dimensional array of doubles to write to file
- * @param dimension Dimension of array
+ * @param  f       File handle to write to
+ * @param  grid    Grid of doubles to write to file
+ * @param  threads The number of threads to format with
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int writeGrid(FILE * const f, const Grid * const grid, const int threads);
+
+/**
+ * Write a cube of doubles to a given file, one plane after another with a
+ * blank line between them.
+ *
+ * @param f    File handle to write to
+ * @param grid Cube of doubles to write to file
  */
-void write2dDoubleArray(
-    FILE * const f,
-    double ** const array,
-    const int dimension
-);
+void writeGrid3D(FILE * const f, const Grid3D * const grid);
+
+#endif
@@ -0,0 +1,317 @@
+/**
+ * A simple persistent thread pool. Workers are created once and then sleep
+ * until they are handed a task. Every task is run by every worker (each
+ * worker gets its own ID), so it is up to the task to split up the work. This
+ * suits the solver well, as all work is done in 'passes' that must be
+ * finished by every worker before the next one can start.
+ *
+ * The calling thread always acts as worker 0, which means a pool of 1 thread
+ * creates no extra pthreads at all.
+ *
+ * Handing out a task and waiting for it to finish are both done with a
+ * spin-then-block barrier (see src/barrier/barrier.c), so neither idle workers
+ * nor the calling thread busy-wait for long.
+ *
+ * Workers can be pinned to CPUs (only on Linux), see createPinnedThreadPool.
+ */
+
+// Needed for pthread_attr_setaffinity_np and the CPU_* macros
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "../barrier/barrier.h"
+#include "pool.h"
+
+// struct to pass multiple arguments to worker callback function
+typedef struct {
+    ThreadPool * pool; // The pool the worker belongs to
+    int workerId; // The ID of the worker
+} WorkerArgs;
+
+struct ThreadPool {
+    int threads; // Number of workers, including the calling thread
+    pthread_t * tIds; // IDs of the created pthreads (threads - 1 of them)
+    WorkerArgs * workerArgs; // Arguments for each created pthread
+    Barrier taskStart; // All workers wait here for the next task
+    Barrier taskEnd; // All workers wait here when they finish a task
+    PoolTask task; // The current task
+    void * args; // Argument for the current task
+    int shutdown; // Flag - should the workers exit
+#ifdef __linux__
+    int pinned; // Flag - was the calling thread pinned
+    cpu_set_t callerCpus; // Affinity of the calling thread before pinning
+#endif
+};
+
+/**
+ * Main loop of each created pthread. Waits for a new task to be handed out,
+ * runs it, and waits for all other workers to finish it. The barriers make
+ * sure task, args and shutdown are visible to the worker.
+ *
+ * @param  args WorkerArgs for this worker
+ *
+ * @return      NULL
+ */
+static void *workerLoop(void *args)
+{
+    const WorkerArgs * const workerArgs = (WorkerArgs *) args;
+    ThreadPool * const pool = workerArgs->pool;
+
+    while (1) {
+        waitBarrier(&pool->taskStart);
+
+        if (pool->shutdown) {
+            return NULL;
+        }
+
+        pool->task(workerArgs->workerId, pool->args);
+
+        waitBarrier(&pool->taskEnd);
+    }
+}
+
+/**
+ * Create a pool of the given number of workers. The calling thread counts as
+ * worker 0, so threads - 1 long-lived pthreads are created. Should always be
+ * followed later in the calling code with freeThreadPool.
+ *
+ * @param  threads   The number of workers in the pool (must be at least 1)
+ * @param  spinCount How many times idle workers check for a new task before
+ *                   blocking (see initBarrier)
+ * @param  error     Set to 0 on success, or a pthread error code otherwise
+ *
+ * @return           Pointer to the created pool, or NULL on error
+ */
+ThreadPool *createThreadPool(
+    const int threads,
+    const int spinCount,
+    int * const error
+)
+{
+    return createPinnedThreadPool(threads, spinCount, NULL, error);
+}
+
+/**
+ * The same as createThreadPool, but pins each worker to a given CPU. The
+ * created pthreads are pinned from the start, so everything they allocate or
+ * first touch is local to their CPU. The calling thread is pinned while the
+ * pool exists, and its previous affinity is restored by freeThreadPool.
+ *
+ * @param  threads   The number of workers in the pool (must be at least 1)
+ * @param  spinCount How many times idle workers check for a new task before
+ *                   blocking (see initBarrier)
+ * @param  cpus      The CPU of each worker, or NULL not to pin them
+ * @param  error     Set to 0 on success, ENOTSUP if pinning is not supported
+ *                   on this system, or a pthread error code otherwise
+ *
+ * @return           Pointer to the created pool, or NULL on error
+ */
+ThreadPool *createPinnedThreadPool(
+    const int threads,
+    const int spinCount,
+    const int * const cpus,
+    int * const error
+)
+{
+#ifndef __linux__
+    if (cpus) {
+        *error = ENOTSUP;
+
+        return NULL;
+    }
+#endif
+
+    ThreadPool * const pool = malloc(sizeof(ThreadPool));
+
+    pool->threads = threads;
+    pool->tIds = malloc((threads - 1) * sizeof(pthread_t));
+    pool->workerArgs = malloc((threads - 1) * sizeof(WorkerArgs));
+    pool->task = NULL;
+    pool->args = NULL;
+    pool->shutdown = 0;
+
+    *error = initBarrier(&pool->taskStart, threads, spinCount);
+
+    if (!*error) {
+        *error = initBarrier(&pool->taskEnd, threads, spinCount);
+
+        if (*error) {
+            destroyBarrier(&pool->taskStart);
+        }
+    }
+
+#ifdef __linux__
+    pool->pinned = 0;
+
+    pthread_attr_t attributes;
+
+    if (!*error && cpus) {
+        *error = pthread_attr_init(&attributes);
+
+        if (*error) {
+            destroyBarrier(&pool->taskEnd);
+            destroyBarrier(&pool->taskStart);
+        }
+    }
+#endif
+
+    if (*error) {
+        free(pool->workerArgs);
+        free(pool->tIds);
+        free(pool);
+
+        return NULL;
+    }
+
+    for (int i = 0; i < threads - 1; i++) {
+        pool->workerArgs[i].pool = pool;
+        pool->workerArgs[i].workerId = i + 1;
+
+        pthread_attr_t *workerAttributes = NULL;
+
+#ifdef __linux__
+        if (cpus) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[i + 1], &set);
+
+            *error = pthread_attr_setaffinity_np(
+                &attributes,
+                sizeof(set),
+                &set
+            );
+
+            workerAttributes = &attributes;
+        }
+#endif
+
+        if (!*error) {
+            *error = pthread_create(
+                &pool->tIds[i],
+                workerAttributes,
+                workerLoop,
+                (void *)&pool->workerArgs[i]
+            );
+        }
+
+        if (*error) {
+            // Only wait for and join the workers that were actually created
+            removeFromBarrier(&pool->taskStart, threads - 1 - i);
+            removeFromBarrier(&pool->taskEnd, threads - 1 - i);
+            pool->threads = i + 1;
+
+            break;
+        }
+    }
+
+#ifdef __linux__
+    if (cpus) {
+        pthread_attr_destroy(&attributes);
+    }
+
+    // The calling thread is pinned last, so the pthreads do not inherit its
+    // affinity when they are created
+    if (cpus && !*error) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[0], &set);
+
+        *error = pthread_getaffinity_np(
+            pthread_self(),
+            sizeof(pool->callerCpus),
+            &pool->callerCpus
+        );
+
+        if (!*error) {
+            *error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+
+        pool->pinned = !*error;
+    }
+#endif
+
+    if (*error) {
+        freeThreadPool(pool);
+
+        return NULL;
+    }
+
+    return pool;
+}
+
+/**
+ * Run the given task on every worker in the pool (including the calling
+ * thread as worker 0), and block until all workers have finished it.
+ *
+ * @param pool The pool to run the task on
+ * @param task The callback to run on each worker
+ * @param args Argument passed to every call of task
+ */
+void runThreadPool(ThreadPool * const pool, PoolTask task, void * const args)
+{
+    pool->task = task;
+    pool->args = args;
+
+    waitBarrier(&pool->taskStart);
+
+    // The calling thread does its share of the work too
+    task(0, args);
+
+    waitBarrier(&pool->taskEnd);
+}
+
+/**
+ * Get the number of workers in the pool (including the calling thread).
+ *
+ * @param  pool The pool
+ *
+ * @return      The number of workers
+ */
+int getThreadPoolSize(const ThreadPool * const pool)
+{
+    return pool->threads;
+}
+
+/**
+ * Stop all workers in the pool, join them and free the pool.
+ *
+ * @param  pool The pool to free
+ *
+ * @return      0 on success, or a pthread error code otherwise
+ */
+int freeThreadPool(ThreadPool * const pool)
+{
+    pool->shutdown = 1;
+
+    waitBarrier(&pool->taskStart);
+
+    for (int i = 0; i < pool->threads - 1; i++) {
+        const int error = pthread_join(pool->tIds[i], NULL);
+
+        if (error) {
+            return error;
+        }
+    }
+
+    destroyBarrier(&pool->taskEnd);
+    destroyBarrier(&pool->taskStart);
+
+#ifdef __linux__
+    if (pool->pinned) {
+        pthread_setaffinity_np(
+            pthread_self(),
+            sizeof(pool->callerCpus),
+            &pool->callerCpus
+        );
+    }
+#endif
+
+    free(pool->workerArgs);
+    free(pool->tIds);
+    free(pool);
+
+    return 0;
+}
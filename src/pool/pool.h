@@ -0,0 +1,83 @@
+#ifndef POOL_H
+#define POOL_H
+
+/**
+ * Callback run by every worker in a thread pool. The workerId is in the range
+ * [0, number of workers) and can be used to split up work between workers.
+ */
+typedef void (*PoolTask)(const int workerId, void * const args);
+
+/**
+ * Opaque thread pool type. See src/pool/pool.c for details.
+ */
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * Create a pool of the given number of workers. The calling thread counts as
+ * worker 0, so threads - 1 long-lived pthreads are created. Should always be
+ * followed later in the calling code with freeThreadPool.
+ *
+ * @param  threads   The number of workers in the pool (must be at least 1)
+ * @param  spinCount How many times idle workers check for a new task before
+ *                   blocking (see initBarrier)
+ * @param  error     Set to 0 on success, or a pthread error code otherwise
+ *
+ * @return           Pointer to the created pool, or NULL on error
+ */
+ThreadPool *createThreadPool(
+    const int threads,
+    const int spinCount,
+    int * const error
+);
+
+/**
+ * The same as createThreadPool, but pins each worker to a given CPU. The
+ * created pthreads are pinned from the start, so everything they allocate or
+ * first touch is local to their CPU. The calling thread is pinned while the
+ * pool exists, and its previous affinity is restored by freeThreadPool.
+ *
+ * @param  threads   The number of workers in the pool (must be at least 1)
+ * @param  spinCount How many times idle workers check for a new task before
+ *                   blocking (see initBarrier)
+ * @param  cpus      The CPU of each worker, or NULL not to pin them
+ * @param  error     Set to 0 on success, ENOTSUP if pinning is not supported
+ *                   on this system, or a pthread error code otherwise
+ *
+ * @return           Pointer to the created pool, or NULL on error
+ */
+ThreadPool *createPinnedThreadPool(
+    const int threads,
+    const int spinCount,
+    const int * const cpus,
+    int * const error
+);
+
+/**
+ * Run the given task on every worker in the pool (including the calling
+ * thread as worker 0), and block until all workers have finished it.
+ *
+ * @param pool The pool to run the task on
+ * @param task The callback to run on each worker
+ * @param args Argument passed to every call of task
+ */
+void runThreadPool(ThreadPool * const pool, PoolTask task, void * const args);
+
+/**
+ * Get the number of workers in the pool (including the calling thread).
+ *
+ * @param  pool The pool
+ *
+ * @return      The number of workers
+ */
+int getThreadPoolSize(const ThreadPool * const pool);
+
+/**
+ * Stop all workers in the pool, join them and free the pool.
+ *
+ * @param  pool The pool to free
+ *
+ * @return      0 on success, or a pthread error code otherwise
+ */
+int freeThreadPool(ThreadPool * const pool);
+
+#endif
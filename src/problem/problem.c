@@ -9,9 +9,13 @@
  *   6: 200 x 200
  *
  * It also defines functions to take a two dimensional array and fill it with
- * one of these problems.
+ * one of these problems, or a three dimensional one with a cube built from
+ * one of them.
  */
 
+#include "../array/array.h"
+#include "problem.h"
+
 #define PROBLEM_1_DIMENSION 4
 #define PROBLEM_2_DIMENSION 5
 #define PROBLEM_3_DIMENSION 9
@@ -370,14 +374,15 @@ const int getProblemDimension(const int problemId)
 }
 
 /**
- * Fill the given two dimensional array with the values of the specified problem
+ * Fill the given grid with the values of the specified problem. The grid must
+ * have the dimension of the problem (see getProblemDimension).
  *
- * @param  values    The array to fill
+ * @param  values    The grid to fill
  * @param  problemId The ID of the problem to copy into values
  *
  * @return           0 if success, -1 if error
  */
-const int fillProblemArray(double ** const values, const int problemId)
+const int fillProblemArray(Grid * const values, const int problemId)
 {
     const int dimension = getProblemDimension(problemId);
 
@@ -386,10 +391,49 @@ const int fillProblemArray(double ** const values, const int problemId)
     }
 
     for (int row = 0; row < dimension; row++) {
+        double * const valuesRow = gridRow(values, row);
+
         for (int col = 0; col < dimension; col++) {
             // Fine to call this here, as we have already checked
             // dimension and problemId are valid above.
-            values[row][col] = getProblemPoint(problemId, row, col);
+            valuesRow[col] = getProblemPoint(problemId, row, col);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Fill the given cube with a three dimensional version of the specified
+ * problem. The cube must have the dimension of the problem (see
+ * getProblemDimension). Plane p is the problem's grid with its columns
+ * rotated left by p, so every plane, and every face of the cube, is
+ * different.
+ *
+ * @param  values    The cube to fill
+ * @param  problemId The ID of the problem to build values from
+ *
+ * @return           0 if success, -1 if error
+ */
+const int fillProblemGrid3D(Grid3D * const values, const int problemId)
+{
+    const int dimension = getProblemDimension(problemId);
+
+    if (dimension == -1) {
+        return -1;
+    }
+
+    for (int plane = 0; plane < dimension; plane++) {
+        for (int row = 0; row < dimension; row++) {
+            double * const valuesRow = grid3DRow(values, plane, row);
+
+            for (int col = 0; col < dimension; col++) {
+                valuesRow[col] = getProblemPoint(
+                    problemId,
+                    row,
+                    (col + plane) % dimension
+                );
+            }
         }
     }
 
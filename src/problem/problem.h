@@ -1,3 +1,8 @@
+#ifndef PROBLEM_H
+#define PROBLEM_H
+
+#include "../array/array.h"
+
 /**
  * Get the dimension of the specified problem
  *
@@ -9,11 +14,26 @@
 const int getProblemDimension(const int problemId);
 
 /**
- * Fill the given two dimensional array with the values of the specified problem
+ * Fill the given grid with the values of the specified problem. The grid must
+ * have the dimension of the problem (see getProblemDimension).
  *
- * @param  values    The array to fill
+ * @param  values    The grid to fill
  * @param  problemId The ID of the problem to copy into values
  *
  * @return           0 if success, -1 if error
  */
-const int fillProblemArray(double ** const values, const int problemId);
+const int fillProblemArray(Grid * const values, const int problemId);
+
+/**
+ * Fill the given cube with a three dimensional version of the specified
+ * problem. The cube must have the dimension of the problem (see
+ * getProblemDimension).
+ *
+ * @param  values    The cube to fill
+ * @param  problemId The ID of the problem to build values from
+ *
+ * @return           0 if success, -1 if error
+ */
+const int fillProblemGrid3D(Grid3D * const values, const int problemId);
+
+#endif
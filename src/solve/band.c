@@ -0,0 +1,254 @@
+/**
+ * Helpers shared by the solvers that split the interior rows of the grid into
+ * one band per worker.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "../affinity/affinity.h"
+#include "../pool/pool.h"
+#include "solve.h"
+#include "band.h"
+#include "context.h"
+
+// Number of times a thread checks a barrier before blocking with
+// SOLVE_SPIN_AUTO. Long enough to cover the gap between balanced workers,
+// short enough (a few microseconds) not to waste a core when a worker is idle.
+#define AUTO_SPIN_COUNT 2000
+
+/**
+ * Work out the band of interior rows owned by a given worker. Rows are split
+ * as evenly as possible, with the first (interior rows % workers) workers
+ * getting one extra row. If there are more workers than rows, some workers
+ * get an empty band (rowStart == rowEnd).
+ *
+ * @param workerId  The ID of the worker
+ * @param workers   The total number of workers
+ * @param dimension The dimension of the two dimensional array we are solving
+ * @param rowStart  Set to the first row in the band
+ * @param rowEnd    Set to one past the last row in the band
+ */
+void getBand(
+    const int workerId,
+    const int workers,
+    const int dimension,
+    int * const rowStart,
+    int * const rowEnd
+)
+{
+    const int interiorRows = dimension > 2 ? dimension - 2 : 0;
+    const int rowsPerWorker = interiorRows / workers;
+    const int extraRows = interiorRows % workers;
+
+    *rowStart = 1 + workerId * rowsPerWorker
+                + (workerId < extraRows ? workerId : extraRows);
+    *rowEnd = *rowStart + rowsPerWorker + (workerId < extraRows ? 1 : 0);
+}
+
+/**
+ * The same as getBand, but the first worker's band also takes in the top
+ * edge row and the last worker's the bottom edge row, so the bands cover
+ * every row of the grid.
+ *
+ * @param workerId  The ID of the worker
+ * @param workers   The total number of workers
+ * @param dimension The dimension of the two dimensional array we are solving
+ * @param rowStart  Set to the first row in the band
+ * @param rowEnd    Set to one past the last row in the band
+ */
+void getBandWithEdges(
+    const int workerId,
+    const int workers,
+    const int dimension,
+    int * const rowStart,
+    int * const rowEnd
+)
+{
+    getBand(workerId, workers, dimension, rowStart, rowEnd);
+
+    if (workerId == 0) {
+        *rowStart = 0;
+    }
+
+    if (workerId == workers - 1) {
+        *rowEnd = dimension;
+    }
+}
+
+/**
+ * Work out how long waiting workers should spin with the given options,
+ * resolving SOLVE_SPIN_AUTO.
+ *
+ * @param  options Options controlling the solve (threads and spinCount are
+ *                 used)
+ *
+ * @return         The spin count
+ */
+int getSolveSpinCount(const SolveOptions * const options)
+{
+    if (options->spinCount != SOLVE_SPIN_AUTO) {
+        return options->spinCount;
+    }
+
+    // Spinning only helps if the thread we are waiting for is running. With
+    // more threads than CPUs it just steals time from it.
+    return options->threads <= getAvailableCpus() ? AUTO_SPIN_COUNT : 0;
+}
+
+/**
+ * Create the thread pool for a solve, with options->threads workers pinned
+ * to CPUs according to options->affinity, or use the pool of
+ * options->context if there is one. Should always be followed later in the
+ * calling code with releaseSolvePool.
+ *
+ * @param  options Options controlling the solve (threads, spinCount,
+ *                 affinity and context are used)
+ * @param  error   Set to 0 on success, or an error code otherwise
+ *
+ * @return         Pointer to the pool, or NULL on error
+ */
+ThreadPool *createSolvePool(
+    const SolveOptions * const options,
+    int * const error
+)
+{
+    if (options->context) {
+        return getSolveContextPool(options->context, options, error);
+    }
+
+    if (options->affinity == AFFINITY_NONE) {
+        return createThreadPool(options->threads, options->spinCount, error);
+    }
+
+    int * const cpus = malloc(options->threads * sizeof(int));
+
+    if (!cpus) {
+        *error = ENOMEM;
+
+        return NULL;
+    }
+
+    *error = getAffinityCpus(options->affinity, options->threads, cpus);
+
+    ThreadPool * const pool = *error
+                              ? NULL
+                              : createPinnedThreadPool(
+                                    options->threads,
+                                    options->spinCount,
+                                    cpus,
+                                    error
+                                );
+
+    free(cpus);
+
+    return pool;
+}
+
+/**
+ * Free a pool from createSolvePool, unless it belongs to options->context.
+ *
+ * @param  options Options controlling the solve (only context is used)
+ * @param  pool    The pool
+ *
+ * @return         0 on success, or a pthread error code otherwise
+ */
+int releaseSolvePool(
+    const SolveOptions * const options,
+    ThreadPool * const pool
+)
+{
+    return options->context ? 0 : freeThreadPool(pool);
+}
+
+/**
+ * Reduce the per-worker results of a sweep to the largest change of any
+ * point in the whole grid.
+ *
+ * @param  results The result of each worker
+ * @param  threads The number of workers
+ *
+ * @return         The largest change of any worker
+ */
+double maxWorkerChange(
+    const WorkerResult * const results,
+    const int threads
+)
+{
+    double maxChange = 0;
+
+    for (int i = 0; i < threads; i++) {
+        if (results[i].maxChange > maxChange) {
+            maxChange = results[i].maxChange;
+        }
+    }
+
+    return maxChange;
+}
+
+/**
+ * Add one worker's norms of some points to the norms of the whole grid.
+ *
+ * @param total The norms of the whole grid so far
+ * @param part  The norms of the worker
+ */
+static void addChangeNorms(ChangeNorms * const total, const ChangeNorms part)
+{
+    if (part.max > total->max) {
+        total->max = part.max;
+    }
+
+    total->squares += part.squares;
+}
+
+/**
+ * Reduce the per-worker norms of a sweep to the norms of the whole grid:
+ * the largest of each maximum, and the sum of each sum of squares, added in
+ * the same order every time.
+ *
+ * @param results The result of each worker
+ * @param threads The number of workers
+ * @param total   Set to the norms of the whole grid
+ */
+void sumWorkerNorms(
+    const WorkerResult * const results,
+    const int threads,
+    SweepNorms * const total
+)
+{
+    const ChangeNorms zero = {0, 0};
+
+    total->even = zero;
+    total->odd = zero;
+    total->previousOdd = zero;
+
+    for (int i = 0; i < threads; i++) {
+        addChangeNorms(&total->even, results[i].norms.even);
+        addChangeNorms(&total->odd, results[i].norms.odd);
+        addChangeNorms(&total->previousOdd, results[i].norms.previousOdd);
+    }
+}
+
+/**
+ * Add up the per-worker parts of a sum over the grid. They are always added
+ * in the same order, so the total does not depend on which worker finished
+ * first.
+ *
+ * @param  results The result of each worker
+ * @param  threads The number of workers
+ *
+ * @return         The total
+ */
+double sumWorkerResults(
+    const WorkerResult * const results,
+    const int threads
+)
+{
+    double sum = 0;
+
+    for (int i = 0; i < threads; i++) {
+        sum += results[i].sum;
+    }
+
+    return sum;
+}
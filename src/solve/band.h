@@ -0,0 +1,145 @@
+#ifndef BAND_H
+#define BAND_H
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "solve.h"
+#include "criterion.h"
+
+// Assumed size of a cache line, used to stop per-worker results sharing one
+#define CACHE_LINE_SIZE 64
+
+// Per-worker result of a sweep, padded to a cache line to avoid false sharing.
+// Arrays of them are aligned to a cache line too (see takeScratchResults).
+typedef union {
+    double maxChange; // Largest change of any point the worker relaxed
+    double sum; // The worker's part of a sum over the grid (e.g. a dot product)
+    SweepNorms norms; // Changes of the points the worker relaxed in a sweep
+    char padding[CACHE_LINE_SIZE];
+} WorkerResult;
+
+/**
+ * Work out the band of interior rows owned by a given worker. Rows are split
+ * as evenly as possible, with the first (interior rows % workers) workers
+ * getting one extra row. If there are more workers than rows, some workers
+ * get an empty band (rowStart == rowEnd).
+ *
+ * @param workerId  The ID of the worker
+ * @param workers   The total number of workers
+ * @param dimension The dimension of the two dimensional array we are solving
+ * @param rowStart  Set to the first row in the band
+ * @param rowEnd    Set to one past the last row in the band
+ */
+void getBand(
+    const int workerId,
+    const int workers,
+    const int dimension,
+    int * const rowStart,
+    int * const rowEnd
+);
+
+/**
+ * The same as getBand, but the first worker's band also takes in the top
+ * edge row and the last worker's the bottom edge row, so the bands cover
+ * every row of the grid.
+ *
+ * @param workerId  The ID of the worker
+ * @param workers   The total number of workers
+ * @param dimension The dimension of the two dimensional array we are solving
+ * @param rowStart  Set to the first row in the band
+ * @param rowEnd    Set to one past the last row in the band
+ */
+void getBandWithEdges(
+    const int workerId,
+    const int workers,
+    const int dimension,
+    int * const rowStart,
+    int * const rowEnd
+);
+
+/**
+ * Work out how long waiting workers should spin with the given options,
+ * resolving SOLVE_SPIN_AUTO.
+ *
+ * @param  options Options controlling the solve (threads and spinCount are
+ *                 used)
+ *
+ * @return         The spin count
+ */
+int getSolveSpinCount(const SolveOptions * const options);
+
+/**
+ * Create the thread pool for a solve, with options->threads workers pinned
+ * to CPUs according to options->affinity, or use the pool of
+ * options->context if there is one. Should always be followed later in the
+ * calling code with releaseSolvePool.
+ *
+ * @param  options Options controlling the solve (threads, spinCount,
+ *                 affinity and context are used)
+ * @param  error   Set to 0 on success, or an error code otherwise
+ *
+ * @return         Pointer to the pool, or NULL on error
+ */
+ThreadPool *createSolvePool(
+    const SolveOptions * const options,
+    int * const error
+);
+
+/**
+ * Free a pool from createSolvePool, unless it belongs to options->context.
+ *
+ * @param  options Options controlling the solve (only context is used)
+ * @param  pool    The pool
+ *
+ * @return         0 on success, or a pthread error code otherwise
+ */
+int releaseSolvePool(
+    const SolveOptions * const options,
+    ThreadPool * const pool
+);
+
+/**
+ * Reduce the per-worker results of a sweep to the largest change of any
+ * point in the whole grid.
+ *
+ * @param  results The result of each worker
+ * @param  threads The number of workers
+ *
+ * @return         The largest change of any worker
+ */
+double maxWorkerChange(
+    const WorkerResult * const results,
+    const int threads
+);
+
+/**
+ * Reduce the per-worker norms of a sweep to the norms of the whole grid:
+ * the largest of each maximum, and the sum of each sum of squares, added in
+ * the same order every time.
+ *
+ * @param results The result of each worker
+ * @param threads The number of workers
+ * @param total   Set to the norms of the whole grid
+ */
+void sumWorkerNorms(
+    const WorkerResult * const results,
+    const int threads,
+    SweepNorms * const total
+);
+
+/**
+ * Add up the per-worker parts of a sum over the grid. They are always added
+ * in the same order, so the total does not depend on which worker finished
+ * first.
+ *
+ * @param  results The result of each worker
+ * @param  threads The number of workers
+ *
+ * @return         The total
+ */
+double sumWorkerResults(
+    const WorkerResult * const results,
+    const int threads
+);
+
+#endif
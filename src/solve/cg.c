@@ -0,0 +1,465 @@
+/**
+ * Preconditioned conjugate gradient, without ever forming the matrix.
+ *
+ * The interior points u of the grid are the unknowns of A u = b, where
+ * (A u) at a point is 4 times its value minus the values of its four
+ * neighbours, and b holds the fixed edge values next to each point. So the
+ * residual b - A u at a point is simply the sum of its neighbours (edges
+ * included) minus 4 times its value, and A p for a search direction p (which
+ * is 0 on the edges) is 4 times each point minus the sum of its neighbours.
+ *
+ * Relaxing a point changes it by its residual / 4, so to stop at the same
+ * precision as relaxation we stop once the largest residual is less than
+ * 4 * precision.
+ *
+ * All workers run the whole solve as a single pool task, each working on its
+ * own band of rows (see src/solve/band.c). Dot products are summed per worker
+ * and then added in worker order, so a given number of threads always gives
+ * the same result. Each iteration needs three barriers with the Jacobi
+ * preconditioner and five with SSOR.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "../barrier/barrier.h"
+#include "solve.h"
+#include "band.h"
+#include "context.h"
+#include "cg.h"
+
+// struct to pass multiple arguments to the pool task
+typedef struct {
+    Grid * u; // The values being solved
+    Grid * r; // Residual, b - A u
+    Grid * z; // Preconditioned residual
+    Grid * p; // Search direction
+    Grid * q; // A p
+    SolvePreconditioner preconditioner; // The preconditioner to use
+    double precision; // The precision to work to
+    int threads; // The number of workers
+    Barrier barrier; // Barrier between steps
+    WorkerResult * rz; // Each worker's part of r . z
+    WorkerResult * pq; // Each worker's part of p . q
+    WorkerResult * residual; // Largest residual in each worker's band
+    int iterations; // Iterations done, set by worker 0
+} CgArgs;
+
+/**
+ * Work out the residual r = b - A u in a band of rows, and start
+ * preconditioning it with z = r / 4 (all of Jacobi, and the first half-sweep
+ * of SSOR for 'E' points).
+ *
+ * @param  args     CgArgs shared by all workers
+ * @param  rowStart The first row of the band
+ * @param  rowEnd   One past the last row of the band
+ * @param  rz       Set to the band's part of r . z
+ *
+ * @return          The largest residual in the band
+ */
+static double computeResidualBand(
+    CgArgs * const args,
+    const int rowStart,
+    const int rowEnd,
+    double * const rz
+)
+{
+    const int dimension = args->u->dimension;
+
+    double maxResidual = 0;
+    double sum = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const u = gridRow(args->u, row);
+        const double * const above = gridRow(args->u, row - 1);
+        const double * const below = gridRow(args->u, row + 1);
+        double * const r = gridRow(args->r, row);
+        double * const z = gridRow(args->z, row);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            r[col] = u[col - 1] + u[col + 1] + above[col] + below[col]
+                     - 4 * u[col];
+            z[col] = r[col] / 4;
+
+            sum += r[col] * z[col];
+
+            if (fabs(r[col]) > maxResidual) {
+                maxResidual = fabs(r[col]);
+            }
+        }
+    }
+
+    *rz = sum;
+
+    return maxResidual;
+}
+
+/**
+ * Set p = z + beta p in a band of rows.
+ *
+ * @param args     CgArgs shared by all workers
+ * @param rowStart The first row of the band
+ * @param rowEnd   One past the last row of the band
+ * @param beta     The multiple of the old search direction to keep
+ */
+static void updateDirectionBand(
+    CgArgs * const args,
+    const int rowStart,
+    const int rowEnd,
+    const double beta
+)
+{
+    const int dimension = args->u->dimension;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const z = gridRow(args->z, row);
+        double * const p = gridRow(args->p, row);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            p[col] = z[col] + beta * p[col];
+        }
+    }
+}
+
+/**
+ * Set q = A p in a band of rows.
+ *
+ * @param  args     CgArgs shared by all workers
+ * @param  rowStart The first row of the band
+ * @param  rowEnd   One past the last row of the band
+ *
+ * @return          The band's part of p . q
+ */
+static double applyOperatorBand(
+    CgArgs * const args,
+    const int rowStart,
+    const int rowEnd
+)
+{
+    const int dimension = args->u->dimension;
+
+    double sum = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const p = gridRow(args->p, row);
+        const double * const above = gridRow(args->p, row - 1);
+        const double * const below = gridRow(args->p, row + 1);
+        double * const q = gridRow(args->q, row);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            q[col] = 4 * p[col]
+                     - (p[col - 1] + p[col + 1] + above[col] + below[col]);
+
+            sum += p[col] * q[col];
+        }
+    }
+
+    return sum;
+}
+
+/**
+ * Set u += alpha p and r -= alpha q in a band of rows, and start
+ * preconditioning the new residual with z = r / 4 (see computeResidualBand).
+ *
+ * @param  args     CgArgs shared by all workers
+ * @param  rowStart The first row of the band
+ * @param  rowEnd   One past the last row of the band
+ * @param  alpha    The step length along p
+ * @param  rz       Set to the band's part of r . z
+ *
+ * @return          The largest residual in the band
+ */
+static double updateSolutionBand(
+    CgArgs * const args,
+    const int rowStart,
+    const int rowEnd,
+    const double alpha,
+    double * const rz
+)
+{
+    const int dimension = args->u->dimension;
+
+    double maxResidual = 0;
+    double sum = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        double * const u = gridRow(args->u, row);
+        double * const r = gridRow(args->r, row);
+        double * const z = gridRow(args->z, row);
+        const double * const p = gridRow(args->p, row);
+        const double * const q = gridRow(args->q, row);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            u[col] += alpha * p[col];
+            r[col] -= alpha * q[col];
+            z[col] = r[col] / 4;
+
+            sum += r[col] * z[col];
+
+            if (fabs(r[col]) > maxResidual) {
+                maxResidual = fabs(r[col]);
+            }
+        }
+    }
+
+    *rz = sum;
+
+    return maxResidual;
+}
+
+/**
+ * One of the last two half-sweeps of the SSOR preconditioner in a band of
+ * rows, solving (D + L) D^-1 (D + U) z = r with 'E' points ordered first.
+ * The first half-sweep (z = r / 4 for 'E' points) is done along with the
+ * residual. Then 'O' points are set to z = (r + sum of 'E' neighbours) / 4,
+ * and finally 'E' points have (sum of 'O' neighbours) / 4 added.
+ *
+ * @param  args          CgArgs shared by all workers
+ * @param  rowStart      The first row of the band
+ * @param  rowEnd        One past the last row of the band
+ * @param  oddPointsFlag 1 for the 'O' half-sweep, 0 for the final 'E' one
+ *
+ * @return               The band's part of r . z for the points updated
+ */
+static double relaxPreconditionerBand(
+    CgArgs * const args,
+    const int rowStart,
+    const int rowEnd,
+    const int oddPointsFlag
+)
+{
+    const int dimension = args->u->dimension;
+
+    double sum = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const r = gridRow(args->r, row);
+        double * const z = gridRow(args->z, row);
+        const double * const above = gridRow(args->z, row - 1);
+        const double * const below = gridRow(args->z, row + 1);
+
+        const int firstCol = 2 - ((row + oddPointsFlag) & 1);
+
+        for (int col = firstCol; col < dimension - 1; col += 2) {
+            const double neighbours = z[col - 1] + z[col + 1]
+                                      + above[col] + below[col];
+
+            if (oddPointsFlag) {
+                z[col] = (r[col] + neighbours) / 4;
+            } else {
+                z[col] += neighbours / 4;
+            }
+
+            sum += r[col] * z[col];
+        }
+    }
+
+    return sum;
+}
+
+/**
+ * Finish preconditioning the residual in a band of rows. Only SSOR has
+ * anything left to do (see relaxPreconditionerBand). Starts with a barrier,
+ * as the residual has just been worked out.
+ *
+ * @param  args     CgArgs shared by all workers
+ * @param  rowStart The first row of the band
+ * @param  rowEnd   One past the last row of the band
+ * @param  rz       The band's part of r . z for Jacobi
+ *
+ * @return          The band's part of r . z
+ */
+static double finishPreconditionerBand(
+    CgArgs * const args,
+    const int rowStart,
+    const int rowEnd,
+    const double rz
+)
+{
+    if (args->preconditioner != SOLVE_PRECONDITIONER_SSOR) {
+        return rz;
+    }
+
+    waitBarrier(&args->barrier);
+
+    const double oddSum = relaxPreconditionerBand(args, rowStart, rowEnd, 1);
+
+    waitBarrier(&args->barrier);
+
+    return oddSum + relaxPreconditionerBand(args, rowStart, rowEnd, 0);
+}
+
+/**
+ * Pool task for SOLVE_METHOD_CG. Every worker works out alpha and beta from
+ * the same per-worker sums, so they all agree on them and on when to stop.
+ * Each array of per-worker results is only written again after every worker
+ * has passed the barrier after which it is read, so no more barriers are
+ * needed to protect them.
+ *
+ * @param workerId The ID of the worker
+ * @param args     CgArgs shared by all workers
+ */
+static void runConjugateGradient(const int workerId, void * const args)
+{
+    CgArgs * const cgArgs = (CgArgs *) args;
+    const int threads = cgArgs->threads;
+
+    int rowStart, rowEnd;
+    getBand(workerId, threads, cgArgs->u->dimension, &rowStart, &rowEnd);
+
+    double rz;
+
+    cgArgs->residual[workerId].maxChange = computeResidualBand(
+        cgArgs,
+        rowStart,
+        rowEnd,
+        &rz
+    );
+    cgArgs->rz[workerId].sum = finishPreconditionerBand(
+        cgArgs,
+        rowStart,
+        rowEnd,
+        rz
+    );
+
+    waitBarrier(&cgArgs->barrier);
+
+    rz = sumWorkerResults(cgArgs->rz, threads);
+
+    // p starts as 0, so the first direction is z
+    double beta = 0;
+    int iterations = 0;
+
+    while (maxWorkerChange(cgArgs->residual, threads) / 4
+           >= cgArgs->precision
+    ) {
+        updateDirectionBand(cgArgs, rowStart, rowEnd, beta);
+
+        waitBarrier(&cgArgs->barrier);
+
+        cgArgs->pq[workerId].sum = applyOperatorBand(cgArgs, rowStart, rowEnd);
+
+        waitBarrier(&cgArgs->barrier);
+
+        const double alpha = rz / sumWorkerResults(cgArgs->pq, threads);
+
+        double newRz;
+
+        cgArgs->residual[workerId].maxChange = updateSolutionBand(
+            cgArgs,
+            rowStart,
+            rowEnd,
+            alpha,
+            &newRz
+        );
+        cgArgs->rz[workerId].sum = finishPreconditionerBand(
+            cgArgs,
+            rowStart,
+            rowEnd,
+            newRz
+        );
+
+        waitBarrier(&cgArgs->barrier);
+
+        newRz = sumWorkerResults(cgArgs->rz, threads);
+        beta = newRz / rz;
+        rz = newRz;
+
+        iterations++;
+    }
+
+    if (workerId == 0) {
+        cgArgs->iterations = iterations;
+    }
+}
+
+/**
+ * Solve the given values array with SOLVE_METHOD_CG, and update it to the
+ * solution. Stops once relaxing any point would change it by less than the
+ * precision, i.e. the largest residual is less than 4 * precision.
+ *
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveConjugateGradient(
+    Grid * const values,
+    const SolveOptions * const options,
+    SolveResult * const result
+)
+{
+    const int threads = options->threads;
+    const int dimension = values->dimension;
+
+    int error = 0;
+
+    CgArgs cgArgs;
+    cgArgs.u = values;
+    cgArgs.r = takeScratchGrid(options, dimension);
+    cgArgs.z = takeScratchGrid(options, dimension);
+    cgArgs.p = takeScratchGrid(options, dimension);
+    cgArgs.q = takeScratchGrid(options, dimension);
+    cgArgs.preconditioner = options->preconditioner;
+    cgArgs.precision = options->precision;
+    cgArgs.threads = threads;
+    cgArgs.rz = takeScratchResults(options);
+    cgArgs.pq = takeScratchResults(options);
+    cgArgs.residual = takeScratchResults(options);
+    cgArgs.iterations = 0;
+
+    if (!cgArgs.r || !cgArgs.z || !cgArgs.p || !cgArgs.q
+        || !cgArgs.rz || !cgArgs.pq || !cgArgs.residual
+    ) {
+        error = ENOMEM;
+    }
+
+    if (!error) {
+        // The edges of every grid but u must stay 0
+        clearGrid(cgArgs.r);
+        clearGrid(cgArgs.z);
+        clearGrid(cgArgs.p);
+        clearGrid(cgArgs.q);
+
+        ThreadPool * const pool = createSolvePool(options, &error);
+
+        if (!error) {
+            error = initBarrier(&cgArgs.barrier, threads, options->spinCount);
+
+            if (!error) {
+                runThreadPool(pool, runConjugateGradient, &cgArgs);
+
+                destroyBarrier(&cgArgs.barrier);
+            }
+
+            const int poolError = releaseSolvePool(options, pool);
+
+            if (!error) {
+                error = poolError;
+            }
+        }
+    }
+
+    result->iterations = cgArgs.iterations;
+
+    // The change relaxing the worst point would make (see top of file)
+    if (!error) {
+        result->change = maxWorkerChange(cgArgs.residual, threads) / 4;
+    }
+
+    releaseScratchResults(options, cgArgs.residual);
+    releaseScratchResults(options, cgArgs.pq);
+    releaseScratchResults(options, cgArgs.rz);
+
+    Grid * const grids[] = {cgArgs.r, cgArgs.z, cgArgs.p, cgArgs.q};
+
+    for (int i = 0; i < 4; i++) {
+        releaseScratchGrid(options, grids[i]);
+    }
+
+    return error;
+}
@@ -0,0 +1,24 @@
+#ifndef CG_H
+#define CG_H
+
+#include "../array/array.h"
+#include "solve.h"
+
+/**
+ * Solve the given values array with SOLVE_METHOD_CG, and update it to the
+ * solution. Stops once relaxing any point would change it by less than the
+ * precision, i.e. the largest residual is less than 4 * precision.
+ *
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveConjugateGradient(
+    Grid * const values,
+    const SolveOptions * const options,
+    SolveResult * const result
+);
+
+#endif
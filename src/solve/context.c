@@ -0,0 +1,520 @@
+/**
+ * A solve context keeps everything a solve sets up between solves: the
+ * thread pool (with its pinned workers), and the scratch buffers the solvers
+ * work in (split copies of the grid, the second Jacobi buffer, conjugate
+ * gradient vectors, multigrid levels and per-worker results).
+ *
+ * The solvers ask for scratch buffers with takeScratchGrid and friends, and
+ * give them back at the end of the solve. Without a context these just
+ * create and free the buffer. With one, given-back buffers are kept in a
+ * list, and the next request for a buffer of the same kind and size reuses
+ * one, so repeated solves of the same size allocate nothing, and the pages
+ * of each buffer are already mapped (and local to the worker that first
+ * touched them). At the end of each solve, buffers it did not use are freed.
+ *
+ * Only the thread that calls solve takes and gives back buffers, so the list
+ * needs no locking, but a context must not be used by two solves at once.
+ */
+
+// Needed for posix_memalign when compiling with -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "solve.h"
+#include "band.h"
+#include "context.h"
+
+// Number of scratch buffers space is first made for
+#define INITIAL_SCRATCH_CAPACITY 8
+
+// The kinds of scratch buffer a context keeps
+typedef enum {
+    SCRATCH_GRID,
+    SCRATCH_SPLIT_GRID,
+    SCRATCH_SPLIT_FLOAT_GRID,
+    SCRATCH_RESULTS
+} ScratchKind;
+
+// A scratch buffer kept by a context
+typedef struct {
+    ScratchKind kind; // What the buffer is
+    int size; // Dimension of the grid, or number of results
+    void * buffer; // The buffer
+    int taken; // Whether a solve is using it
+    int used; // Whether it has been taken since the last trimSolveContext
+} Scratch;
+
+struct SolveContext {
+    SolveOptions options; // Options solveWithContext uses
+    ThreadPool * pool; // The pool every solve runs on
+    Scratch * scratch; // Scratch buffers, taken or free
+    int scratchCount; // Number of scratch buffers
+    int scratchCapacity; // Number of scratch buffers there is space for
+};
+
+/**
+ * Allocate the given number of per-worker results, aligned to a cache line so
+ * that the padding of WorkerResult gives each worker a line of its own.
+ *
+ * @param  size The number of results
+ *
+ * @return      The results, or NULL if out of memory
+ */
+static WorkerResult *allocateResults(const int size)
+{
+    void *results;
+
+    if (posix_memalign(
+            &results,
+            CACHE_LINE_SIZE,
+            size * sizeof(WorkerResult)
+        )
+    ) {
+        return NULL;
+    }
+
+    return (WorkerResult *)results;
+}
+
+/**
+ * Create a scratch buffer of the given kind and size.
+ *
+ * @param  kind The kind of buffer
+ * @param  size Dimension of the grid, or number of results
+ *
+ * @return      The buffer, or NULL if out of memory
+ */
+static void *createScratch(const ScratchKind kind, const int size)
+{
+    switch (kind) {
+        case SCRATCH_GRID:
+            return createGrid(size);
+        case SCRATCH_SPLIT_GRID:
+            return createSplitGrid(size);
+        case SCRATCH_SPLIT_FLOAT_GRID:
+            return createSplitFloatGrid(size);
+        default:
+            return allocateResults(size);
+    }
+}
+
+/**
+ * Free a scratch buffer created by createScratch.
+ *
+ * @param kind   The kind of buffer
+ * @param buffer The buffer
+ */
+static void freeScratch(const ScratchKind kind, void * const buffer)
+{
+    switch (kind) {
+        case SCRATCH_GRID:
+            freeGrid(buffer);
+            break;
+        case SCRATCH_SPLIT_GRID:
+            freeSplitGrid(buffer);
+            break;
+        case SCRATCH_SPLIT_FLOAT_GRID:
+            freeSplitFloatGrid(buffer);
+            break;
+        default:
+            free(buffer);
+            break;
+    }
+}
+
+/**
+ * Take a free scratch buffer of the given kind and size from a context, or
+ * create one (and keep it in the context) if there is none.
+ *
+ * @param  context The context, or NULL to just create the buffer
+ * @param  kind    The kind of buffer
+ * @param  size    Dimension of the grid, or number of results
+ *
+ * @return         The buffer, or NULL if out of memory
+ */
+static void *takeScratch(
+    SolveContext * const context,
+    const ScratchKind kind,
+    const int size
+)
+{
+    if (!context) {
+        return createScratch(kind, size);
+    }
+
+    for (int i = 0; i < context->scratchCount; i++) {
+        Scratch * const scratch = &context->scratch[i];
+
+        if (!scratch->taken && scratch->kind == kind && scratch->size == size) {
+            scratch->taken = 1;
+            scratch->used = 1;
+
+            return scratch->buffer;
+        }
+    }
+
+    if (context->scratchCount == context->scratchCapacity) {
+        const int capacity = context->scratchCapacity
+                             ? context->scratchCapacity * 2
+                             : INITIAL_SCRATCH_CAPACITY;
+
+        Scratch * const scratch = realloc(
+            context->scratch,
+            capacity * sizeof(Scratch)
+        );
+
+        if (!scratch) {
+            return NULL;
+        }
+
+        context->scratch = scratch;
+        context->scratchCapacity = capacity;
+    }
+
+    void * const buffer = createScratch(kind, size);
+
+    if (!buffer) {
+        return NULL;
+    }
+
+    Scratch * const scratch = &context->scratch[context->scratchCount++];
+    scratch->kind = kind;
+    scratch->size = size;
+    scratch->buffer = buffer;
+    scratch->taken = 1;
+    scratch->used = 1;
+
+    return buffer;
+}
+
+/**
+ * Give back a scratch buffer from takeScratch, to the context it came from,
+ * or freed if there is no context.
+ *
+ * @param context The context, or NULL
+ * @param kind    The kind of buffer
+ * @param buffer  The buffer, or NULL to do nothing
+ */
+static void releaseScratch(
+    SolveContext * const context,
+    const ScratchKind kind,
+    void * const buffer
+)
+{
+    if (!buffer) {
+        return;
+    }
+
+    if (!context) {
+        freeScratch(kind, buffer);
+
+        return;
+    }
+
+    for (int i = 0; i < context->scratchCount; i++) {
+        if (context->scratch[i].buffer == buffer) {
+            context->scratch[i].taken = 0;
+
+            return;
+        }
+    }
+}
+
+/**
+ * Create a solve context, with a thread pool of options->threads workers
+ * pinned according to options->affinity, and no scratch buffers yet. The
+ * options are kept for solveWithContext. If the workers are pinned, so is
+ * the calling thread until the context is freed. Should always be followed
+ * later in the calling code with freeSolveContext.
+ *
+ * Solves with a context (solveWithContext, or solve, solve3D and
+ * firstTouchGrid with options->context set) run on its pool, and keep their
+ * scratch buffers in it for the next solve, so repeated solves of the same
+ * size set nothing up. A context must only be used by one solve at a time.
+ *
+ * @param  options Options to solve with (threads, spinCount and affinity
+ *                 are fixed for the life of the context)
+ * @param  error   Set to 0 on success, or an error code otherwise
+ *
+ * @return         Pointer to the created context, or NULL on error
+ */
+SolveContext *createSolveContext(
+    const SolveOptions * const options,
+    int * const error
+)
+{
+    SolveContext * const context = malloc(sizeof(SolveContext));
+
+    if (!context) {
+        *error = ENOMEM;
+
+        return NULL;
+    }
+
+    context->options = *options;
+    context->options.context = NULL;
+    context->scratch = NULL;
+    context->scratchCount = 0;
+    context->scratchCapacity = 0;
+
+    SolveOptions poolOptions = context->options;
+    poolOptions.spinCount = getSolveSpinCount(options);
+
+    context->pool = createSolvePool(&poolOptions, error);
+
+    if (*error) {
+        free(context);
+
+        return NULL;
+    }
+
+    context->options.context = context;
+
+    return context;
+}
+
+/**
+ * Change the options solveWithContext uses. The threads, spinCount and
+ * affinity cannot be changed, as the pool was created with them.
+ *
+ * @param  context The context
+ * @param  options The new options
+ *
+ * @return         0 on success, or EINVAL if threads, spinCount or affinity
+ *                 differ from the ones the context was created with
+ */
+int setSolveContextOptions(
+    SolveContext * const context,
+    const SolveOptions * const options
+)
+{
+    if (options->threads != context->options.threads
+        || options->spinCount != context->options.spinCount
+        || options->affinity != context->options.affinity
+    ) {
+        return EINVAL;
+    }
+
+    context->options = *options;
+    context->options.context = context;
+
+    return 0;
+}
+
+/**
+ * Solve the given values array with the options of a context, in the same
+ * way as solve, reusing the context's thread pool and scratch buffers.
+ *
+ * @param  context The context
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveWithContext(
+    SolveContext * const context,
+    Grid * const values,
+    SolveResult * const result
+)
+{
+    return solve(values, &context->options, result);
+}
+
+/**
+ * Free a solve context, its thread pool and all its scratch buffers. Must
+ * not be called while a solve is using it.
+ *
+ * @param  context The context to free
+ *
+ * @return         0 on success, or a pthread error code from freeing the pool
+ */
+int freeSolveContext(SolveContext * const context)
+{
+    for (int i = 0; i < context->scratchCount; i++) {
+        freeScratch(context->scratch[i].kind, context->scratch[i].buffer);
+    }
+
+    free(context->scratch);
+
+    const int error = freeThreadPool(context->pool);
+
+    free(context);
+
+    return error;
+}
+
+/**
+ * Get the thread pool of a solve context, for a solve with the given
+ * options. The pool belongs to the context, so must not be freed.
+ *
+ * @param  context The context
+ * @param  options Options of the solve (threads and affinity must match the
+ *                 ones the context was created with)
+ * @param  error   Set to 0 on success, or EINVAL if the options do not match
+ *
+ * @return         The pool, or NULL on error
+ */
+ThreadPool *getSolveContextPool(
+    SolveContext * const context,
+    const SolveOptions * const options,
+    int * const error
+)
+{
+    if (options->threads != context->options.threads
+        || options->affinity != context->options.affinity
+    ) {
+        *error = EINVAL;
+
+        return NULL;
+    }
+
+    *error = 0;
+
+    return context->pool;
+}
+
+/**
+ * Get a scratch grid of the given dimension, reused from options->context if
+ * it has a free one, or newly created otherwise. Its contents are undefined.
+ * Should always be followed later in the calling code with
+ * releaseScratchGrid.
+ *
+ * @param  options   Options of the solve (only context is used)
+ * @param  dimension The dimension of the grid
+ *
+ * @return           The grid, or NULL if out of memory
+ */
+Grid *takeScratchGrid(const SolveOptions * const options, const int dimension)
+{
+    return takeScratch(options->context, SCRATCH_GRID, dimension);
+}
+
+/**
+ * Give back a grid from takeScratchGrid, to options->context to reuse, or
+ * freed if there is no context. Does nothing if the grid is NULL.
+ *
+ * @param options Options of the solve (only context is used)
+ * @param grid    The grid
+ */
+void releaseScratchGrid(const SolveOptions * const options, Grid * const grid)
+{
+    releaseScratch(options->context, SCRATCH_GRID, grid);
+}
+
+/**
+ * The same as takeScratchGrid, but for a SplitGrid.
+ *
+ * @param  options   Options of the solve (only context is used)
+ * @param  dimension The dimension of the full grid
+ *
+ * @return           The split grid, or NULL if out of memory
+ */
+SplitGrid *takeScratchSplitGrid(
+    const SolveOptions * const options,
+    const int dimension
+)
+{
+    return takeScratch(options->context, SCRATCH_SPLIT_GRID, dimension);
+}
+
+/**
+ * The same as releaseScratchGrid, but for a SplitGrid.
+ *
+ * @param options Options of the solve (only context is used)
+ * @param grid    The split grid
+ */
+void releaseScratchSplitGrid(
+    const SolveOptions * const options,
+    SplitGrid * const grid
+)
+{
+    releaseScratch(options->context, SCRATCH_SPLIT_GRID, grid);
+}
+
+/**
+ * The same as takeScratchGrid, but for a SplitFloatGrid.
+ *
+ * @param  options   Options of the solve (only context is used)
+ * @param  dimension The dimension of the full grid
+ *
+ * @return           The split grid, or NULL if out of memory
+ */
+SplitFloatGrid *takeScratchSplitFloatGrid(
+    const SolveOptions * const options,
+    const int dimension
+)
+{
+    return takeScratch(options->context, SCRATCH_SPLIT_FLOAT_GRID, dimension);
+}
+
+/**
+ * The same as releaseScratchGrid, but for a SplitFloatGrid.
+ *
+ * @param options Options of the solve (only context is used)
+ * @param grid    The split grid
+ */
+void releaseScratchSplitFloatGrid(
+    const SolveOptions * const options,
+    SplitFloatGrid * const grid
+)
+{
+    releaseScratch(options->context, SCRATCH_SPLIT_FLOAT_GRID, grid);
+}
+
+/**
+ * Get space for one WorkerResult per worker (options->threads), in the same
+ * way as takeScratchGrid, aligned to a cache line.
+ *
+ * @param  options Options of the solve (threads and context are used)
+ *
+ * @return         The results, or NULL if out of memory
+ */
+WorkerResult *takeScratchResults(const SolveOptions * const options)
+{
+    return takeScratch(options->context, SCRATCH_RESULTS, options->threads);
+}
+
+/**
+ * The same as releaseScratchGrid, but for results from takeScratchResults.
+ *
+ * @param options Options of the solve (only context is used)
+ * @param results The results
+ */
+void releaseScratchResults(
+    const SolveOptions * const options,
+    WorkerResult * const results
+)
+{
+    releaseScratch(options->context, SCRATCH_RESULTS, results);
+}
+
+/**
+ * Free the scratch buffers of a context that were not taken since the last
+ * call, so a context used for grids of changing sizes only keeps what the
+ * latest solve needed. Called at the end of each solve.
+ *
+ * @param context The context
+ */
+void trimSolveContext(SolveContext * const context)
+{
+    int kept = 0;
+
+    for (int i = 0; i < context->scratchCount; i++) {
+        Scratch scratch = context->scratch[i];
+
+        if (!scratch.used && !scratch.taken) {
+            freeScratch(scratch.kind, scratch.buffer);
+
+            continue;
+        }
+
+        scratch.used = 0;
+        context->scratch[kept++] = scratch;
+    }
+
+    context->scratchCount = kept;
+}
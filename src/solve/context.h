@@ -0,0 +1,126 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "solve.h"
+#include "band.h"
+
+/**
+ * Get the thread pool of a solve context, for a solve with the given
+ * options. The pool belongs to the context, so must not be freed.
+ *
+ * @param  context The context
+ * @param  options Options of the solve (threads and affinity must match the
+ *                 ones the context was created with)
+ * @param  error   Set to 0 on success, or EINVAL if the options do not match
+ *
+ * @return         The pool, or NULL on error
+ */
+ThreadPool *getSolveContextPool(
+    SolveContext * const context,
+    const SolveOptions * const options,
+    int * const error
+);
+
+/**
+ * Get a scratch grid of the given dimension, reused from options->context if
+ * it has a free one, or newly created otherwise. Its contents are undefined.
+ * Should always be followed later in the calling code with
+ * releaseScratchGrid.
+ *
+ * @param  options   Options of the solve (only context is used)
+ * @param  dimension The dimension of the grid
+ *
+ * @return           The grid, or NULL if out of memory
+ */
+Grid *takeScratchGrid(const SolveOptions * const options, const int dimension);
+
+/**
+ * Give back a grid from takeScratchGrid, to options->context to reuse, or
+ * freed if there is no context. Does nothing if the grid is NULL.
+ *
+ * @param options Options of the solve (only context is used)
+ * @param grid    The grid
+ */
+void releaseScratchGrid(const SolveOptions * const options, Grid * const grid);
+
+/**
+ * The same as takeScratchGrid, but for a SplitGrid.
+ *
+ * @param  options   Options of the solve (only context is used)
+ * @param  dimension The dimension of the full grid
+ *
+ * @return           The split grid, or NULL if out of memory
+ */
+SplitGrid *takeScratchSplitGrid(
+    const SolveOptions * const options,
+    const int dimension
+);
+
+/**
+ * The same as releaseScratchGrid, but for a SplitGrid.
+ *
+ * @param options Options of the solve (only context is used)
+ * @param grid    The split grid
+ */
+void releaseScratchSplitGrid(
+    const SolveOptions * const options,
+    SplitGrid * const grid
+);
+
+/**
+ * The same as takeScratchGrid, but for a SplitFloatGrid.
+ *
+ * @param  options   Options of the solve (only context is used)
+ * @param  dimension The dimension of the full grid
+ *
+ * @return           The split grid, or NULL if out of memory
+ */
+SplitFloatGrid *takeScratchSplitFloatGrid(
+    const SolveOptions * const options,
+    const int dimension
+);
+
+/**
+ * The same as releaseScratchGrid, but for a SplitFloatGrid.
+ *
+ * @param options Options of the solve (only context is used)
+ * @param grid    The split grid
+ */
+void releaseScratchSplitFloatGrid(
+    const SolveOptions * const options,
+    SplitFloatGrid * const grid
+);
+
+/**
+ * Get space for one WorkerResult per worker (options->threads), in the same
+ * way as takeScratchGrid, aligned to a cache line.
+ *
+ * @param  options Options of the solve (threads and context are used)
+ *
+ * @return         The results, or NULL if out of memory
+ */
+WorkerResult *takeScratchResults(const SolveOptions * const options);
+
+/**
+ * The same as releaseScratchGrid, but for results from takeScratchResults.
+ *
+ * @param options Options of the solve (only context is used)
+ * @param results The results
+ */
+void releaseScratchResults(
+    const SolveOptions * const options,
+    WorkerResult * const results
+);
+
+/**
+ * Free the scratch buffers of a context that were not taken since the last
+ * call, so a context used for grids of changing sizes only keeps what the
+ * latest solve needed. Called at the end of each solve.
+ *
+ * @param context The context
+ */
+void trimSolveContext(SolveContext * const context);
+
+#endif
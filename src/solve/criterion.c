@@ -0,0 +1,401 @@
+/**
+ * Convergence criteria for SOLVE_METHOD_RELAX and SOLVE_METHOD_JACOBI (see
+ * SolveCriterion in solve.h), worked out from what the relaxation kernels
+ * already have to hand as they update each point, so testing them costs no
+ * extra pass over the grid.
+ *
+ * The residual of a point u with neighbours a, b, c and d is
+ * r = a + b + c + d - 4u. A kernel moves the point by
+ * change = omega * (r / 4), so r = 4 * change / omega, and the largest
+ * residual and the sum of their squares follow from the largest change and
+ * the sum of the squares of the changes.
+ *
+ * In a red-black sweep, the 'E' points are relaxed first, so the residual
+ * of each one before it is relaxed is exactly its residual in the grid as
+ * it was at the start of the sweep. After an 'O' point is relaxed its
+ * residual is r - omega * r = (1 - omega) * r, and its neighbours are all
+ * 'E' points, which do not change again until the next sweep. So the
+ * residuals of the 'O' points at the start of a sweep are those seen while
+ * relaxing them in the sweep before, times |1 - omega| (0 for Gauss-Seidel).
+ * Together these give the exact residual of the grid at the start of the
+ * sweep, i.e. at the end of the sweep before, which is why the residual
+ * criteria cannot stop a red-black solve after its first sweep. A Jacobi
+ * sweep works every new value out from the grid at its start, so its
+ * residuals are simply 4 times its changes.
+ *
+ * SOLVE_CRITERION_RELATIVE compares the residual against the residual of
+ * the grid as it was given, before any sweep (or the single precision phase
+ * of SOLVE_FLOAT_MIXED), which is the one thing worked out in a pass of its
+ * own, once per solve (see getStartResidual).
+ *
+ * The root mean square measures are divided by the number of interior
+ * points, so a precision means the same for any size of grid. The sums of
+ * squares are only worked out in the sweeps that are tested, and added up
+ * in a fixed order of workers, but each worker (and vector lane) sums its
+ * own part, so they can differ in the last bits with the number of threads
+ * and the kernel.
+ */
+
+#include <errno.h>
+#include <math.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "solve.h"
+#include "band.h"
+#include "context.h"
+#include "criterion.h"
+
+// struct to pass multiple arguments to the pool task for getStartResidual
+typedef struct {
+    const Grid * values; // The grid
+    int threads; // The number of workers
+    WorkerResult * results; // Sum of the squares of the residuals in the
+                            // band of each worker
+} ResidualArgs;
+
+/**
+ * Set up the convergence test of a solve.
+ *
+ * @param convergence The test to set up
+ * @param options     Options of the solve, with omega resolved (criterion,
+ *                    precision, omega and checkEvery are used)
+ * @param dimension   The dimension of the grid being solved
+ * @param redBlack    1 if points are relaxed in two colours, each with the
+ *                    relaxation factor options->omega, or 0 if all points
+ *                    are relaxed at once to the average (Jacobi)
+ * @param reference   The root mean square residual of the grid before the
+ *                    first sweep (see getStartResidual), used by
+ *                    SOLVE_CRITERION_RELATIVE
+ */
+void initConvergence(
+    Convergence * const convergence,
+    const SolveOptions * const options,
+    const int dimension,
+    const int redBlack,
+    const double reference
+)
+{
+    const double omega = redBlack ? options->omega : 1;
+    const int interior = dimension > 2 ? dimension - 2 : 0;
+
+    convergence->criterion = options->criterion;
+    convergence->precision = options->precision;
+    convergence->residualScale = 4 / omega;
+    convergence->oddScale = fabs(1 - omega);
+    convergence->points = (double) interior * interior;
+    convergence->checkEvery = options->checkEvery > 1
+                              ? options->checkEvery
+                              : 1;
+    convergence->redBlack = redBlack;
+    convergence->reference = reference;
+    convergence->measure = 0;
+}
+
+/**
+ * Pool task for getStartResidual. Each worker adds up the squares of the
+ * residuals of the points in its band of rows.
+ *
+ * @param workerId The ID of the worker
+ * @param args     ResidualArgs shared by all workers
+ */
+static void runResidual(const int workerId, void * const args)
+{
+    ResidualArgs * const residualArgs = (ResidualArgs *) args;
+    const Grid * const values = residualArgs->values;
+    const int dimension = values->dimension;
+
+    int rowStart, rowEnd;
+    getBand(workerId, residualArgs->threads, dimension, &rowStart, &rowEnd);
+
+    double squares = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const current = gridRow(values, row);
+        const double * const above = gridRow(values, row - 1);
+        const double * const below = gridRow(values, row + 1);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            const double residual = current[col - 1] + current[col + 1]
+                                    + above[col] + below[col]
+                                    - 4 * current[col];
+
+            squares += residual * residual;
+        }
+    }
+
+    residualArgs->results[workerId].sum = squares;
+}
+
+/**
+ * Work out the root mean square residual of a grid before it is solved, as
+ * the reference for SOLVE_CRITERION_RELATIVE, in one pass split into bands
+ * on the thread pool of the solve. Sets it to 0 for the other criteria,
+ * which do not need it.
+ *
+ * @param  values    The grid
+ * @param  options   Options controlling the solve (criterion, threads,
+ *                   spinCount, affinity and context are used)
+ * @param  residual  Set to the root mean square residual
+ *
+ * @return           0 on success, or an error code otherwise
+ */
+int getStartResidual(
+    const Grid * const values,
+    const SolveOptions * const options,
+    double * const residual
+)
+{
+    *residual = 0;
+
+    if (options->criterion != SOLVE_CRITERION_RELATIVE) {
+        return 0;
+    }
+
+    ResidualArgs residualArgs;
+    residualArgs.values = values;
+    residualArgs.threads = options->threads;
+    residualArgs.results = takeScratchResults(options);
+
+    if (!residualArgs.results) {
+        return ENOMEM;
+    }
+
+    int error;
+
+    ThreadPool * const pool = createSolvePool(options, &error);
+
+    if (!error) {
+        runThreadPool(pool, runResidual, &residualArgs);
+
+        error = releaseSolvePool(options, pool);
+    }
+
+    if (!error) {
+        const int interior = values->dimension > 2 ? values->dimension - 2 : 0;
+        const double points = (double) interior * interior;
+        const double squares = sumWorkerResults(
+            residualArgs.results,
+            options->threads
+        );
+
+        *residual = points > 0 ? sqrt(squares / points) : 0;
+    }
+
+    releaseScratchResults(options, residualArgs.results);
+
+    return error;
+}
+
+/**
+ * Get the precision to hand to the relaxation kernels: options->precision
+ * for SOLVE_CRITERION_CHANGE, so points that would change by less are left
+ * as they are, and 0 for the other criteria, so every point is updated.
+ *
+ * @param  options Options of the solve (criterion and precision are used)
+ *
+ * @return         The precision for the kernels
+ */
+double getKernelPrecision(const SolveOptions * const options)
+{
+    return options->criterion == SOLVE_CRITERION_CHANGE
+           ? options->precision
+           : 0;
+}
+
+/**
+ * Check whether a criterion uses the residual.
+ *
+ * @param  criterion The criterion
+ *
+ * @return           1 if it does, 0 otherwise
+ */
+static int isResidualCriterion(const SolveCriterion criterion)
+{
+    return criterion == SOLVE_CRITERION_RESIDUAL
+           || criterion == SOLVE_CRITERION_RESIDUAL_L2
+           || criterion == SOLVE_CRITERION_RELATIVE;
+}
+
+/**
+ * Check whether the criterion should be tested after a step of one or more
+ * sweeps: if the step has a sweep whose number (from 1) is a multiple of
+ * checkEvery in it. The residuals of red-black sweeps are only known from
+ * the second sweep, so the first is never tested for them.
+ *
+ * @param  convergence The convergence test
+ * @param  sweeps      Sweeps done by the end of the step
+ * @param  stepSweeps  Sweeps in the step
+ *
+ * @return             1 if the criterion should be tested, 0 otherwise
+ */
+int isCheckDue(
+    const Convergence * const convergence,
+    const int sweeps,
+    const int stepSweeps
+)
+{
+    if (convergence->redBlack
+        && isResidualCriterion(convergence->criterion)
+        && sweeps < 2
+    ) {
+        return 0;
+    }
+
+    const int checkEvery = convergence->checkEvery;
+
+    return sweeps / checkEvery > (sweeps - stepSweeps) / checkEvery;
+}
+
+/**
+ * Check whether the kernels need to sum the squares of the changes of the
+ * points of one colour in a sweep. Only the root mean square criteria need
+ * them: from the 'E' points (and for SOLVE_CRITERION_CHANGE_L2 the 'O'
+ * points) of a sweep that is tested, and from the 'O' points of the sweep
+ * before one that is tested.
+ *
+ * @param  convergence   The convergence test
+ * @param  tested        1 if the sweep is tested
+ * @param  nextTested    1 if the sweep after it is tested
+ * @param  oddPointsFlag 1 for the 'O' points, 0 for the 'E' points
+ *
+ * @return               1 if the squares are needed, 0 otherwise
+ */
+int needsSquares(
+    const Convergence * const convergence,
+    const int tested,
+    const int nextTested,
+    const int oddPointsFlag
+)
+{
+    switch (convergence->criterion) {
+        case SOLVE_CRITERION_CHANGE_L2:
+            return tested;
+        case SOLVE_CRITERION_RESIDUAL_L2:
+        case SOLVE_CRITERION_RELATIVE:
+            if (oddPointsFlag) {
+                // Residuals of 'O' points after relaxing are 0 without SOR
+                return nextTested && convergence->oddScale != 0;
+            }
+
+            return tested;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Start the norms of a worker for a new sweep: the 'O' points of the last
+ * sweep become previousOdd, and the rest are set to 0.
+ *
+ * @param norms The norms of the worker
+ */
+void startSweepNorms(SweepNorms * const norms)
+{
+    norms->previousOdd = norms->odd;
+    norms->even.max = 0;
+    norms->even.squares = 0;
+    norms->odd.max = 0;
+    norms->odd.squares = 0;
+}
+
+/**
+ * Get the largest change of any point in a sweep.
+ *
+ * @param  norms The norms of the sweep
+ *
+ * @return       The largest change
+ */
+double getSweepChange(const SweepNorms * const norms)
+{
+    return norms->even.max > norms->odd.max
+           ? norms->even.max
+           : norms->odd.max;
+}
+
+/**
+ * Work out the largest residual of the grid at the start of a sweep (see top
+ * of file).
+ *
+ * @param  convergence The convergence test
+ * @param  norms       The norms of the sweep
+ *
+ * @return             The largest residual
+ */
+static double getResidualMax(
+    const Convergence * const convergence,
+    const SweepNorms * const norms
+)
+{
+    const double odd = convergence->oddScale * norms->previousOdd.max;
+
+    return convergence->residualScale
+           * (norms->even.max > odd ? norms->even.max : odd);
+}
+
+/**
+ * Work out the root mean square residual of the grid at the start of a
+ * sweep (see top of file).
+ *
+ * @param  convergence The convergence test
+ * @param  norms       The norms of the sweep
+ *
+ * @return             The root mean square residual
+ */
+static double getResidualL2(
+    const Convergence * const convergence,
+    const SweepNorms * const norms
+)
+{
+    const double oddScale = convergence->oddScale;
+    const double squares = norms->even.squares
+                           + oddScale * oddScale * norms->previousOdd.squares;
+
+    return convergence->residualScale * sqrt(squares / convergence->points);
+}
+
+/**
+ * Work out the measure of the criterion from the norms of a sweep of the
+ * whole grid, and keep it in convergence->measure.
+ *
+ * @param  convergence The convergence test
+ * @param  norms       The norms of the sweep, added up over all workers
+ *
+ * @return             1 if the measure is below the precision, 0 otherwise
+ */
+int testConvergence(
+    Convergence * const convergence,
+    const SweepNorms * const norms
+)
+{
+    double measure;
+
+    switch (convergence->criterion) {
+        case SOLVE_CRITERION_CHANGE_L2:
+            measure = sqrt(
+                (norms->even.squares + norms->odd.squares)
+                / convergence->points
+            );
+            break;
+        case SOLVE_CRITERION_RESIDUAL:
+            measure = getResidualMax(convergence, norms);
+            break;
+        case SOLVE_CRITERION_RESIDUAL_L2:
+            measure = getResidualL2(convergence, norms);
+            break;
+        case SOLVE_CRITERION_RELATIVE:
+            // A grid that starts solved stays solved
+            measure = convergence->reference == 0
+                      ? 0
+                      : getResidualL2(convergence, norms)
+                        / convergence->reference;
+            break;
+        default:
+            measure = getSweepChange(norms);
+            break;
+    }
+
+    convergence->measure = measure;
+
+    return measure < convergence->precision;
+}
@@ -0,0 +1,158 @@
+#ifndef CRITERION_H
+#define CRITERION_H
+
+#include "../array/array.h"
+#include "solve.h"
+
+// Largest change, and sum of the squares of the changes, of a set of points
+typedef struct {
+    double max; // Largest change of any point
+    double squares; // Sum of the squares of the changes, if they were needed
+} ChangeNorms;
+
+// Changes of the points relaxed in a sweep, by one worker or by all of them.
+// SOLVE_METHOD_JACOBI has no colours, so counts every point as an 'E' point.
+typedef struct {
+    ChangeNorms even; // The 'E' points
+    ChangeNorms odd; // The 'O' points
+    ChangeNorms previousOdd; // The 'O' points in the sweep before
+} SweepNorms;
+
+// State of the convergence test of a solve
+typedef struct {
+    SolveCriterion criterion; // The criterion to test
+    double precision; // The precision to compare the measure against
+    double residualScale; // Turns a change into a residual (4 / omega)
+    double oddScale; // Turns the residual of an 'O' point before it was
+                     // relaxed into its residual after (|1 - omega|)
+    double points; // The number of interior points
+    int checkEvery; // Sweeps between tests
+    int redBlack; // Flag - are the points relaxed in two colours
+    double reference; // Root mean square residual before the first sweep,
+                      // for SOLVE_CRITERION_RELATIVE
+    double measure; // The measure at the last test
+} Convergence;
+
+/**
+ * Set up the convergence test of a solve.
+ *
+ * @param convergence The test to set up
+ * @param options     Options of the solve, with omega resolved (criterion,
+ *                    precision, omega and checkEvery are used)
+ * @param dimension   The dimension of the grid being solved
+ * @param redBlack    1 if points are relaxed in two colours, each with the
+ *                    relaxation factor options->omega, or 0 if all points
+ *                    are relaxed at once to the average (Jacobi)
+ * @param reference   The root mean square residual of the grid before the
+ *                    first sweep (see getStartResidual), used by
+ *                    SOLVE_CRITERION_RELATIVE
+ */
+void initConvergence(
+    Convergence * const convergence,
+    const SolveOptions * const options,
+    const int dimension,
+    const int redBlack,
+    const double reference
+);
+
+/**
+ * Work out the root mean square residual of a grid before it is solved, as
+ * the reference for SOLVE_CRITERION_RELATIVE, in one pass split into bands
+ * on the thread pool of the solve. Sets it to 0 for the other criteria,
+ * which do not need it.
+ *
+ * @param  values    The grid
+ * @param  options   Options controlling the solve (criterion, threads,
+ *                   spinCount, affinity and context are used)
+ * @param  residual  Set to the root mean square residual
+ *
+ * @return           0 on success, or an error code otherwise
+ */
+int getStartResidual(
+    const Grid * const values,
+    const SolveOptions * const options,
+    double * const residual
+);
+
+/**
+ * Get the precision to hand to the relaxation kernels: options->precision
+ * for SOLVE_CRITERION_CHANGE, so points that would change by less are left
+ * as they are, and 0 for the other criteria, so every point is updated.
+ *
+ * @param  options Options of the solve (criterion and precision are used)
+ *
+ * @return         The precision for the kernels
+ */
+double getKernelPrecision(const SolveOptions * const options);
+
+/**
+ * Check whether the criterion should be tested after a step of one or more
+ * sweeps: if the step has a sweep whose number (from 1) is a multiple of
+ * checkEvery in it. The residuals of red-black sweeps are only known from
+ * the second sweep, so the first is never tested for them.
+ *
+ * @param  convergence The convergence test
+ * @param  sweeps      Sweeps done by the end of the step
+ * @param  stepSweeps  Sweeps in the step
+ *
+ * @return             1 if the criterion should be tested, 0 otherwise
+ */
+int isCheckDue(
+    const Convergence * const convergence,
+    const int sweeps,
+    const int stepSweeps
+);
+
+/**
+ * Check whether the kernels need to sum the squares of the changes of the
+ * points of one colour in a sweep. Only the root mean square criteria need
+ * them: from the 'E' points (and for SOLVE_CRITERION_CHANGE_L2 the 'O'
+ * points) of a sweep that is tested, and from the 'O' points of the sweep
+ * before one that is tested.
+ *
+ * @param  convergence   The convergence test
+ * @param  tested        1 if the sweep is tested
+ * @param  nextTested    1 if the sweep after it is tested
+ * @param  oddPointsFlag 1 for the 'O' points, 0 for the 'E' points
+ *
+ * @return               1 if the squares are needed, 0 otherwise
+ */
+int needsSquares(
+    const Convergence * const convergence,
+    const int tested,
+    const int nextTested,
+    const int oddPointsFlag
+);
+
+/**
+ * Start the norms of a worker for a new sweep: the 'O' points of the last
+ * sweep become previousOdd, and the rest are set to 0.
+ *
+ * @param norms The norms of the worker
+ */
+void startSweepNorms(SweepNorms * const norms);
+
+/**
+ * Get the largest change of any point in a sweep.
+ *
+ * @param  norms The norms of the sweep
+ *
+ * @return       The largest change
+ */
+double getSweepChange(const SweepNorms * const norms);
+
+/**
+ * Work out the measure of the criterion from the norms of a sweep of the
+ * whole grid, and keep it in convergence->measure.
+ *
+ * @param  convergence The convergence test
+ * @param  norms       The norms of the sweep, added up over all workers
+ *
+ * @return             1 if the measure is below the precision, 0 otherwise
+ */
+int testConvergence(
+    Convergence * const convergence,
+    const SweepNorms * const norms
+);
+
+#endif
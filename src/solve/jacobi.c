@@ -0,0 +1,243 @@
+/**
+ * Jacobi relaxation with two buffers. Every sweep reads all points from one
+ * grid and writes the new values to the other, then the two are swapped.
+ * Unlike red-black Gauss-Seidel, no point reads a value written in the same
+ * sweep, so there are no colours and each row is one contiguous run of
+ * points for the kernel (see RelaxJacobiRowFunction in kernel.h).
+ *
+ * Each new value only depends on the previous sweep, and the largest change
+ * does not depend on the order it is worked out in, so the output and the
+ * number of sweeps are bitwise identical for any number of threads (and any
+ * kernel). The root mean square criteria are the exception, as their sums
+ * of squares are added up in parts (see src/solve/criterion.c). Jacobi needs
+ * about twice as many sweeps as Gauss-Seidel, and converges to a slightly
+ * different answer.
+ *
+ * All workers run the whole solve as a single pool task, each working on its
+ * own band of rows (see src/solve/band.c), with one barrier per sweep. Each
+ * worker also copies its own band into the second buffer at the start, so
+ * it is the first to touch that memory.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "../barrier/barrier.h"
+#include "solve.h"
+#include "kernel.h"
+#include "band.h"
+#include "context.h"
+#include "criterion.h"
+#include "jacobi.h"
+
+// struct to pass multiple arguments to the pool task
+typedef struct {
+    Grid * buffers[2]; // The values, and the other buffer
+    const RelaxKernels * kernels; // The relaxation kernels to use
+    double precision; // The precision to hand to the kernels
+    Convergence convergence; // The convergence test, copied by each worker
+    int threads; // The number of workers
+    Barrier barrier; // Barrier between sweeps
+    WorkerResult * results[2]; // Result of each worker, by sweep parity
+    int sweeps; // Sweeps done, set by worker 0
+    double measure; // Measure of the criterion at the last test, set by
+                    // worker 0
+} JacobiArgs;
+
+/**
+ * Pool task for SOLVE_METHOD_JACOBI. Sweep s reads buffer s % 2 and writes
+ * buffer (s + 1) % 2. The per-worker results are also kept by sweep parity,
+ * so one barrier per sweep is enough: a worker can only overwrite the
+ * results of sweep s in sweep s + 2, after every worker has passed the
+ * barrier at the end of sweep s + 1, and so has read them.
+ *
+ * @param workerId The ID of the worker
+ * @param args     JacobiArgs shared by all workers
+ */
+static void runJacobi(const int workerId, void * const args)
+{
+    JacobiArgs * const jacobiArgs = (JacobiArgs *) args;
+    const int dimension = jacobiArgs->buffers[0]->dimension;
+
+    int rowStart, rowEnd;
+    getBand(workerId, jacobiArgs->threads, dimension, &rowStart, &rowEnd);
+
+    // The edges are never written, so must be in both buffers
+    int copyStart, copyEnd;
+    getBandWithEdges(
+        workerId,
+        jacobiArgs->threads,
+        dimension,
+        &copyStart,
+        &copyEnd
+    );
+    copyGridRows(
+        jacobiArgs->buffers[1],
+        jacobiArgs->buffers[0],
+        copyStart,
+        copyEnd
+    );
+
+    waitBarrier(&jacobiArgs->barrier);
+
+    Convergence convergence = jacobiArgs->convergence;
+
+    int sweeps = 0;
+    int solved = 0;
+
+    // Every point is counted as an 'E' point (see SweepNorms)
+    SweepNorms norms = {{0, 0}, {0, 0}, {0, 0}};
+
+    while (!solved) {
+        const int parity = sweeps & 1;
+        const Grid * const current = jacobiArgs->buffers[parity];
+        Grid * const next = jacobiArgs->buffers[!parity];
+        const int tested = isCheckDue(&convergence, sweeps + 1, 1);
+
+        startSweepNorms(&norms);
+
+        double * const squares = needsSquares(&convergence, tested, 0, 0)
+                                 ? &norms.even.squares
+                                 : NULL;
+
+        for (int row = rowStart; row < rowEnd; row++) {
+            const double change = jacobiArgs->kernels->relaxJacobiRow(
+                gridRow(next, row) + 1,
+                gridRow(current, row) + 1,
+                gridRow(current, row - 1) + 1,
+                gridRow(current, row + 1) + 1,
+                dimension - 2,
+                jacobiArgs->precision,
+                squares
+            );
+
+            if (change > norms.even.max) {
+                norms.even.max = change;
+            }
+        }
+
+        jacobiArgs->results[parity][workerId].norms = norms;
+
+        waitBarrier(&jacobiArgs->barrier);
+
+        if (tested) {
+            SweepNorms total;
+            sumWorkerNorms(
+                jacobiArgs->results[parity],
+                jacobiArgs->threads,
+                &total
+            );
+
+            solved = testConvergence(&convergence, &total);
+        }
+
+        sweeps++;
+    }
+
+    if (workerId == 0) {
+        jacobiArgs->sweeps = sweeps;
+        jacobiArgs->measure = convergence.measure;
+    }
+}
+
+/**
+ * Solve the given values array with SOLVE_METHOD_JACOBI, and update it to the
+ * solution. Stops after the first tested sweep that meets the criterion (see
+ * src/solve/criterion.c).
+ *
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  kernels The relaxation kernels to use
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveJacobi(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    SolveResult * const result
+)
+{
+    const int threads = options->threads;
+
+    double reference;
+    int error = getStartResidual(values, options, &reference);
+
+    JacobiArgs jacobiArgs;
+    jacobiArgs.buffers[0] = values;
+    jacobiArgs.buffers[1] = takeScratchGrid(options, values->dimension);
+    jacobiArgs.kernels = kernels;
+    jacobiArgs.precision = getKernelPrecision(options);
+    jacobiArgs.threads = threads;
+    jacobiArgs.results[0] = takeScratchResults(options);
+    jacobiArgs.results[1] = takeScratchResults(options);
+    jacobiArgs.sweeps = 0;
+    jacobiArgs.measure = 0;
+
+    initConvergence(
+        &jacobiArgs.convergence,
+        options,
+        values->dimension,
+        0,
+        reference
+    );
+
+    if (!jacobiArgs.buffers[1]
+        || !jacobiArgs.results[0]
+        || !jacobiArgs.results[1]
+    ) {
+        error = ENOMEM;
+    }
+
+    if (!error) {
+        ThreadPool * const pool = createSolvePool(options, &error);
+
+        if (!error) {
+            error = initBarrier(
+                &jacobiArgs.barrier,
+                threads,
+                options->spinCount
+            );
+
+            if (!error) {
+                runThreadPool(pool, runJacobi, &jacobiArgs);
+
+                destroyBarrier(&jacobiArgs.barrier);
+            }
+
+            const int poolError = releaseSolvePool(options, pool);
+
+            if (!error) {
+                error = poolError;
+            }
+        }
+
+        // After an odd number of sweeps the latest values are in the copy
+        if (jacobiArgs.sweeps & 1) {
+            copyGrid(values, jacobiArgs.buffers[1]);
+        }
+    }
+
+    result->iterations = jacobiArgs.sweeps;
+
+    if (!error) {
+        SweepNorms norms;
+        sumWorkerNorms(
+            jacobiArgs.results[(jacobiArgs.sweeps - 1) & 1],
+            threads,
+            &norms
+        );
+
+        result->change = getSweepChange(&norms);
+        result->measure = jacobiArgs.measure;
+    }
+
+    releaseScratchResults(options, jacobiArgs.results[1]);
+    releaseScratchResults(options, jacobiArgs.results[0]);
+    releaseScratchGrid(options, jacobiArgs.buffers[1]);
+
+    return error;
+}
@@ -0,0 +1,27 @@
+#ifndef JACOBI_H
+#define JACOBI_H
+
+#include "../array/array.h"
+#include "solve.h"
+#include "kernel.h"
+
+/**
+ * Solve the given values array with SOLVE_METHOD_JACOBI, and update it to the
+ * solution. Stops after the first sweep in which no point changed by at
+ * least the precision.
+ *
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  kernels The relaxation kernels to use
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveJacobi(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    SolveResult * const result
+);
+
+#endif
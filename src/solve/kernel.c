@@ -0,0 +1,1530 @@
+/**
+ * Relaxation kernels, i.e. the code that actually averages points. There is a
+ * scalar version of each kernel, plus SSE2, AVX2 and AVX-512 versions on
+ * x86-64. The vector versions are compiled with target attributes, so no
+ * special compiler flags are needed, and one is picked at runtime based on
+ * what the CPU supports.
+ *
+ * All versions add the four neighbours in the same order and multiply by
+ * 0.25 (which is exact, so the same as dividing by 4), so they give bitwise
+ * identical results to the scalar kernel. With a relaxation factor other than
+ * 1 (SOR) they all then work out old + omega * (average - old) the same way.
+ * The same holds for the single precision kernels used by SOLVE_FLOAT_MIXED,
+ * which do the same sums in float, adding any right hand side last. The
+ * sums of the squares of the changes, worked out for the convergence
+ * criteria other than the largest change (see src/solve/criterion.c), are
+ * the one exception: each vector lane keeps its own sum, so they are added
+ * up in a different order and may differ in the last bits between kernels.
+ *
+ * In SOLVE_LAYOUT_NATURAL only every other point of a row is updated, so the
+ * vector kernels load consecutive values and shuffle the points of the colour
+ * being updated into one register. The AVX2 and AVX-512 kernels then store
+ * whole registers, writing back the points of the other colour with the exact
+ * values they were loaded with. Masked stores would avoid that, but they
+ * cannot be forwarded to the overlapping loads of the next iteration and
+ * stall on every one. Writing back unchanged values is safe, as no thread
+ * writes points of the other colour during a half-sweep, and readers see the
+ * same 8 bytes either way.
+ *
+ * The scalar kernels are static inline so that the tails of the vector
+ * kernels are inlined and compiled with the same instruction set. Calling
+ * out to legacy SSE code with the upper halves of the AVX registers in use
+ * is very slow on many Intel CPUs.
+ */
+
+#include <math.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+#include "solve.h"
+#include "kernel.h"
+
+/**
+ * Scalar version of RelaxRowFunction (see kernel.h).
+ */
+static inline double relaxRowScalar(
+    double * const current,
+    const double * const above,
+    const double * const below,
+    const int firstCol,
+    const int endCol,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    double maxChange = 0;
+    double sumOfSquares = 0;
+
+    for (int col = firstCol; col < endCol; col += 2) {
+        double newValue = (current[col - 1] + current[col + 1]
+                           + above[col] + below[col]) / 4;
+
+        if (omega != 1) {
+            newValue = current[col] + omega * (newValue - current[col]);
+        }
+
+        const double change = fabs(newValue - current[col]);
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+
+        if (squares) {
+            sumOfSquares += change * change;
+        }
+
+        if (change < precision) {
+            continue;
+        }
+
+        current[col] = newValue;
+    }
+
+    if (squares) {
+        *squares += sumOfSquares;
+    }
+
+    return maxChange;
+}
+
+/**
+ * Scalar version of RelaxSplitRowFunction (see kernel.h).
+ */
+static inline double relaxSplitRowScalar(
+    double * const current,
+    const double * const left,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    double maxChange = 0;
+    double sumOfSquares = 0;
+
+    for (int k = 0; k < count; k++) {
+        double newValue = (left[k] + left[k + 1]
+                           + above[k] + below[k]) / 4;
+
+        if (omega != 1) {
+            newValue = current[k] + omega * (newValue - current[k]);
+        }
+
+        const double change = fabs(newValue - current[k]);
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+
+        if (squares) {
+            sumOfSquares += change * change;
+        }
+
+        if (change < precision) {
+            continue;
+        }
+
+        current[k] = newValue;
+    }
+
+    if (squares) {
+        *squares += sumOfSquares;
+    }
+
+    return maxChange;
+}
+
+/**
+ * Scalar version of RelaxJacobiRowFunction (see kernel.h).
+ */
+static inline double relaxJacobiRowScalar(
+    double * const next,
+    const double * const current,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double precision,
+    double * const squares
+)
+{
+    double maxChange = 0;
+    double sumOfSquares = 0;
+
+    for (int k = 0; k < count; k++) {
+        const double newValue = (current[k - 1] + current[k + 1]
+                                 + above[k] + below[k]) / 4;
+
+        const double change = fabs(newValue - current[k]);
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+
+        if (squares) {
+            sumOfSquares += change * change;
+        }
+
+        next[k] = change < precision ? current[k] : newValue;
+    }
+
+    if (squares) {
+        *squares += sumOfSquares;
+    }
+
+    return maxChange;
+}
+
+/**
+ * Scalar version of RelaxSplitRowFloatFunction (see kernel.h).
+ */
+static inline float relaxSplitRowFloatScalar(
+    float * const current,
+    const float * const left,
+    const float * const above,
+    const float * const below,
+    const float * const rhs,
+    const int count,
+    const float omega,
+    const float precision
+)
+{
+    float maxChange = 0;
+
+    for (int k = 0; k < count; k++) {
+        float sum = left[k] + left[k + 1] + above[k] + below[k];
+
+        if (rhs) {
+            sum += rhs[k];
+        }
+
+        float newValue = sum / 4;
+
+        if (omega != 1) {
+            newValue = current[k] + omega * (newValue - current[k]);
+        }
+
+        const float change = fabsf(newValue - current[k]);
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+
+        if (change < precision) {
+            continue;
+        }
+
+        current[k] = newValue;
+    }
+
+    return maxChange;
+}
+
+static const RelaxKernels scalarKernels = {
+    "scalar",
+    relaxRowScalar,
+    relaxSplitRowScalar,
+    relaxJacobiRowScalar,
+    relaxSplitRowFloatScalar
+};
+
+#ifdef KERNEL_X86
+
+/**
+ * Combine a partial maximum from a vector kernel with the maximum from its
+ * scalar tail.
+ *
+ * @param  a One maximum
+ * @param  b The other maximum
+ *
+ * @return   The larger of the two
+ */
+static double maxOf(const double a, const double b)
+{
+    return a > b ? a : b;
+}
+
+/**
+ * Combine a partial maximum from a single precision vector kernel with the
+ * maximum from its scalar tail.
+ *
+ * @param  a One maximum
+ * @param  b The other maximum
+ *
+ * @return   The larger of the two
+ */
+static float maxOfFloat(const float a, const float b)
+{
+    return a > b ? a : b;
+}
+
+/**
+ * Horizontal maximum of an SSE register of floats.
+ *
+ * @param  vector The register
+ *
+ * @return        The largest of its four values
+ */
+static float maxOfSse(const __m128 vector)
+{
+    float lanes[4];
+    _mm_storeu_ps(lanes, vector);
+
+    return maxOfFloat(
+        maxOfFloat(lanes[0], lanes[1]),
+        maxOfFloat(lanes[2], lanes[3])
+    );
+}
+
+/**
+ * Horizontal sum of an SSE register.
+ *
+ * @param  vector The register
+ *
+ * @return        The sum of its two values
+ */
+static double sumOfSse2(const __m128d vector)
+{
+    double lanes[2];
+    _mm_storeu_pd(lanes, vector);
+
+    return lanes[0] + lanes[1];
+}
+
+/**
+ * SSE2 version of RelaxRowFunction. Two points (col and col + 2) per
+ * iteration, loaded into the low and high halves of each register.
+ */
+static double relaxRowSse2(
+    double * const current,
+    const double * const above,
+    const double * const below,
+    const int firstCol,
+    const int endCol,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    const __m128d quarter = _mm_set1_pd(0.25);
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    const __m128d precisionVector = _mm_set1_pd(precision);
+    const __m128d omegaVector = _mm_set1_pd(omega);
+    const int overRelax = omega != 1;
+    const int sumSquares = squares != NULL;
+
+    __m128d maxVector = _mm_setzero_pd();
+    __m128d squaresVector = _mm_setzero_pd();
+
+    int col = firstCol;
+
+    for (; col + 2 < endCol; col += 4) {
+        const __m128d left = _mm_loadh_pd(
+            _mm_load_sd(current + col - 1), current + col + 1
+        );
+        const __m128d right = _mm_loadh_pd(
+            _mm_load_sd(current + col + 1), current + col + 3
+        );
+        const __m128d up = _mm_loadh_pd(
+            _mm_load_sd(above + col), above + col + 2
+        );
+        const __m128d down = _mm_loadh_pd(
+            _mm_load_sd(below + col), below + col + 2
+        );
+        const __m128d old = _mm_loadh_pd(
+            _mm_load_sd(current + col), current + col + 2
+        );
+
+        __m128d newValue = _mm_mul_pd(
+            _mm_add_pd(_mm_add_pd(_mm_add_pd(left, right), up), down),
+            quarter
+        );
+
+        if (overRelax) {
+            newValue = _mm_add_pd(
+                old,
+                _mm_mul_pd(omegaVector, _mm_sub_pd(newValue, old))
+            );
+        }
+
+        const __m128d change = _mm_andnot_pd(
+            signMask,
+            _mm_sub_pd(newValue, old)
+        );
+
+        maxVector = _mm_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm_add_pd(
+                squaresVector,
+                _mm_mul_pd(change, change)
+            );
+        }
+
+        const __m128d update = _mm_cmpge_pd(change, precisionVector);
+        const __m128d result = _mm_or_pd(
+            _mm_and_pd(update, newValue),
+            _mm_andnot_pd(update, old)
+        );
+
+        _mm_storel_pd(current + col, result);
+        _mm_storeh_pd(current + col + 2, result);
+    }
+
+    if (squares) {
+        *squares += sumOfSse2(squaresVector);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, maxVector);
+
+    return maxOf(
+        maxOf(lanes[0], lanes[1]),
+        relaxRowScalar(
+            current,
+            above,
+            below,
+            col,
+            endCol,
+            omega,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * SSE2 version of RelaxSplitRowFunction. Two points per iteration.
+ */
+static double relaxSplitRowSse2(
+    double * const current,
+    const double * const left,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    const __m128d quarter = _mm_set1_pd(0.25);
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    const __m128d precisionVector = _mm_set1_pd(precision);
+    const __m128d omegaVector = _mm_set1_pd(omega);
+    const int overRelax = omega != 1;
+    const int sumSquares = squares != NULL;
+
+    __m128d maxVector = _mm_setzero_pd();
+    __m128d squaresVector = _mm_setzero_pd();
+
+    int k = 0;
+
+    for (; k + 2 <= count; k += 2) {
+        const __m128d old = _mm_loadu_pd(current + k);
+
+        __m128d newValue = _mm_mul_pd(
+            _mm_add_pd(
+                _mm_add_pd(
+                    _mm_add_pd(
+                        _mm_loadu_pd(left + k),
+                        _mm_loadu_pd(left + k + 1)
+                    ),
+                    _mm_loadu_pd(above + k)
+                ),
+                _mm_loadu_pd(below + k)
+            ),
+            quarter
+        );
+
+        if (overRelax) {
+            newValue = _mm_add_pd(
+                old,
+                _mm_mul_pd(omegaVector, _mm_sub_pd(newValue, old))
+            );
+        }
+
+        const __m128d change = _mm_andnot_pd(
+            signMask,
+            _mm_sub_pd(newValue, old)
+        );
+
+        maxVector = _mm_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm_add_pd(
+                squaresVector,
+                _mm_mul_pd(change, change)
+            );
+        }
+
+        const __m128d update = _mm_cmpge_pd(change, precisionVector);
+
+        _mm_storeu_pd(current + k, _mm_or_pd(
+            _mm_and_pd(update, newValue),
+            _mm_andnot_pd(update, old)
+        ));
+    }
+
+    if (squares) {
+        *squares += sumOfSse2(squaresVector);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, maxVector);
+
+    return maxOf(
+        maxOf(lanes[0], lanes[1]),
+        relaxSplitRowScalar(
+            current + k,
+            left + k,
+            above + k,
+            below + k,
+            count - k,
+            omega,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * SSE2 version of RelaxJacobiRowFunction. Two points per iteration.
+ */
+static double relaxJacobiRowSse2(
+    double * const next,
+    const double * const current,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double precision,
+    double * const squares
+)
+{
+    const __m128d quarter = _mm_set1_pd(0.25);
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    const __m128d precisionVector = _mm_set1_pd(precision);
+    const int sumSquares = squares != NULL;
+
+    __m128d maxVector = _mm_setzero_pd();
+    __m128d squaresVector = _mm_setzero_pd();
+
+    int k = 0;
+
+    for (; k + 2 <= count; k += 2) {
+        const __m128d old = _mm_loadu_pd(current + k);
+
+        const __m128d newValue = _mm_mul_pd(
+            _mm_add_pd(
+                _mm_add_pd(
+                    _mm_add_pd(
+                        _mm_loadu_pd(current + k - 1),
+                        _mm_loadu_pd(current + k + 1)
+                    ),
+                    _mm_loadu_pd(above + k)
+                ),
+                _mm_loadu_pd(below + k)
+            ),
+            quarter
+        );
+
+        const __m128d change = _mm_andnot_pd(
+            signMask,
+            _mm_sub_pd(newValue, old)
+        );
+
+        maxVector = _mm_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm_add_pd(
+                squaresVector,
+                _mm_mul_pd(change, change)
+            );
+        }
+
+        const __m128d update = _mm_cmpge_pd(change, precisionVector);
+
+        _mm_storeu_pd(next + k, _mm_or_pd(
+            _mm_and_pd(update, newValue),
+            _mm_andnot_pd(update, old)
+        ));
+    }
+
+    if (squares) {
+        *squares += sumOfSse2(squaresVector);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, maxVector);
+
+    return maxOf(
+        maxOf(lanes[0], lanes[1]),
+        relaxJacobiRowScalar(
+            next + k,
+            current + k,
+            above + k,
+            below + k,
+            count - k,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * SSE2 version of RelaxSplitRowFloatFunction. Four points per iteration.
+ */
+static float relaxSplitRowFloatSse2(
+    float * const current,
+    const float * const left,
+    const float * const above,
+    const float * const below,
+    const float * const rhs,
+    const int count,
+    const float omega,
+    const float precision
+)
+{
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 precisionVector = _mm_set1_ps(precision);
+    const __m128 omegaVector = _mm_set1_ps(omega);
+    const int overRelax = omega != 1;
+    const int hasRhs = rhs != NULL;
+
+    __m128 maxVector = _mm_setzero_ps();
+
+    int k = 0;
+
+    for (; k + 4 <= count; k += 4) {
+        const __m128 old = _mm_loadu_ps(current + k);
+
+        __m128 sum = _mm_add_ps(
+            _mm_add_ps(
+                _mm_add_ps(
+                    _mm_loadu_ps(left + k),
+                    _mm_loadu_ps(left + k + 1)
+                ),
+                _mm_loadu_ps(above + k)
+            ),
+            _mm_loadu_ps(below + k)
+        );
+
+        if (hasRhs) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(rhs + k));
+        }
+
+        __m128 newValue = _mm_mul_ps(sum, quarter);
+
+        if (overRelax) {
+            newValue = _mm_add_ps(
+                old,
+                _mm_mul_ps(omegaVector, _mm_sub_ps(newValue, old))
+            );
+        }
+
+        const __m128 change = _mm_andnot_ps(
+            signMask,
+            _mm_sub_ps(newValue, old)
+        );
+
+        maxVector = _mm_max_ps(maxVector, change);
+
+        const __m128 update = _mm_cmpge_ps(change, precisionVector);
+
+        _mm_storeu_ps(current + k, _mm_or_ps(
+            _mm_and_ps(update, newValue),
+            _mm_andnot_ps(update, old)
+        ));
+    }
+
+    return maxOfFloat(
+        maxOfSse(maxVector),
+        relaxSplitRowFloatScalar(
+            current + k,
+            left + k,
+            above + k,
+            below + k,
+            rhs ? rhs + k : NULL,
+            count - k,
+            omega,
+            precision
+        )
+    );
+}
+
+/**
+ * Horizontal maximum of an AVX register.
+ *
+ * @param  vector The register
+ *
+ * @return        The largest of its four values
+ */
+__attribute__((target("avx2")))
+static double maxOfAvx(const __m256d vector)
+{
+    double lanes[4];
+    _mm256_storeu_pd(lanes, vector);
+
+    return maxOf(maxOf(lanes[0], lanes[1]), maxOf(lanes[2], lanes[3]));
+}
+
+/**
+ * Horizontal sum of an AVX register.
+ *
+ * @param  vector The register
+ *
+ * @return        The sum of its four values
+ */
+__attribute__((target("avx2")))
+static double sumOfAvx(const __m256d vector)
+{
+    double lanes[4];
+    _mm256_storeu_pd(lanes, vector);
+
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+/**
+ * AVX2 version of RelaxRowFunction. Four points (col, col + 2, col + 4 and
+ * col + 6) per iteration. Unpacking two registers of consecutive values picks
+ * out every other value, but in the lane order (col, col + 4, col + 2,
+ * col + 6), which is fine as long as every operand is in the same order. The
+ * results are blended back into the loaded values (see top of file) and
+ * stored. The left neighbours are built from the registers loaded in this and
+ * the previous iteration rather than loaded from col - 1, as that load would
+ * overlap the previous store.
+ */
+__attribute__((target("avx2")))
+static double relaxRowAvx2(
+    double * const current,
+    const double * const above,
+    const double * const below,
+    const int firstCol,
+    const int endCol,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    const __m256d quarter = _mm256_set1_pd(0.25);
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    const __m256d precisionVector = _mm256_set1_pd(precision);
+    const __m256d omegaVector = _mm256_set1_pd(omega);
+    const int overRelax = omega != 1;
+    const int sumSquares = squares != NULL;
+
+    __m256d maxVector = _mm256_setzero_pd();
+    __m256d squaresVector = _mm256_setzero_pd();
+
+    int col = firstCol;
+
+    // The four values before col. Only the last (col - 1) is used.
+    __m256d previous = _mm256_broadcast_sd(current + col - 1);
+
+    for (; col + 6 < endCol; col += 8) {
+        const __m256d fromCol = _mm256_loadu_pd(current + col);
+        const __m256d fromColNext = _mm256_loadu_pd(current + col + 4);
+
+        // (col - 2 ... col + 1) and (col + 2 ... col + 5)
+        const __m256d left = _mm256_unpackhi_pd(
+            _mm256_permute2f128_pd(previous, fromCol, 0x21),
+            _mm256_permute2f128_pd(fromCol, fromColNext, 0x21)
+        );
+        const __m256d old = _mm256_unpacklo_pd(fromCol, fromColNext);
+        const __m256d right = _mm256_unpackhi_pd(fromCol, fromColNext);
+        const __m256d up = _mm256_unpacklo_pd(
+            _mm256_loadu_pd(above + col),
+            _mm256_loadu_pd(above + col + 4)
+        );
+        const __m256d down = _mm256_unpacklo_pd(
+            _mm256_loadu_pd(below + col),
+            _mm256_loadu_pd(below + col + 4)
+        );
+
+        __m256d newValue = _mm256_mul_pd(
+            _mm256_add_pd(
+                _mm256_add_pd(_mm256_add_pd(left, right), up),
+                down
+            ),
+            quarter
+        );
+
+        if (overRelax) {
+            newValue = _mm256_add_pd(
+                old,
+                _mm256_mul_pd(omegaVector, _mm256_sub_pd(newValue, old))
+            );
+        }
+
+        const __m256d change = _mm256_andnot_pd(
+            signMask,
+            _mm256_sub_pd(newValue, old)
+        );
+
+        maxVector = _mm256_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm256_add_pd(
+                squaresVector,
+                _mm256_mul_pd(change, change)
+            );
+        }
+
+        const __m256d result = _mm256_blendv_pd(
+            old,
+            newValue,
+            _mm256_cmp_pd(change, precisionVector, _CMP_GE_OQ)
+        );
+
+        _mm256_storeu_pd(
+            current + col,
+            _mm256_blend_pd(fromCol, result, 0x5)
+        );
+        _mm256_storeu_pd(
+            current + col + 4,
+            _mm256_blend_pd(fromColNext, _mm256_permute_pd(result, 0x5), 0x5)
+        );
+
+        // Last value is of the other colour, so unchanged by the store
+        previous = fromColNext;
+    }
+
+    if (squares) {
+        *squares += sumOfAvx(squaresVector);
+    }
+
+    return maxOf(
+        maxOfAvx(maxVector),
+        relaxRowScalar(
+            current,
+            above,
+            below,
+            col,
+            endCol,
+            omega,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * AVX2 version of RelaxSplitRowFunction. Four points per iteration.
+ */
+__attribute__((target("avx2")))
+static double relaxSplitRowAvx2(
+    double * const current,
+    const double * const left,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    const __m256d quarter = _mm256_set1_pd(0.25);
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    const __m256d precisionVector = _mm256_set1_pd(precision);
+    const __m256d omegaVector = _mm256_set1_pd(omega);
+    const int overRelax = omega != 1;
+    const int sumSquares = squares != NULL;
+
+    __m256d maxVector = _mm256_setzero_pd();
+    __m256d squaresVector = _mm256_setzero_pd();
+
+    int k = 0;
+
+    for (; k + 4 <= count; k += 4) {
+        const __m256d old = _mm256_loadu_pd(current + k);
+
+        __m256d newValue = _mm256_mul_pd(
+            _mm256_add_pd(
+                _mm256_add_pd(
+                    _mm256_add_pd(
+                        _mm256_loadu_pd(left + k),
+                        _mm256_loadu_pd(left + k + 1)
+                    ),
+                    _mm256_loadu_pd(above + k)
+                ),
+                _mm256_loadu_pd(below + k)
+            ),
+            quarter
+        );
+
+        if (overRelax) {
+            newValue = _mm256_add_pd(
+                old,
+                _mm256_mul_pd(omegaVector, _mm256_sub_pd(newValue, old))
+            );
+        }
+
+        const __m256d change = _mm256_andnot_pd(
+            signMask,
+            _mm256_sub_pd(newValue, old)
+        );
+
+        maxVector = _mm256_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm256_add_pd(
+                squaresVector,
+                _mm256_mul_pd(change, change)
+            );
+        }
+
+        _mm256_storeu_pd(current + k, _mm256_blendv_pd(
+            old,
+            newValue,
+            _mm256_cmp_pd(change, precisionVector, _CMP_GE_OQ)
+        ));
+    }
+
+    if (squares) {
+        *squares += sumOfAvx(squaresVector);
+    }
+
+    return maxOf(
+        maxOfAvx(maxVector),
+        relaxSplitRowScalar(
+            current + k,
+            left + k,
+            above + k,
+            below + k,
+            count - k,
+            omega,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * AVX2 version of RelaxJacobiRowFunction. Four points per iteration.
+ */
+__attribute__((target("avx2")))
+static double relaxJacobiRowAvx2(
+    double * const next,
+    const double * const current,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double precision,
+    double * const squares
+)
+{
+    const __m256d quarter = _mm256_set1_pd(0.25);
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    const __m256d precisionVector = _mm256_set1_pd(precision);
+    const int sumSquares = squares != NULL;
+
+    __m256d maxVector = _mm256_setzero_pd();
+    __m256d squaresVector = _mm256_setzero_pd();
+
+    int k = 0;
+
+    for (; k + 4 <= count; k += 4) {
+        const __m256d old = _mm256_loadu_pd(current + k);
+
+        const __m256d newValue = _mm256_mul_pd(
+            _mm256_add_pd(
+                _mm256_add_pd(
+                    _mm256_add_pd(
+                        _mm256_loadu_pd(current + k - 1),
+                        _mm256_loadu_pd(current + k + 1)
+                    ),
+                    _mm256_loadu_pd(above + k)
+                ),
+                _mm256_loadu_pd(below + k)
+            ),
+            quarter
+        );
+
+        const __m256d change = _mm256_andnot_pd(
+            signMask,
+            _mm256_sub_pd(newValue, old)
+        );
+
+        maxVector = _mm256_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm256_add_pd(
+                squaresVector,
+                _mm256_mul_pd(change, change)
+            );
+        }
+
+        _mm256_storeu_pd(next + k, _mm256_blendv_pd(
+            old,
+            newValue,
+            _mm256_cmp_pd(change, precisionVector, _CMP_GE_OQ)
+        ));
+    }
+
+    if (squares) {
+        *squares += sumOfAvx(squaresVector);
+    }
+
+    return maxOf(
+        maxOfAvx(maxVector),
+        relaxJacobiRowScalar(
+            next + k,
+            current + k,
+            above + k,
+            below + k,
+            count - k,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * Horizontal maximum of an AVX register of floats.
+ *
+ * @param  vector The register
+ *
+ * @return        The largest of its eight values
+ */
+__attribute__((target("avx2")))
+static float maxOfAvxFloat(const __m256 vector)
+{
+    return maxOfSse(_mm_max_ps(
+        _mm256_castps256_ps128(vector),
+        _mm256_extractf128_ps(vector, 1)
+    ));
+}
+
+/**
+ * AVX2 version of RelaxSplitRowFloatFunction. Eight points per iteration.
+ */
+__attribute__((target("avx2")))
+static float relaxSplitRowFloatAvx2(
+    float * const current,
+    const float * const left,
+    const float * const above,
+    const float * const below,
+    const float * const rhs,
+    const int count,
+    const float omega,
+    const float precision
+)
+{
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 precisionVector = _mm256_set1_ps(precision);
+    const __m256 omegaVector = _mm256_set1_ps(omega);
+    const int overRelax = omega != 1;
+    const int hasRhs = rhs != NULL;
+
+    __m256 maxVector = _mm256_setzero_ps();
+
+    int k = 0;
+
+    for (; k + 8 <= count; k += 8) {
+        const __m256 old = _mm256_loadu_ps(current + k);
+
+        __m256 sum = _mm256_add_ps(
+            _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_loadu_ps(left + k),
+                    _mm256_loadu_ps(left + k + 1)
+                ),
+                _mm256_loadu_ps(above + k)
+            ),
+            _mm256_loadu_ps(below + k)
+        );
+
+        if (hasRhs) {
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(rhs + k));
+        }
+
+        __m256 newValue = _mm256_mul_ps(sum, quarter);
+
+        if (overRelax) {
+            newValue = _mm256_add_ps(
+                old,
+                _mm256_mul_ps(omegaVector, _mm256_sub_ps(newValue, old))
+            );
+        }
+
+        const __m256 change = _mm256_andnot_ps(
+            signMask,
+            _mm256_sub_ps(newValue, old)
+        );
+
+        maxVector = _mm256_max_ps(maxVector, change);
+
+        _mm256_storeu_ps(current + k, _mm256_blendv_ps(
+            old,
+            newValue,
+            _mm256_cmp_ps(change, precisionVector, _CMP_GE_OQ)
+        ));
+    }
+
+    return maxOfFloat(
+        maxOfAvxFloat(maxVector),
+        relaxSplitRowFloatScalar(
+            current + k,
+            left + k,
+            above + k,
+            below + k,
+            rhs ? rhs + k : NULL,
+            count - k,
+            omega,
+            precision
+        )
+    );
+}
+
+/**
+ * AVX-512 version of RelaxRowFunction. Eight points (col, col + 2, ...,
+ * col + 14) per iteration, picked out of two registers of consecutive values
+ * with a two-source permute, and blended back into the loaded values (see
+ * top of file) and stored. As in the AVX2 kernel, the left neighbours are
+ * built from registers rather than loaded from col - 1.
+ */
+__attribute__((target("avx512f")))
+static double relaxRowAvx512(
+    double * const current,
+    const double * const above,
+    const double * const below,
+    const int firstCol,
+    const int endCol,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    const __m512d quarter = _mm512_set1_pd(0.25);
+    const __m512d precisionVector = _mm512_set1_pd(precision);
+    const __m512d omegaVector = _mm512_set1_pd(omega);
+    const int overRelax = omega != 1;
+    const __m512i evens = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i odds = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+    const __m512i toLowHalf = _mm512_set_epi64(3, 3, 2, 2, 1, 1, 0, 0);
+    const __m512i toHighHalf = _mm512_set_epi64(7, 7, 6, 6, 5, 5, 4, 4);
+    const int sumSquares = squares != NULL;
+
+    __m512d maxVector = _mm512_setzero_pd();
+    __m512d squaresVector = _mm512_setzero_pd();
+
+    int col = firstCol;
+
+    // The eight values before col. Only the last (col - 1) is used.
+    __m512d previous = _mm512_set1_pd(current[col - 1]);
+
+    for (; col + 14 < endCol; col += 16) {
+        const __m512d fromCol = _mm512_loadu_pd(current + col);
+        const __m512d fromColNext = _mm512_loadu_pd(current + col + 8);
+
+        // (col - 1 ... col + 6) and (col + 7 ... col + 14)
+        const __m512d left = _mm512_permutex2var_pd(
+            _mm512_castsi512_pd(_mm512_alignr_epi64(
+                _mm512_castpd_si512(fromCol),
+                _mm512_castpd_si512(previous),
+                7
+            )),
+            evens,
+            _mm512_castsi512_pd(_mm512_alignr_epi64(
+                _mm512_castpd_si512(fromColNext),
+                _mm512_castpd_si512(fromCol),
+                7
+            ))
+        );
+        const __m512d old = _mm512_permutex2var_pd(fromCol, evens, fromColNext);
+        const __m512d right = _mm512_permutex2var_pd(
+            fromCol,
+            odds,
+            fromColNext
+        );
+        const __m512d up = _mm512_permutex2var_pd(
+            _mm512_loadu_pd(above + col),
+            evens,
+            _mm512_loadu_pd(above + col + 8)
+        );
+        const __m512d down = _mm512_permutex2var_pd(
+            _mm512_loadu_pd(below + col),
+            evens,
+            _mm512_loadu_pd(below + col + 8)
+        );
+
+        __m512d newValue = _mm512_mul_pd(
+            _mm512_add_pd(
+                _mm512_add_pd(_mm512_add_pd(left, right), up),
+                down
+            ),
+            quarter
+        );
+
+        if (overRelax) {
+            newValue = _mm512_add_pd(
+                old,
+                _mm512_mul_pd(omegaVector, _mm512_sub_pd(newValue, old))
+            );
+        }
+
+        const __m512d change = _mm512_abs_pd(_mm512_sub_pd(newValue, old));
+
+        maxVector = _mm512_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm512_add_pd(
+                squaresVector,
+                _mm512_mul_pd(change, change)
+            );
+        }
+
+        const __m512d result = _mm512_mask_blend_pd(
+            _mm512_cmp_pd_mask(change, precisionVector, _CMP_GE_OQ),
+            old,
+            newValue
+        );
+
+        _mm512_storeu_pd(current + col, _mm512_mask_blend_pd(
+            0x55,
+            fromCol,
+            _mm512_permutexvar_pd(toLowHalf, result)
+        ));
+        _mm512_storeu_pd(current + col + 8, _mm512_mask_blend_pd(
+            0x55,
+            fromColNext,
+            _mm512_permutexvar_pd(toHighHalf, result)
+        ));
+
+        // Last value is of the other colour, so unchanged by the store
+        previous = fromColNext;
+    }
+
+    if (squares) {
+        *squares += _mm512_reduce_add_pd(squaresVector);
+    }
+
+    return maxOf(
+        _mm512_reduce_max_pd(maxVector),
+        relaxRowScalar(
+            current,
+            above,
+            below,
+            col,
+            endCol,
+            omega,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * AVX-512 version of RelaxSplitRowFunction. Eight points per iteration.
+ */
+__attribute__((target("avx512f")))
+static double relaxSplitRowAvx512(
+    double * const current,
+    const double * const left,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    const __m512d quarter = _mm512_set1_pd(0.25);
+    const __m512d precisionVector = _mm512_set1_pd(precision);
+    const __m512d omegaVector = _mm512_set1_pd(omega);
+    const int overRelax = omega != 1;
+    const int sumSquares = squares != NULL;
+
+    __m512d maxVector = _mm512_setzero_pd();
+    __m512d squaresVector = _mm512_setzero_pd();
+
+    int k = 0;
+
+    for (; k + 8 <= count; k += 8) {
+        const __m512d old = _mm512_loadu_pd(current + k);
+
+        __m512d newValue = _mm512_mul_pd(
+            _mm512_add_pd(
+                _mm512_add_pd(
+                    _mm512_add_pd(
+                        _mm512_loadu_pd(left + k),
+                        _mm512_loadu_pd(left + k + 1)
+                    ),
+                    _mm512_loadu_pd(above + k)
+                ),
+                _mm512_loadu_pd(below + k)
+            ),
+            quarter
+        );
+
+        if (overRelax) {
+            newValue = _mm512_add_pd(
+                old,
+                _mm512_mul_pd(omegaVector, _mm512_sub_pd(newValue, old))
+            );
+        }
+
+        const __m512d change = _mm512_abs_pd(_mm512_sub_pd(newValue, old));
+
+        maxVector = _mm512_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm512_add_pd(
+                squaresVector,
+                _mm512_mul_pd(change, change)
+            );
+        }
+
+        _mm512_storeu_pd(current + k, _mm512_mask_blend_pd(
+            _mm512_cmp_pd_mask(change, precisionVector, _CMP_GE_OQ),
+            old,
+            newValue
+        ));
+    }
+
+    if (squares) {
+        *squares += _mm512_reduce_add_pd(squaresVector);
+    }
+
+    return maxOf(
+        _mm512_reduce_max_pd(maxVector),
+        relaxSplitRowScalar(
+            current + k,
+            left + k,
+            above + k,
+            below + k,
+            count - k,
+            omega,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * AVX-512 version of RelaxJacobiRowFunction. Eight points per iteration.
+ */
+__attribute__((target("avx512f")))
+static double relaxJacobiRowAvx512(
+    double * const next,
+    const double * const current,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double precision,
+    double * const squares
+)
+{
+    const __m512d quarter = _mm512_set1_pd(0.25);
+    const __m512d precisionVector = _mm512_set1_pd(precision);
+    const int sumSquares = squares != NULL;
+
+    __m512d maxVector = _mm512_setzero_pd();
+    __m512d squaresVector = _mm512_setzero_pd();
+
+    int k = 0;
+
+    for (; k + 8 <= count; k += 8) {
+        const __m512d old = _mm512_loadu_pd(current + k);
+
+        const __m512d newValue = _mm512_mul_pd(
+            _mm512_add_pd(
+                _mm512_add_pd(
+                    _mm512_add_pd(
+                        _mm512_loadu_pd(current + k - 1),
+                        _mm512_loadu_pd(current + k + 1)
+                    ),
+                    _mm512_loadu_pd(above + k)
+                ),
+                _mm512_loadu_pd(below + k)
+            ),
+            quarter
+        );
+
+        const __m512d change = _mm512_abs_pd(_mm512_sub_pd(newValue, old));
+
+        maxVector = _mm512_max_pd(maxVector, change);
+
+        if (sumSquares) {
+            squaresVector = _mm512_add_pd(
+                squaresVector,
+                _mm512_mul_pd(change, change)
+            );
+        }
+
+        _mm512_storeu_pd(next + k, _mm512_mask_blend_pd(
+            _mm512_cmp_pd_mask(change, precisionVector, _CMP_GE_OQ),
+            old,
+            newValue
+        ));
+    }
+
+    if (squares) {
+        *squares += _mm512_reduce_add_pd(squaresVector);
+    }
+
+    return maxOf(
+        _mm512_reduce_max_pd(maxVector),
+        relaxJacobiRowScalar(
+            next + k,
+            current + k,
+            above + k,
+            below + k,
+            count - k,
+            precision,
+            squares
+        )
+    );
+}
+
+/**
+ * AVX-512 version of RelaxSplitRowFloatFunction. Sixteen points per iteration.
+ */
+__attribute__((target("avx512f")))
+static float relaxSplitRowFloatAvx512(
+    float * const current,
+    const float * const left,
+    const float * const above,
+    const float * const below,
+    const float * const rhs,
+    const int count,
+    const float omega,
+    const float precision
+)
+{
+    const __m512 quarter = _mm512_set1_ps(0.25f);
+    const __m512 precisionVector = _mm512_set1_ps(precision);
+    const __m512 omegaVector = _mm512_set1_ps(omega);
+    const int overRelax = omega != 1;
+    const int hasRhs = rhs != NULL;
+
+    __m512 maxVector = _mm512_setzero_ps();
+
+    int k = 0;
+
+    for (; k + 16 <= count; k += 16) {
+        const __m512 old = _mm512_loadu_ps(current + k);
+
+        __m512 sum = _mm512_add_ps(
+            _mm512_add_ps(
+                _mm512_add_ps(
+                    _mm512_loadu_ps(left + k),
+                    _mm512_loadu_ps(left + k + 1)
+                ),
+                _mm512_loadu_ps(above + k)
+            ),
+            _mm512_loadu_ps(below + k)
+        );
+
+        if (hasRhs) {
+            sum = _mm512_add_ps(sum, _mm512_loadu_ps(rhs + k));
+        }
+
+        __m512 newValue = _mm512_mul_ps(sum, quarter);
+
+        if (overRelax) {
+            newValue = _mm512_add_ps(
+                old,
+                _mm512_mul_ps(omegaVector, _mm512_sub_ps(newValue, old))
+            );
+        }
+
+        const __m512 change = _mm512_abs_ps(_mm512_sub_ps(newValue, old));
+
+        maxVector = _mm512_max_ps(maxVector, change);
+
+        _mm512_storeu_ps(current + k, _mm512_mask_blend_ps(
+            _mm512_cmp_ps_mask(change, precisionVector, _CMP_GE_OQ),
+            old,
+            newValue
+        ));
+    }
+
+    return maxOfFloat(
+        _mm512_reduce_max_ps(maxVector),
+        relaxSplitRowFloatScalar(
+            current + k,
+            left + k,
+            above + k,
+            below + k,
+            rhs ? rhs + k : NULL,
+            count - k,
+            omega,
+            precision
+        )
+    );
+}
+
+static const RelaxKernels sse2Kernels = {
+    "sse2",
+    relaxRowSse2,
+    relaxSplitRowSse2,
+    relaxJacobiRowSse2,
+    relaxSplitRowFloatSse2
+};
+
+static const RelaxKernels avx2Kernels = {
+    "avx2",
+    relaxRowAvx2,
+    relaxSplitRowAvx2,
+    relaxJacobiRowAvx2,
+    relaxSplitRowFloatAvx2
+};
+
+static const RelaxKernels avx512Kernels = {
+    "avx512",
+    relaxRowAvx512,
+    relaxSplitRowAvx512,
+    relaxJacobiRowAvx512,
+    relaxSplitRowFloatAvx512
+};
+
+#endif
+
+/**
+ * Get the requested kernel implementation. SOLVE_KERNEL_AUTO picks the widest
+ * one supported by the CPU, checked with cpuid the first time it is called.
+ *
+ * @param  kernel The kernel implementation to get
+ *
+ * @return        The kernels, or NULL if the CPU does not support them
+ */
+const RelaxKernels *getRelaxKernels(const SolveKernel kernel)
+{
+#ifdef KERNEL_X86
+    // SSE2 is part of x86-64, so always available
+    switch (kernel) {
+        case SOLVE_KERNEL_SCALAR:
+            return &scalarKernels;
+        case SOLVE_KERNEL_SSE2:
+            return &sse2Kernels;
+        case SOLVE_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") ? &avx2Kernels : NULL;
+        case SOLVE_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f") ? &avx512Kernels : NULL;
+        default:
+            if (__builtin_cpu_supports("avx512f")) {
+                return &avx512Kernels;
+            }
+
+            if (__builtin_cpu_supports("avx2")) {
+                return &avx2Kernels;
+            }
+
+            return &sse2Kernels;
+    }
+#else
+    if (kernel == SOLVE_KERNEL_AUTO || kernel == SOLVE_KERNEL_SCALAR) {
+        return &scalarKernels;
+    }
+
+    return NULL;
+#endif
+}
@@ -0,0 +1,142 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include "solve.h"
+
+/**
+ * Relax all points of one colour in a segment of a row of a grid stored in
+ * SOLVE_LAYOUT_NATURAL. Updates columns firstCol, firstCol + 2, ... below
+ * endCol, moving each omega times as far as the average of its four
+ * neighbours (exactly to the average if omega is 1) if that changes it by at
+ * least precision.
+ *
+ * @param  current   The row being updated
+ * @param  above     The row above
+ * @param  below     The row below
+ * @param  firstCol  The first column to update
+ * @param  endCol    Columns at or after this are not updated
+ * @param  omega     The relaxation factor (1 for Gauss-Seidel)
+ * @param  precision The precision to compare the change against
+ * @param  squares   If not NULL, increased by the sum of the squares of the
+ *                   changes (updated or not) of all the points
+ *
+ * @return           The largest change (updated or not) of any point
+ */
+typedef double (*RelaxRowFunction)(
+    double * const current,
+    const double * const above,
+    const double * const below,
+    const int firstCol,
+    const int endCol,
+    const double omega,
+    const double precision,
+    double * const squares
+);
+
+/**
+ * Relax a run of points of one colour in a row of a SplitGrid. Point k of
+ * current moves towards (left[k] + left[k + 1] + above[k] + below[k]) / 4 as
+ * in RelaxRowFunction, where left points at the left neighbour of current[0]
+ * in the other colour's row (see relaxBandSplit in solve.c).
+ *
+ * @param  current   The first point of the run being updated
+ * @param  left      The left neighbour of current[0]
+ * @param  above     The neighbour above current[0]
+ * @param  below     The neighbour below current[0]
+ * @param  count     The number of points to update
+ * @param  omega     The relaxation factor (1 for Gauss-Seidel)
+ * @param  precision The precision to compare the change against
+ * @param  squares   If not NULL, increased by the sum of the squares of the
+ *                   changes (updated or not) of all the points
+ *
+ * @return           The largest change (updated or not) of any point
+ */
+typedef double (*RelaxSplitRowFunction)(
+    double * const current,
+    const double * const left,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double omega,
+    const double precision,
+    double * const squares
+);
+
+/**
+ * Jacobi-relax a run of consecutive points of a row, reading the current
+ * values and writing the new ones to a separate buffer. next[k] becomes
+ * (current[k - 1] + current[k + 1] + above[k] + below[k]) / 4 if that differs
+ * from current[k] by at least precision, and current[k] otherwise.
+ *
+ * @param  next      The first point of the run in the buffer being written
+ * @param  current   The first point of the run in the buffer being read
+ * @param  above     The point above current[0]
+ * @param  below     The point below current[0]
+ * @param  count     The number of points to update
+ * @param  precision The precision to compare the change against
+ * @param  squares   If not NULL, increased by the sum of the squares of the
+ *                   changes (updated or not) of all the points
+ *
+ * @return           The largest change (updated or not) of any point
+ */
+typedef double (*RelaxJacobiRowFunction)(
+    double * const next,
+    const double * const current,
+    const double * const above,
+    const double * const below,
+    const int count,
+    const double precision,
+    double * const squares
+);
+
+/**
+ * The same as RelaxSplitRowFunction, but for a SplitFloatGrid, so every
+ * value (and the arithmetic) is single precision. Used for the first phase
+ * of SOLVE_FLOAT_MIXED. With a right hand side, each point is set from
+ * the sum of its neighbours plus its value in rhs, which relaxes a
+ * correction whose residual is rhs (see src/solve/mixed.c).
+ *
+ * @param  current   The first point of the run being updated
+ * @param  left      The left neighbour of current[0]
+ * @param  above     The neighbour above current[0]
+ * @param  below     The neighbour below current[0]
+ * @param  rhs       The right hand side of current[0], or NULL for none
+ * @param  count     The number of points to update
+ * @param  omega     The relaxation factor (1 for Gauss-Seidel)
+ * @param  precision The precision to compare the change against
+ *
+ * @return           The largest change (updated or not) of any point
+ */
+typedef float (*RelaxSplitRowFloatFunction)(
+    float * const current,
+    const float * const left,
+    const float * const above,
+    const float * const below,
+    const float * const rhs,
+    const int count,
+    const float omega,
+    const float precision
+);
+
+// One implementation of the relaxation kernels
+typedef struct {
+    const char * name; // Name of the instruction set used
+    RelaxRowFunction relaxRow; // Kernel for SOLVE_LAYOUT_NATURAL
+    RelaxSplitRowFunction relaxSplitRow; // Kernel for SOLVE_LAYOUT_SPLIT
+    RelaxJacobiRowFunction relaxJacobiRow; // Kernel for SOLVE_METHOD_JACOBI
+    RelaxSplitRowFloatFunction relaxSplitRowFloat; // Kernel for the single
+                                                   // precision phase of
+                                                   // SOLVE_FLOAT_MIXED
+} RelaxKernels;
+
+/**
+ * Get the requested kernel implementation. SOLVE_KERNEL_AUTO picks the widest
+ * one supported by the CPU, checked with cpuid the first time it is called.
+ *
+ * @param  kernel The kernel implementation to get
+ *
+ * @return        The kernels, or NULL if the CPU does not support them
+ */
+const RelaxKernels *getRelaxKernels(const SolveKernel kernel);
+
+#endif
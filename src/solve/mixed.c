@@ -0,0 +1,545 @@
+/**
+ * The single precision phase of SOLVE_FLOAT_MIXED: mixed precision iterative
+ * refinement with red-black Gauss-Seidel (or SOR) sweeps in float, done in
+ * the same way as SOLVE_MODE_BANDS with SOLVE_LAYOUT_SPLIT (see
+ * relaxBandSplit in src/solve/solve.c), but with each point 4 bytes rather
+ * than 8, so each vector holds twice as many points.
+ *
+ * A float only has 24 bits of mantissa, so relaxing a float copy of the grid
+ * stops making progress once the changes are down to a few units in the last
+ * place of the largest value in the grid. For a slowly converging grid that
+ * is long before the error is small, as Gauss-Seidel changes each point by
+ * far less than its error. So the phase works in rounds:
+ *
+ *  - Round 0 relaxes a float copy of the grid itself, then copies the
+ *    interior back into the (double) values.
+ *  - Every later round works out the residual r of the values in double,
+ *    and relaxes the correction e with the residual r (the sum of the
+ *    neighbours of e plus r, less 4e, is 0) in float, starting from 0. The
+ *    correction is only as large as the error left, so float resolves it
+ *    far more finely than the values themselves. It is then added back into
+ *    the values in double.
+ *
+ * With SOLVE_CRITERION_CHANGE, a round stops once no point changes by the
+ * precision, and that ends the phase unless it was round 0. In round 0 the
+ * rounding of the values themselves shifts the largest change by up to a
+ * few units in their last place, which for a slowly converging grid moves
+ * the sweep it falls below the precision by many sweeps, so a correction
+ * round always follows. With the other criteria, a round stops once its
+ * changes have halved, and the criterion is tested from the residual at the
+ * start of the next round (see isFloatSolved).
+ *
+ * A round also stops once its changes are below the floor float cannot go
+ * much below: FLOAT_PRECISION_FLOOR relative to the largest value being
+ * relaxed, raised for SOR, which damps rounding errors more slowly (see
+ * getFloorScale). Failing that, a round whose changes have not reached a new
+ * low in FLOAT_STALL_SWEEPS sweeps has stalled too. A correction round that
+ * stops like this without halving its changes ends the phase, as another
+ * would not do better. solve then finishes with double precision sweeps,
+ * which must also meet the criterion, so the answer meets the same criterion
+ * as a double precision solve.
+ */
+
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "../barrier/barrier.h"
+#include "solve.h"
+#include "kernel.h"
+#include "band.h"
+#include "context.h"
+#include "criterion.h"
+#include "mixed.h"
+
+// Smallest change, relative to the largest value being relaxed, that float
+// can reliably resolve with Gauss-Seidel
+#define FLOAT_PRECISION_FLOOR (16 * FLT_EPSILON)
+
+// Sweeps between updates of the largest value being relaxed
+#define FLOAT_FLOOR_SWEEPS 64
+
+// Sweeps without a new lowest change after which a round is taken to have
+// stalled, whatever the floor
+#define FLOAT_STALL_SWEEPS 4096
+
+// struct to pass multiple arguments to the pool task
+typedef struct {
+    Grid * values; // The values being solved, in double precision
+    SplitFloatGrid * split; // The float copy of the values, or the correction
+    SplitFloatGrid * rhs; // The residual of the values at the start of the
+                          // round
+    const RelaxKernels * kernels; // The relaxation kernels to use
+    float precision; // The precision to hand to the kernels
+    float omega; // The relaxation factor
+    double floorScale; // Turns the largest value into the floor of the
+                       // changes (see getFloorScale)
+    const SolveOptions * options; // Options of the solve (criterion,
+                                  // precision and omega are used)
+    double reference; // Residual before the solve, for
+                      // SOLVE_CRITERION_RELATIVE
+    int threads; // The number of workers
+    Barrier barrier; // Barrier between half-sweeps
+    WorkerResult * results; // Result of each worker
+    int sweeps; // Sweeps done in all rounds, set by worker 0
+} FloatBandArgs;
+
+/**
+ * Relax all points of one colour in a band of rows of a SplitFloatGrid.
+ *
+ * @param  args          FloatBandArgs shared by all workers
+ * @param  rowStart      The first row of the band
+ * @param  rowEnd        One past the last row of the band
+ * @param  oddPointsFlag 1 to update 'O' points, 0 to update 'E' points
+ * @param  useRhs        1 to relax the correction with args->rhs, 0 to relax
+ *                       the values themselves
+ *
+ * @return               The largest change of any point in the band
+ */
+static float relaxFloatBand(
+    const FloatBandArgs * const args,
+    const int rowStart,
+    const int rowEnd,
+    const int oddPointsFlag,
+    const int useRhs
+)
+{
+    const SplitFloatGrid * const split = args->split;
+    const int otherFlag = !oddPointsFlag;
+
+    float maxChange = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const int firstCol = 2 - ((row + oddPointsFlag) & 1);
+        const int s = firstCol & 1;
+        const int firstK = firstCol / 2;
+        const int count = (split->dimension - firstCol) / 2;
+
+        const float change = args->kernels->relaxSplitRowFloat(
+            splitFloatGridRow(split, oddPointsFlag, row) + firstK,
+            splitFloatGridRow(split, otherFlag, row) + firstK - 1 + s,
+            splitFloatGridRow(split, otherFlag, row - 1) + firstK,
+            splitFloatGridRow(split, otherFlag, row + 1) + firstK,
+            useRhs
+            ? splitFloatGridRow(args->rhs, oddPointsFlag, row) + firstK
+            : NULL,
+            count,
+            args->omega,
+            args->precision
+        );
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+    }
+
+    return maxChange;
+}
+
+/**
+ * Start a refinement round in a band of rows: work out the residual of each
+ * interior point of the values in double, store it in args->rhs, and set the
+ * correction to 0. Worker 0 also clears the edge rows of the correction.
+ *
+ * @param  args     FloatBandArgs shared by all workers
+ * @param  workerId The ID of the worker
+ * @param  rowStart The first row of the band
+ * @param  rowEnd   One past the last row of the band
+ *
+ * @return          The largest residual, and sum of the squares of the
+ *                  residuals, of the points in the band
+ */
+static ChangeNorms startRound(
+    const FloatBandArgs * const args,
+    const int workerId,
+    const int rowStart,
+    const int rowEnd
+)
+{
+    const Grid * const values = args->values;
+    const SplitFloatGrid * const split = args->split;
+    const int dimension = values->dimension;
+    const size_t rowSize = split->stride * sizeof(float);
+
+    ChangeNorms norms = {0, 0};
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const current = gridRow(values, row);
+        const double * const above = gridRow(values, row - 1);
+        const double * const below = gridRow(values, row + 1);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            const double residual = current[col - 1] + current[col + 1]
+                                    + above[col] + below[col]
+                                    - 4 * current[col];
+
+            splitFloatGridRow(args->rhs, (row + col) & 1, row)[col / 2] =
+                (float)residual;
+
+            if (fabs(residual) > norms.max) {
+                norms.max = fabs(residual);
+            }
+
+            norms.squares += residual * residual;
+        }
+
+        memset(splitFloatGridRow(split, 0, row), 0, rowSize);
+        memset(splitFloatGridRow(split, 1, row), 0, rowSize);
+    }
+
+    if (workerId == 0) {
+        for (int flag = 0; flag <= 1; flag++) {
+            memset(splitFloatGridRow(split, flag, 0), 0, rowSize);
+            memset(splitFloatGridRow(split, flag, dimension - 1), 0, rowSize);
+        }
+    }
+
+    return norms;
+}
+
+/**
+ * Finish a round in a band of rows: copy the interior of the float copy back
+ * into the values after round 0, or add the correction to them after later
+ * rounds.
+ *
+ * @param args     FloatBandArgs shared by all workers
+ * @param round    The round that has finished
+ * @param rowStart The first row of the band
+ * @param rowEnd   One past the last row of the band
+ */
+static void finishRound(
+    const FloatBandArgs * const args,
+    const int round,
+    const int rowStart,
+    const int rowEnd
+)
+{
+    const int dimension = args->values->dimension;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        double * const current = gridRow(args->values, row);
+        const float * const even = splitFloatGridRow(args->split, 0, row);
+        const float * const odd = splitFloatGridRow(args->split, 1, row);
+
+        // The edges are fixed, and only the interior is rounded to float
+        for (int col = 1; col < dimension - 1; col++) {
+            const int k = col / 2;
+            const float value = ((row + col) & 1) ? odd[k] : even[k];
+
+            current[col] = round ? current[col] + value : value;
+        }
+    }
+}
+
+/**
+ * Work out the floor of the changes float can reach, relative to the largest
+ * value being relaxed. Each sweep adds rounding errors of a few units in the
+ * last place, and SOR only damps the roughest of them by |1 - omega| per
+ * sweep, so they add up to 1 / sqrt(1 - (1 - omega)^2) times as much as with
+ * Gauss-Seidel.
+ *
+ * @param  omega The relaxation factor
+ *
+ * @return       The floor of the changes over the largest value
+ */
+static double getFloorScale(const double omega)
+{
+    const double damping = 1 - omega;
+
+    return FLOAT_PRECISION_FLOOR / sqrt(1 - damping * damping);
+}
+
+/**
+ * Check whether the values at the start of a round already meet the
+ * criterion, judged from their residual. For SOLVE_CRITERION_CHANGE_L2, the
+ * change of a double precision sweep is taken to be omega / 4 times the
+ * residual, which it is for the 'E' points. SOLVE_CRITERION_CHANGE is left to
+ * the sweeps of the round, which test it exactly.
+ *
+ * @param  args      FloatBandArgs shared by all workers
+ * @param  residuals The largest residual, and sum of the squares of the
+ *                   residuals, of the whole grid
+ *
+ * @return           1 if the criterion is met, 0 otherwise
+ */
+static int isFloatSolved(
+    const FloatBandArgs * const args,
+    const ChangeNorms * const residuals
+)
+{
+    const SolveOptions * const options = args->options;
+    const int interior = args->values->dimension - 2;
+    const double points = (double) interior * interior;
+    const double rms = points > 0 ? sqrt(residuals->squares / points) : 0;
+    const double toChange = options->omega / 4;
+
+    switch (options->criterion) {
+        case SOLVE_CRITERION_CHANGE_L2:
+            return toChange * rms < options->precision;
+        case SOLVE_CRITERION_RESIDUAL:
+            return residuals->max < options->precision;
+        case SOLVE_CRITERION_RESIDUAL_L2:
+            return rms < options->precision;
+        case SOLVE_CRITERION_RELATIVE:
+            return rms < options->precision * args->reference;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Get the largest magnitude of any point in a band of rows of the float copy
+ * (or correction).
+ *
+ * @param  args     FloatBandArgs shared by all workers
+ * @param  rowStart The first row of the band
+ * @param  rowEnd   One past the last row of the band
+ *
+ * @return          The largest magnitude
+ */
+static float getLargestValue(
+    const FloatBandArgs * const args,
+    const int rowStart,
+    const int rowEnd
+)
+{
+    const SplitFloatGrid * const split = args->split;
+
+    float largest = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        for (int col = 0; col < split->dimension; col++) {
+            const float value = fabsf(
+                splitFloatGridRow(split, (row + col) & 1, row)[col / 2]
+            );
+
+            if (value > largest) {
+                largest = value;
+            }
+        }
+    }
+
+    return largest;
+}
+
+/**
+ * Pool task for the single precision phase. Runs the rounds described at the
+ * top of the file, with each worker relaxing its own band of rows as in
+ * runBands in src/solve/solve.c. Every worker makes the same decisions from
+ * the shared results, so they all stop together.
+ *
+ * @param workerId The ID of the worker
+ * @param args     FloatBandArgs shared by all workers
+ */
+static void runFloatBands(const int workerId, void * const args)
+{
+    FloatBandArgs * const bandArgs = (FloatBandArgs *) args;
+    WorkerResult * const results = bandArgs->results;
+    SweepNorms * const norms = &results[workerId].norms;
+    const int threads = bandArgs->threads;
+    const int changeCriterion = bandArgs->options->criterion
+                                == SOLVE_CRITERION_CHANGE;
+
+    int rowStart, rowEnd;
+    getBand(
+        workerId,
+        threads,
+        bandArgs->values->dimension,
+        &rowStart,
+        &rowEnd
+    );
+
+    const ChangeNorms zero = {0, 0};
+
+    SweepNorms total;
+
+    int sweeps = 0;
+    int finished = 0;
+
+    for (int round = 0; !finished; round++) {
+        norms->even = zero;
+        norms->odd = zero;
+        norms->previousOdd = zero;
+
+        if (round) {
+            norms->even = startRound(bandArgs, workerId, rowStart, rowEnd);
+
+            waitBarrier(&bandArgs->barrier);
+
+            sumWorkerNorms(results, threads, &total);
+
+            if (isFloatSolved(bandArgs, &total.even)) {
+                break;
+            }
+        }
+
+        double firstChange = 0;
+        double lowestChange = 0;
+        double change = 0;
+        double floor = 0;
+        int sinceLowest = 0;
+        int reached = 0;
+        int floored = 0;
+
+        for (int roundSweeps = 0; !reached && !floored; roundSweeps++) {
+            const int floorDue = roundSweeps % FLOAT_FLOOR_SWEEPS == 0;
+
+            float maxChange = relaxFloatBand(
+                bandArgs,
+                rowStart,
+                rowEnd,
+                0,
+                round
+            );
+
+            waitBarrier(&bandArgs->barrier);
+
+            const float oddChange = relaxFloatBand(
+                bandArgs,
+                rowStart,
+                rowEnd,
+                1,
+                round
+            );
+
+            if (oddChange > maxChange) {
+                maxChange = oddChange;
+            }
+
+            norms->even.max = maxChange;
+
+            if (floorDue) {
+                norms->odd.max = getLargestValue(bandArgs, rowStart, rowEnd);
+            }
+
+            waitBarrier(&bandArgs->barrier);
+
+            sumWorkerNorms(results, threads, &total);
+
+            change = total.even.max;
+
+            if (floorDue) {
+                floor = bandArgs->floorScale * total.odd.max;
+            }
+
+            if (roundSweeps == 0) {
+                firstChange = change;
+            }
+
+            if (roundSweeps == 0 || change < lowestChange) {
+                lowestChange = change;
+                sinceLowest = 0;
+            } else {
+                sinceLowest++;
+            }
+
+            // The other criteria are tested at the start of the next round
+            reached = change < (changeCriterion
+                                ? bandArgs->precision
+                                : firstChange / 2);
+            floored = change < floor || sinceLowest >= FLOAT_STALL_SWEEPS;
+
+            sweeps++;
+        }
+
+        finishRound(bandArgs, round, rowStart, rowEnd);
+
+        if (reached) {
+            finished = changeCriterion && round;
+        } else {
+            // A round that cannot halve the changes is not worth another
+            finished = round && change >= firstChange / 2;
+        }
+
+        // The next round works out the residual from neighbouring bands
+        waitBarrier(&bandArgs->barrier);
+    }
+
+    if (workerId == 0) {
+        bandArgs->sweeps = sweeps;
+    }
+}
+
+/**
+ * Do the single precision phase of SOLVE_FLOAT_MIXED: relax a float copy of
+ * the given values, then refine them with corrections relaxed in float from
+ * their residual worked out in double, until no point changes by the
+ * precision or float stops making progress (see top of file).
+ *
+ * @param  values    The grid of values to relax, updated in place
+ * @param  options   Options controlling the solve (threads, precision etc.)
+ * @param  kernels   The relaxation kernels to use
+ * @param  reference The root mean square residual of the grid before the
+ *                   solve, for SOLVE_CRITERION_RELATIVE
+ * @param  result    Set to information about the solve (floatIterations)
+ *
+ * @return           0 on success, or an error code otherwise
+ */
+int relaxFloat(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    const double reference,
+    SolveResult * const result
+)
+{
+    const int threads = options->threads;
+
+    int error = 0;
+
+    FloatBandArgs bandArgs;
+    bandArgs.values = values;
+    bandArgs.split = takeScratchSplitFloatGrid(options, values->dimension);
+    bandArgs.rhs = takeScratchSplitFloatGrid(options, values->dimension);
+    bandArgs.kernels = kernels;
+    bandArgs.precision = (float)getKernelPrecision(options);
+    bandArgs.omega = (float)options->omega;
+    bandArgs.floorScale = getFloorScale(options->omega);
+    bandArgs.options = options;
+    bandArgs.reference = reference;
+    bandArgs.threads = threads;
+    bandArgs.results = takeScratchResults(options);
+    bandArgs.sweeps = 0;
+
+    if (!bandArgs.split || !bandArgs.rhs || !bandArgs.results) {
+        error = ENOMEM;
+    }
+
+    if (!error) {
+        splitFloatGrid(bandArgs.split, values);
+
+        ThreadPool * const pool = createSolvePool(options, &error);
+
+        if (!error) {
+            error = initBarrier(
+                &bandArgs.barrier,
+                threads,
+                options->spinCount
+            );
+
+            if (!error) {
+                runThreadPool(pool, runFloatBands, &bandArgs);
+
+                destroyBarrier(&bandArgs.barrier);
+            }
+
+            const int poolError = releaseSolvePool(options, pool);
+
+            if (!error) {
+                error = poolError;
+            }
+        }
+    }
+
+    result->floatIterations = bandArgs.sweeps;
+
+    releaseScratchResults(options, bandArgs.results);
+    releaseScratchSplitFloatGrid(options, bandArgs.rhs);
+    releaseScratchSplitFloatGrid(options, bandArgs.split);
+
+    return error;
+}
@@ -0,0 +1,31 @@
+#ifndef MIXED_H
+#define MIXED_H
+
+#include "../array/array.h"
+#include "solve.h"
+#include "kernel.h"
+
+/**
+ * Do the single precision phase of SOLVE_FLOAT_MIXED: relax a float copy of
+ * the given values, then refine them with corrections relaxed in float from
+ * their residual worked out in double, until no point changes by the
+ * precision or float stops making progress (see src/solve/mixed.c).
+ *
+ * @param  values    The grid of values to relax, updated in place
+ * @param  options   Options controlling the solve (threads, precision etc.)
+ * @param  kernels   The relaxation kernels to use
+ * @param  reference The root mean square residual of the grid before the
+ *                   solve, for SOLVE_CRITERION_RELATIVE
+ * @param  result    Set to information about the solve (floatIterations)
+ *
+ * @return           0 on success, or an error code otherwise
+ */
+int relaxFloat(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    const double reference,
+    SolveResult * const result
+);
+
+#endif
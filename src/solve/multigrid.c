@@ -0,0 +1,649 @@
+/**
+ * Geometric multigrid, built on the same red-black Gauss-Seidel relaxation as
+ * the rest of the solver (see top of src/solve/solve.c).
+ *
+ * Relaxation quickly smooths out the error between neighbouring points, but
+ * takes O(n^2) sweeps to remove error that varies slowly across the grid.
+ * Multigrid removes that error on a hierarchy of coarser grids ('levels'),
+ * where it varies quickly again. Each level has every other row and column of
+ * the level above, so level l + 1 of a level of dimension n has dimension
+ * n / 2 + 1, with point (I, J) at point (2I, 2J) of level l. If n is even
+ * the last row and column of level l + 1 lie one point outside level l, which
+ * makes the coarse grids a slightly worse approximation but does not change
+ * the solution, as the full grid is always relaxed last.
+ *
+ * Level l solves A u = f, where A u = (4u - sum of the four neighbours) / h^2
+ * and h = 2^l is the spacing of its points. On the full grid f is 0 (the
+ * problem we are solving), and on coarser levels u is the correction to the
+ * level above and f its restricted residual.
+ *
+ * All workers run the whole solve as a single pool task, each working on its
+ * own band of rows (see src/solve/band.c) of whichever level is being worked
+ * on, with a barrier between steps.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "../barrier/barrier.h"
+#include "solve.h"
+#include "kernel.h"
+#include "band.h"
+#include "context.h"
+#include "multigrid.h"
+
+// Levels are added until one has at most this dimension
+#define COARSEST_DIMENSION 3
+
+// Sweeps done on each level before and after correcting from the next one
+#define PRE_SMOOTHING_SWEEPS 2
+#define POST_SMOOTHING_SWEEPS 2
+
+// Sweeps done on the coarsest level (one is exact for a single point)
+#define COARSEST_SWEEPS 2
+
+// One level of the multigrid hierarchy
+typedef struct {
+    Grid * u; // Values (full grid) or correction being solved for
+    Grid * f; // Right hand side, or NULL on the full grid where it is 0
+    Grid * r; // Residual, f - A u
+    double spacing2; // Square of the spacing of points, h^2
+} Level;
+
+// struct to pass multiple arguments to the pool task
+typedef struct {
+    Level * levels; // The levels, from the full grid (0) to the coarsest
+    int levelCount; // The number of levels
+    const RelaxKernels * kernels; // The kernels to relax the full grid with
+    double precision; // The precision to work to
+    int threads; // The number of workers
+    int fullMultigrid; // Flag - start with full multigrid
+    Barrier barrier; // Barrier between steps
+    WorkerResult * results; // Result of the last cycle for each worker
+    int cycles; // Cycles of the full grid done, set by worker 0
+} MultigridArgs;
+
+/**
+ * Relax all points of one colour in a segment of a row of a coarse level,
+ * setting each to (sum of the four neighbours + h^2 f) / 4. Unlike the
+ * kernels in kernel.c every point is updated, however small the change.
+ *
+ * @param  current  The row being updated
+ * @param  above    The row above
+ * @param  below    The row below
+ * @param  rhs      The row of f
+ * @param  spacing2 The square of the spacing of points, h^2
+ * @param  firstCol The first column to update
+ * @param  endCol   Columns at or after this are not updated
+ *
+ * @return          The largest change of any point
+ */
+static double relaxRowRhs(
+    double * const current,
+    const double * const above,
+    const double * const below,
+    const double * const rhs,
+    const double spacing2,
+    const int firstCol,
+    const int endCol
+)
+{
+    double maxChange = 0;
+
+    for (int col = firstCol; col < endCol; col += 2) {
+        const double newValue = (current[col - 1] + current[col + 1]
+                                 + above[col] + below[col]
+                                 + spacing2 * rhs[col]) / 4;
+
+        const double change = fabs(newValue - current[col]);
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+
+        current[col] = newValue;
+    }
+
+    return maxChange;
+}
+
+/**
+ * Relax all points of one colour in a worker's band of a level.
+ *
+ * @param  args          MultigridArgs shared by all workers
+ * @param  workerId      The ID of the worker
+ * @param  level         The index of the level
+ * @param  oddPointsFlag 1 to update 'O' points, 0 to update 'E' points
+ *
+ * @return               The largest change of any point in the band
+ */
+static double relaxLevelBand(
+    MultigridArgs * const args,
+    const int workerId,
+    const int level,
+    const int oddPointsFlag
+)
+{
+    const Level * const current = &args->levels[level];
+    const int dimension = current->u->dimension;
+
+    int rowStart, rowEnd;
+    getBand(workerId, args->threads, dimension, &rowStart, &rowEnd);
+
+    double maxChange = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const int firstCol = 2 - ((row + oddPointsFlag) & 1);
+        double change;
+
+        if (current->f) {
+            change = relaxRowRhs(
+                gridRow(current->u, row),
+                gridRow(current->u, row - 1),
+                gridRow(current->u, row + 1),
+                gridRow(current->f, row),
+                current->spacing2,
+                firstCol,
+                dimension - 1
+            );
+        } else {
+            // A precision of 0 updates every point
+            change = args->kernels->relaxRow(
+                gridRow(current->u, row),
+                gridRow(current->u, row - 1),
+                gridRow(current->u, row + 1),
+                firstCol,
+                dimension - 1,
+                1,
+                0,
+                NULL
+            );
+        }
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+    }
+
+    return maxChange;
+}
+
+/**
+ * Do a number of red-black sweeps of a level. Ends with a barrier, so the
+ * whole level is smoothed when this returns.
+ *
+ * @param  args     MultigridArgs shared by all workers
+ * @param  workerId The ID of the worker
+ * @param  level    The index of the level
+ * @param  sweeps   The number of sweeps to do
+ *
+ * @return          The largest change of any point in the worker's band in
+ *                  the last sweep
+ */
+static double smoothLevel(
+    MultigridArgs * const args,
+    const int workerId,
+    const int level,
+    const int sweeps
+)
+{
+    double maxChange = 0;
+
+    for (int sweep = 0; sweep < sweeps; sweep++) {
+        maxChange = relaxLevelBand(args, workerId, level, 0);
+
+        waitBarrier(&args->barrier);
+
+        const double oddChange = relaxLevelBand(args, workerId, level, 1);
+
+        if (oddChange > maxChange) {
+            maxChange = oddChange;
+        }
+
+        waitBarrier(&args->barrier);
+    }
+
+    return maxChange;
+}
+
+/**
+ * Work out the residual r = f - A u of a level in a worker's band. The edges
+ * of r are never written, so stay 0.
+ *
+ * @param args     MultigridArgs shared by all workers
+ * @param workerId The ID of the worker
+ * @param level    The index of the level
+ */
+static void computeResidual(
+    MultigridArgs * const args,
+    const int workerId,
+    const int level
+)
+{
+    const Level * const current = &args->levels[level];
+    const int dimension = current->u->dimension;
+    const double scale = 1 / current->spacing2;
+
+    int rowStart, rowEnd;
+    getBand(workerId, args->threads, dimension, &rowStart, &rowEnd);
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const u = gridRow(current->u, row);
+        const double * const above = gridRow(current->u, row - 1);
+        const double * const below = gridRow(current->u, row + 1);
+        const double * const f = current->f ? gridRow(current->f, row) : NULL;
+        double * const r = gridRow(current->r, row);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            const double sum = u[col - 1] + u[col + 1]
+                               + above[col] + below[col];
+
+            r[col] = (f ? f[col] : 0) - (4 * u[col] - sum) * scale;
+        }
+    }
+}
+
+/**
+ * Restrict the residual of a level to f of the next coarser level, by full
+ * weighting, in the worker's band of the coarser level. Also clears u of the
+ * coarser level, as the starting guess for the correction.
+ *
+ * @param args     MultigridArgs shared by all workers
+ * @param workerId The ID of the worker
+ * @param level    The index of the finer level
+ */
+static void restrictResidual(
+    MultigridArgs * const args,
+    const int workerId,
+    const int level
+)
+{
+    const Grid * const fine = args->levels[level].r;
+    const Level * const coarse = &args->levels[level + 1];
+    const int dimension = coarse->u->dimension;
+
+    int rowStart, rowEnd;
+    getBand(workerId, args->threads, dimension, &rowStart, &rowEnd);
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const above = gridRow(fine, 2 * row - 1);
+        const double * const middle = gridRow(fine, 2 * row);
+        const double * const below = gridRow(fine, 2 * row + 1);
+        double * const f = gridRow(coarse->f, row);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            const int c = 2 * col;
+
+            f[col] = (4 * middle[c]
+                      + 2 * (middle[c - 1] + middle[c + 1]
+                             + above[c] + below[c])
+                      + above[c - 1] + above[c + 1]
+                      + below[c - 1] + below[c + 1]) / 16;
+        }
+    }
+
+    // The correction is 0 on the edges, and starts as 0 everywhere else
+    if (workerId == 0) {
+        rowStart = 0;
+    }
+
+    if (workerId == args->threads - 1) {
+        rowEnd = dimension;
+    }
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        double * const u = gridRow(coarse->u, row);
+
+        for (int col = 0; col < dimension; col++) {
+            u[col] = 0;
+        }
+    }
+}
+
+/**
+ * Bilinearly interpolate u of a coarse level to the interior of the next
+ * finer level, in the worker's band of the finer level. Fine point (i, j)
+ * lies between coarse rows i / 2 and (i + 1) / 2 and columns j / 2 and
+ * (j + 1) / 2 (the same row or column if i or j is even).
+ *
+ * @param args     MultigridArgs shared by all workers
+ * @param workerId The ID of the worker
+ * @param level    The index of the finer level
+ * @param add      1 to add the interpolated values to the finer level (a
+ *                 correction), 0 to replace them (full multigrid)
+ */
+static void prolongLevel(
+    MultigridArgs * const args,
+    const int workerId,
+    const int level,
+    const int add
+)
+{
+    Grid * const fine = args->levels[level].u;
+    const Grid * const coarse = args->levels[level + 1].u;
+    const int dimension = fine->dimension;
+
+    int rowStart, rowEnd;
+    getBand(workerId, args->threads, dimension, &rowStart, &rowEnd);
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double * const first = gridRow(coarse, row / 2);
+        const double * const second = gridRow(coarse, (row + 1) / 2);
+        double * const u = gridRow(fine, row);
+
+        for (int col = 1; col < dimension - 1; col++) {
+            const int left = col / 2;
+            const int right = (col + 1) / 2;
+
+            const double value = (first[left] + first[right]
+                                  + second[left] + second[right]) / 4;
+
+            u[col] = add ? u[col] + value : value;
+        }
+    }
+}
+
+/**
+ * Do a V-cycle starting at the given level: smooth, correct the level from
+ * the next coarser one (recursively), then smooth again. Ends with a
+ * barrier.
+ *
+ * @param  args     MultigridArgs shared by all workers
+ * @param  workerId The ID of the worker
+ * @param  level    The index of the level to start at
+ *
+ * @return          The largest change of any point in the worker's band of
+ *                  the level in the last smoothing sweep
+ */
+static double runVCycle(
+    MultigridArgs * const args,
+    const int workerId,
+    const int level
+)
+{
+    if (level == args->levelCount - 1) {
+        return smoothLevel(args, workerId, level, COARSEST_SWEEPS);
+    }
+
+    smoothLevel(args, workerId, level, PRE_SMOOTHING_SWEEPS);
+
+    computeResidual(args, workerId, level);
+
+    waitBarrier(&args->barrier);
+
+    restrictResidual(args, workerId, level);
+
+    waitBarrier(&args->barrier);
+
+    runVCycle(args, workerId, level + 1);
+
+    prolongLevel(args, workerId, level, 1);
+
+    waitBarrier(&args->barrier);
+
+    return smoothLevel(args, workerId, level, POST_SMOOTHING_SWEEPS);
+}
+
+/**
+ * Pool task for the multigrid methods. With full multigrid, first solves the
+ * coarsest level and works up, interpolating each level's solution to the
+ * next and doing a V-cycle there. Then does V-cycles on the full grid until
+ * one is converged. As in SOLVE_MODE_BANDS (see runBands in solve.c), each
+ * worker records its result and every worker reads all of them after a
+ * barrier to decide whether to stop.
+ *
+ * @param workerId The ID of the worker
+ * @param args     MultigridArgs shared by all workers
+ */
+static void runMultigrid(const int workerId, void * const args)
+{
+    MultigridArgs * const multigridArgs = (MultigridArgs *) args;
+    const int coarsest = multigridArgs->levelCount - 1;
+
+    double maxChange;
+    int cycles = 1;
+
+    if (multigridArgs->fullMultigrid) {
+        maxChange = smoothLevel(
+            multigridArgs,
+            workerId,
+            coarsest,
+            COARSEST_SWEEPS
+        );
+
+        for (int level = coarsest - 1; level >= 0; level--) {
+            prolongLevel(multigridArgs, workerId, level, 0);
+
+            waitBarrier(&multigridArgs->barrier);
+
+            maxChange = runVCycle(multigridArgs, workerId, level);
+        }
+    } else {
+        maxChange = runVCycle(multigridArgs, workerId, 0);
+    }
+
+    while (1) {
+        multigridArgs->results[workerId].maxChange = maxChange;
+
+        waitBarrier(&multigridArgs->barrier);
+
+        if (maxWorkerChange(multigridArgs->results, multigridArgs->threads)
+            < multigridArgs->precision
+        ) {
+            break;
+        }
+
+        maxChange = runVCycle(multigridArgs, workerId, 0);
+        cycles++;
+    }
+
+    if (workerId == 0) {
+        multigridArgs->cycles = cycles;
+    }
+}
+
+/**
+ * Count the levels below a grid of the given dimension, down to one with a
+ * dimension of at most COARSEST_DIMENSION.
+ *
+ * @param  dimension The dimension of the full grid
+ *
+ * @return           The number of levels, including the full grid
+ */
+static int countLevels(const int dimension)
+{
+    int levels = 1;
+
+    for (int n = dimension; n > COARSEST_DIMENSION; n = n / 2 + 1) {
+        levels++;
+    }
+
+    return levels;
+}
+
+/**
+ * Give back the grids of all levels that were allocated. The full grid's
+ * values belong to the caller, so are not freed.
+ *
+ * @param options    Options controlling the solve (only context is used)
+ * @param levels     The levels
+ * @param levelCount The number of levels
+ */
+static void freeLevels(
+    const SolveOptions * const options,
+    Level * const levels,
+    const int levelCount
+)
+{
+    for (int i = 0; i < levelCount; i++) {
+        if (i > 0) {
+            releaseScratchGrid(options, levels[i].u);
+        }
+
+        releaseScratchGrid(options, levels[i].f);
+        releaseScratchGrid(options, levels[i].r);
+    }
+
+    free(levels);
+}
+
+/**
+ * Allocate the coarse levels below the given values. For full multigrid the
+ * edges of each coarse level are copied from the matching edge points of the
+ * level above (the nearest point, if it lies outside), so each level is a
+ * coarse version of the whole problem.
+ *
+ * @param  values     The full grid of values
+ * @param  levelCount The number of levels, including the full grid
+ * @param  options    Options controlling the solve (only context is used)
+ *
+ * @return            The levels, or NULL if out of memory
+ */
+static Level *createLevels(
+    Grid * const values,
+    const int levelCount,
+    const SolveOptions * const options
+)
+{
+    Level * const levels = calloc(levelCount, sizeof(Level));
+
+    if (!levels) {
+        return NULL;
+    }
+
+    levels[0].u = values;
+    levels[0].spacing2 = 1;
+
+    for (int i = 0; i < levelCount; i++) {
+        const int dimension = i == 0
+                              ? values->dimension
+                              : levels[i - 1].u->dimension / 2 + 1;
+
+        if (i > 0) {
+            levels[i].u = takeScratchGrid(options, dimension);
+            levels[i].f = takeScratchGrid(options, dimension);
+            levels[i].spacing2 = levels[i - 1].spacing2 * 4;
+        }
+
+        levels[i].r = takeScratchGrid(options, dimension);
+
+        if (!levels[i].u || (i > 0 && !levels[i].f) || !levels[i].r) {
+            freeLevels(options, levels, levelCount);
+
+            return NULL;
+        }
+
+        clearGrid(levels[i].r);
+
+        if (i == 0) {
+            continue;
+        }
+
+        clearGrid(levels[i].u);
+        clearGrid(levels[i].f);
+
+        const Grid * const fine = levels[i - 1].u;
+        Grid * const coarse = levels[i].u;
+        const int last = fine->dimension - 1;
+
+        for (int j = 0; j < dimension; j++) {
+            const int k = 2 * j < last ? 2 * j : last;
+
+            gridRow(coarse, 0)[j] = gridRow(fine, 0)[k];
+            gridRow(coarse, dimension - 1)[j] = gridRow(fine, last)[k];
+            gridRow(coarse, j)[0] = gridRow(fine, k)[0];
+            gridRow(coarse, j)[dimension - 1] = gridRow(fine, k)[last];
+        }
+    }
+
+    return levels;
+}
+
+/**
+ * Solve the given values array with SOLVE_METHOD_VCYCLE or SOLVE_METHOD_FMG,
+ * and update it to the solution. Stops after the first cycle whose last
+ * smoothing sweep of the full grid changes no point by at least the
+ * precision.
+ *
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  kernels The relaxation kernels to smooth the full grid with
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveMultigrid(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    SolveResult * const result
+)
+{
+    const int threads = options->threads;
+
+    int error;
+
+    MultigridArgs multigridArgs;
+    multigridArgs.levelCount = countLevels(values->dimension);
+    multigridArgs.levels = createLevels(
+        values,
+        multigridArgs.levelCount,
+        options
+    );
+    multigridArgs.kernels = kernels;
+    multigridArgs.precision = options->precision;
+    multigridArgs.threads = threads;
+    multigridArgs.fullMultigrid = options->method == SOLVE_METHOD_FMG;
+    multigridArgs.results = takeScratchResults(options);
+    multigridArgs.cycles = 0;
+
+    if (!multigridArgs.levels || !multigridArgs.results) {
+        if (multigridArgs.levels) {
+            freeLevels(
+                options,
+                multigridArgs.levels,
+                multigridArgs.levelCount
+            );
+        }
+
+        releaseScratchResults(options, multigridArgs.results);
+
+        return ENOMEM;
+    }
+
+    ThreadPool * const pool = createSolvePool(options, &error);
+
+    if (!error) {
+        error = initBarrier(
+            &multigridArgs.barrier,
+            threads,
+            options->spinCount
+        );
+
+        if (!error) {
+            runThreadPool(pool, runMultigrid, &multigridArgs);
+
+            destroyBarrier(&multigridArgs.barrier);
+        }
+
+        const int poolError = releaseSolvePool(options, pool);
+
+        if (!error) {
+            error = poolError;
+        }
+    }
+
+    result->iterations = multigridArgs.cycles;
+
+    if (!error) {
+        result->change = maxWorkerChange(multigridArgs.results, threads);
+    }
+
+    releaseScratchResults(options, multigridArgs.results);
+    freeLevels(options, multigridArgs.levels, multigridArgs.levelCount);
+
+    return error;
+}
@@ -0,0 +1,28 @@
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include "../array/array.h"
+#include "solve.h"
+#include "kernel.h"
+
+/**
+ * Solve the given values array with SOLVE_METHOD_VCYCLE or SOLVE_METHOD_FMG,
+ * and update it to the solution. Stops after the first cycle whose last
+ * smoothing sweep of the full grid changes no point by at least the
+ * precision.
+ *
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  kernels The relaxation kernels to smooth the full grid with
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveMultigrid(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    SolveResult * const result
+);
+
+#endif
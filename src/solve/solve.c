@@ -22,340 +22,1495 @@
  * likewise for all Os. This is the basis of the parallel algorithm; work on as
  * many points that are independent of one another as possible.
  *
- * Much of the complex logic is in finding out which point give to the next
- * thread to work on. See moveToNext function comment for further details on
- * this.
+ * The work is done by a pool of long-lived workers (see src/pool/pool.c), in
+ * one of two modes (see SolveMode in solve.h):
+ *
+ * In dispatch mode, each 'pass' over one colour of points is handed to the
+ * pool, and workers take batches of points of that colour (segments of a row)
+ * from a shared cursor until the pass is finished.
+ *
+ * In bands mode, the interior rows are split into one contiguous band per
+ * worker. Workers sweep all Es in their band, wait at a barrier, then sweep
+ * all Os, so the master thread is not involved at all until the end.
+ *
+ * In blocked mode, workers also own bands, but do several sweeps of their band
+ * between barriers so rows are reused while they are still in cache. See
+ * runBlocks for how this gives exactly the same result as bands mode.
+ *
+ * In both modes the averaging itself is done a row segment at a time by the
+ * (possibly vectorised) kernels in src/solve/kernel.c.
+ *
+ * If a checkpointer is given, every mode copies the values into its snapshot
+ * between sweeps (or blocks) when a checkpoint is due, and carries on while it
+ * is written (see src/checkpoint/checkpoint.c). In bands and blocked modes each
+ * worker copies its own band, so this is done in parallel too.
+ *
+ * In bands and blocked modes each worker is the first to touch its own band
+ * of any working copy of the grid (the split layout), so on NUMA systems the
+ * memory of each band is local to the worker that sweeps it. firstTouchGrid
+ * does the same for the input grid, before it is filled in.
+ *
+ * If statistics are asked for, every mode also times each half-sweep (or
+ * phase of a block) and how long each worker spends working and waiting,
+ * with only a couple of clock reads per worker per half-sweep.
  */
 
+#include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "../array/array.h"
+#include "../pool/pool.h"
+#include "../barrier/barrier.h"
 #include "../utility/utility.h"
+#include "solve.h"
+#include "kernel.h"
+#include "band.h"
+#include "context.h"
+#include "criterion.h"
+#include "multigrid.h"
+#include "cg.h"
+#include "jacobi.h"
+#include "solve3d.h"
+#include "mixed.h"
+
+// M_PI is not part of C99
+#define PI 3.14159265358979323846
 
-// struct to pass multiple arguments to thread callback function
+// Number of points handed to a worker at a time
+#define BATCH_SIZE 64
+
+// Smallest coarse grid SOLVE_WARM_START_COARSE solves. Below this, a grid is
+// solved from its values as given.
+#define WARM_START_MIN_DIMENSION 16
+
+// Cache size that a tile of rows in SOLVE_MODE_BLOCKED should fit in (a
+// typical per-core L2), used to pick sweeps per block with SOLVE_BLOCK_AUTO
+#define TILE_CACHE_SIZE (256 * 1024)
+
+// Most sweeps per block picked with SOLVE_BLOCK_AUTO. Up to this many - 1
+// sweeps are wasted once the values have converged.
+#define MAX_AUTO_BLOCK_SWEEPS 4
+
+// struct to pass multiple arguments to the pool task for a single 'pass'
 typedef struct {
-    double ** values; // The two dimensional array of values being solved
-    int row; // The row to update in the thread
-    int col; // The column to update in the thread
-    double precision; // The precision to work to
-    int * threadAvailableFlag; // Flag - is a given thread available
-    pthread_mutex_t * threadAvailableFlagLock; // Lock on availability flag to
-                                               // restrict concurrent access
-    int ** valuesSolvedArray; // Two dimensional array of flags that signal
-                              // which values have been solved
-    int valuesSolvedArrayDimension; // The dimension of valuesSolvedArray
-} ThreadArgs;
+    Grid * values; // The grid of values being solved
+    int dimension; // The dimension of the values grid
+    double precision; // The precision to hand to the kernels
+    double omega; // The relaxation factor
+    WorkerResult * results; // Changes seen by each worker this sweep
+    const RelaxKernels * kernels; // The relaxation kernels to use
+    SolveStats * stats; // Statistics to record, or NULL
+    int oddPointsFlag; // Flag - are we doing 'O' points in this pass
+    int sumSquares; // Flag - do the kernels sum the squares of the changes
+    pthread_mutex_t cursorLock; // Lock on the cursor (row, col)
+    int row; // The row of the next point to hand out
+    int col; // The column of the next point to hand out
+} PassArgs;
+
+// struct to pass multiple arguments to the pool task for firstTouchGrid
+typedef struct {
+    Grid * values; // The grid to touch
+    int threads; // The number of workers
+} TouchArgs;
+
+// struct to pass multiple arguments to the pool task for SOLVE_MODE_BANDS
+typedef struct {
+    Grid * values; // The grid of values being solved
+    int dimension; // The dimension of the values grid
+    SplitGrid * split; // The values in SOLVE_LAYOUT_SPLIT, or NULL
+    const RelaxKernels * kernels; // The relaxation kernels to use
+    double precision; // The precision to hand to the kernels
+    double omega; // The relaxation factor
+    Convergence convergence; // The convergence test, copied by each worker
+    int threads; // The number of workers
+    int bands; // The number of bands (workers with an ID >= this are idle)
+    int halfSweeps; // Half-sweeps per block in SOLVE_MODE_BLOCKED
+    Barrier barrier; // Barrier between 'E' and 'O' sweeps (or blocks)
+    WorkerResult * results; // Result of the last sweep for each worker
+    Checkpointer * checkpointer; // Checkpointer to copy values to, or NULL
+    int checkpointDue; // Flag - is a checkpoint due, set by worker 0
+    SolveStats * stats; // Statistics to record, or NULL
+    int sweeps; // Sweeps done, set by worker 0
+    double measure; // Measure of the criterion at the last test, set by
+                    // worker 0
+} BandArgs;
 
 /**
- * Sets the given square two dimensional array to the following style
- * (of given size):
- *    1 1 1 1 1
- *    1 0 0 0 1
- *    1 0 0 0 1
- *    1 0 0 0 1
- *    1 1 1 1 1
- *
- * That is, edges set to 1, and inner values set to 0. This array represents
- * which values have been solved in function solve, and hence needs to be reset
- * every time one of the values is updated. We can only say we are done when a
- * full pass of the values array in solve has been done without any values
- * being updated.
- *
- * @param valuesSolvedArray The two dimensional array to set to the above style
- * @param dimension   The dimension of the two dimensional array given
+ * Read the clock for statistics, if they are being recorded.
+ *
+ * @param  stats Statistics to record, or NULL
+ *
+ * @return       The monotonic time in seconds, or 0 if stats is NULL
  */
-static void resetSolvedArray(
-    int ** const valuesSolvedArray,
-    const int dimension
-) {
-    for(int row = 0; row < dimension; row++) {
-        for(int col = 0; col < dimension; col++) {
-            if (row == 0 || row == dimension - 1
-                || col == 0 || col == dimension - 1
-            ) {
-                valuesSolvedArray[row][col] = 1;
-
-                continue;
-            }
-            valuesSolvedArray[row][col] = 0;
+static double getStatsTime(const SolveStats * const stats)
+{
+    return stats ? getMonotonicTime() : 0;
+}
+
+/**
+ * Get the column of the first point of a given colour in a given row. Looking
+ * at the grids at the top of this file, 'E' points are in column 1 of odd
+ * rows and column 2 of even rows, and 'O' points the other way around. This
+ * does not depend on the dimension of the grid.
+ *
+ * @param  row           The row
+ * @param  oddPointsFlag 1 for 'O' points, 0 for 'E' points
+ *
+ * @return               The column of the first point (1 or 2)
+ */
+static int firstColumn(const int row, const int oddPointsFlag)
+{
+    return 2 - ((row + oddPointsFlag) & 1);
+}
+
+/**
+ * Hand out the next batch of (up to BATCH_SIZE) points in the current pass to
+ * a worker. A batch is always a segment of a single row, so it can be handed
+ * straight to the relaxation kernel. The shared cursor in passArgs is moved
+ * on to the first point of the next batch, which may be on the next row.
+ *
+ * @param  passArgs The shared state of the current pass
+ * @param  row      Set to the row of the batch
+ * @param  firstCol Set to the column of the first point in the batch
+ * @param  endCol   Set to one past the column of the last point in the batch
+ *
+ * @return          1 if a batch was handed out, 0 if the pass is finished
+ */
+static int takeBatch(
+    PassArgs * const passArgs,
+    int * const row,
+    int * const firstCol,
+    int * const endCol
+)
+{
+    const int dimension = passArgs->dimension;
+
+    int error = pthread_mutex_lock(&passArgs->cursorLock);
+
+    if (error) {
+        printf("Something went wrong in thread. Error code: %d\n", error);
+        exit(error);
+    }
+
+    if (passArgs->row >= dimension - 1) {
+        pthread_mutex_unlock(&passArgs->cursorLock);
+
+        return 0;
+    }
+
+    *row = passArgs->row;
+    *firstCol = passArgs->col;
+    *endCol = *firstCol + 2 * BATCH_SIZE;
+
+    if (*endCol >= dimension - 1) {
+        // Rest of this row, then move the cursor to the next one
+        *endCol = dimension - 1;
+
+        passArgs->row++;
+        passArgs->col = firstColumn(passArgs->row, passArgs->oddPointsFlag);
+    } else {
+        passArgs->col = *endCol;
+    }
+
+    pthread_mutex_unlock(&passArgs->cursorLock);
+
+    return 1;
+}
+
+/**
+ * Pool task for a single 'pass' of the values array. Each worker repeatedly
+ * takes a batch of points of the current colour and updates them (see
+ * RelaxRowFunction in kernel.h), until there are no points left in the pass.
+ * Each worker keeps track of the changes it has seen in the current pass in
+ * its own WorkerResult, so no shared state is written per point.
+ *
+ * @param workerId The ID of the worker
+ * @param args     PassArgs for the current pass
+ */
+static void runPass(const int workerId, void * const args)
+{
+    PassArgs * const passArgs = (PassArgs *) args;
+    Grid * const values = passArgs->values;
+    const double start = getStatsTime(passArgs->stats);
+
+    SweepNorms * const norms = &passArgs->results[workerId].norms;
+
+    // Kept locally so the shared result is only written once per pass
+    ChangeNorms changes = passArgs->oddPointsFlag ? norms->odd : norms->even;
+    double * const squares = passArgs->sumSquares ? &changes.squares : NULL;
+
+    int row, firstCol, endCol;
+
+    while (takeBatch(passArgs, &row, &firstCol, &endCol)) {
+        const double change = passArgs->kernels->relaxRow(
+            gridRow(values, row),
+            gridRow(values, row - 1),
+            gridRow(values, row + 1),
+            firstCol,
+            endCol,
+            passArgs->omega,
+            passArgs->precision,
+            squares
+        );
+
+        if (change > changes.max) {
+            changes.max = change;
         }
     }
+
+    if (passArgs->oddPointsFlag) {
+        norms->odd = changes;
+    } else {
+        norms->even = changes;
+    }
+
+    if (passArgs->stats) {
+        passArgs->stats->threadStats[workerId].busySeconds +=
+            getMonotonicTime() - start;
+    }
 }
 
 /**
- * Update row and col to point to the next point that should be calculated.
+ * Solve the given values array using SOLVE_MODE_DISPATCH. Each 'pass' over one
+ * colour of points is handed to the pool, and workers take batches of points
+ * until the pass is finished. Stops after the first tested sweep ('E' pass
+ * then 'O' pass) that meets the criterion (see src/solve/criterion.c).
  *
- * This is complicated as the position of the next point (when moving to the
- * next row) depends on the dimension of the given input array. Below shows
- * an example of both an odd and even dimension grid.
+ * @param  values    The grid of values to solve and update to the solution
+ * @param  options   Options controlling the solve (threads, precision etc.)
+ * @param  kernels   The relaxation kernels to use
+ * @param  reference The root mean square residual of the grid before the
+ *                   solve, for SOLVE_CRITERION_RELATIVE
+ * @param  result    Set to information about the solve (iterations etc.)
  *
- *   X X X X X          X X X X X X
- *   X E O E X          X E O E O X
- *   X O E O X    AND   X O E O E X
- *   X E O E X          X E O E O X
- *   X X X X X          X O E O E X
- *                      X X X X X X
+ * @return           0 on success, or an error code otherwise
+ */
+static int solveDispatch(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    const double reference,
+    SolveResult * const result
+)
+{
+    const int dimension = values->dimension;
+
+    // To check return codes of pthread functions
+    int error;
+
+    // Long-lived workers, created once for the whole solve
+    ThreadPool * const pool = createSolvePool(options, &error);
+
+    if (error) {
+        return error;
+    }
+
+    Convergence convergence;
+    initConvergence(&convergence, options, dimension, 1, reference);
+
+    PassArgs passArgs;
+    passArgs.values = values;
+    passArgs.dimension = dimension;
+    passArgs.precision = getKernelPrecision(options);
+    passArgs.omega = options->omega;
+    passArgs.kernels = kernels;
+    passArgs.stats = options->stats;
+
+    error = pthread_mutex_init(&passArgs.cursorLock, NULL);
+
+    if (error) {
+        releaseSolvePool(options, pool);
+
+        return error;
+    }
+
+    passArgs.results = takeScratchResults(options);
+
+    if (!passArgs.results) {
+        error = ENOMEM;
+    }
+
+    int solved = 0;
+    int sweeps = 0;
+
+    // Time of each pass of the current sweep, and of all passes
+    double passSeconds[2];
+    double totalPassSeconds = 0;
+
+    for (int i = 0; passArgs.results && i < options->threads; i++) {
+        passArgs.results[i].norms.odd.max = 0;
+        passArgs.results[i].norms.odd.squares = 0;
+    }
+
+    while (!solved && !error) {
+        const int tested = isCheckDue(&convergence, sweeps + 1, 1);
+        const int nextTested = isCheckDue(&convergence, sweeps + 2, 1);
+
+        for (int i = 0; i < options->threads; i++) {
+            startSweepNorms(&passArgs.results[i].norms);
+        }
+
+        // 'E' points, then 'O' points
+        for (int oddPointsFlag = 0; oddPointsFlag <= 1; oddPointsFlag++) {
+            const double start = getStatsTime(options->stats);
+
+            // start at row 1 as edges are fixed.
+            passArgs.oddPointsFlag = oddPointsFlag;
+            passArgs.sumSquares = needsSquares(
+                &convergence,
+                tested,
+                nextTested,
+                oddPointsFlag
+            );
+            passArgs.row = 1;
+            passArgs.col = firstColumn(1, oddPointsFlag);
+
+            // Blocks until every worker has finished the pass, as we cannot do
+            // some 'E's and 'O's at the same time (see top of file comment for
+            // info on what an 'E' and an 'O' is)
+            runThreadPool(pool, runPass, &passArgs);
+
+            passSeconds[oddPointsFlag] = getStatsTime(options->stats) - start;
+            totalPassSeconds += passSeconds[oddPointsFlag];
+        }
+
+        SweepNorms norms;
+        sumWorkerNorms(passArgs.results, options->threads, &norms);
+
+        result->change = getSweepChange(&norms);
+        solved = tested && testConvergence(&convergence, &norms);
+
+        sweeps++;
+        result->iterations++;
+
+        if (options->stats) {
+            recordSweep(
+                options->stats,
+                result->iterations,
+                result->change,
+                passSeconds[0],
+                passSeconds[1]
+            );
+        }
+
+        if (!solved
+            && options->checkpointer
+            && isCheckpointDue(options->checkpointer)
+        ) {
+            copyGrid(getCheckpointGrid(options->checkpointer), values);
+            commitCheckpoint(
+                options->checkpointer,
+                result->iterations,
+                result->change
+            );
+        }
+    }
+
+    // Workers wait for the pool whenever they are not working on a pass
+    for (int i = 0; options->stats && i < options->threads; i++) {
+        ThreadStats * const thread = &options->stats->threadStats[i];
+
+        thread->waitSeconds += totalPassSeconds - thread->busySeconds;
+    }
+
+    result->measure = convergence.measure;
+
+    releaseScratchResults(options, passArgs.results);
+    pthread_mutex_destroy(&passArgs.cursorLock);
+
+    const int poolError = releaseSolvePool(options, pool);
+
+    return error ? error : poolError;
+}
+
+/**
+ * Update all points of one colour in a band of rows. Each point is set to the
+ * average of its four neighbours if it changes by at least the precision (see
+ * RelaxRowFunction in kernel.h).
  *
- * If the current point is second or third last point, we know that we should
- * move to the next row. We always move two spaces at a time (see grids above)
- * and the edges of the grid are fixed. The column we start at on the next row
- * depends on the current column and the dimension of the grid.
+ * @param  values        The grid of values being solved
+ * @param  kernels       The relaxation kernels to use
+ * @param  rowStart      The first row of the band
+ * @param  rowEnd        One past the last row of the band
+ * @param  oddPointsFlag 1 to update 'O' points, 0 to update 'E' points
+ * @param  omega         The relaxation factor
+ * @param  precision     The precision to compare the change against
+ * @param  squares       If not NULL, increased by the sum of the squares of
+ *                       the changes
  *
- * @param row       The row of the current point, to be updated to row of next
- *                  point. May not change
- * @param col       The column of the current point, to be updated to the
- *                  column of the next point
- * @param dimension The dimension of the two dimensional array we are solving
+ * @return               The largest change of any point in the band
  */
-static void moveToNext(int * const row, int * const col, const int dimension)
+static double relaxBand(
+    Grid * const values,
+    const RelaxKernels * const kernels,
+    const int rowStart,
+    const int rowEnd,
+    const int oddPointsFlag,
+    const double omega,
+    const double precision,
+    double * const squares
+)
 {
-    if (*col == dimension - 2) {
-        // if even dimension, start at first column, otherwise start at second
-        *col = isEven(dimension) ? 1 : 2;
-        *row += 1;
+    double maxChange = 0;
+
+    for (int row = rowStart; row < rowEnd; row++) {
+        const double change = kernels->relaxRow(
+            gridRow(values, row),
+            gridRow(values, row - 1),
+            gridRow(values, row + 1),
+            firstColumn(row, oddPointsFlag),
+            values->dimension - 1,
+            omega,
+            precision,
+            squares
+        );
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+    }
+
+    return maxChange;
+}
+
+/**
+ * The same as relaxBand, but for a grid stored as a SplitGrid. For a point
+ * (row, col) stored at index k = col / 2, its left and right neighbours are
+ * at indices k - 1 + s and k + s of the other colour in the same row, where
+ * s = col % 2, and its upper and lower neighbours are at index k of the other
+ * colour in the rows above and below. Since s is fixed for a given row and
+ * colour, every half-sweep reads and writes with unit stride. The four
+ * neighbours are added in the same order as relaxBand, so results are
+ * identical.
+ *
+ * @param  split         The split grid of values being solved
+ * @param  kernels       The relaxation kernels to use
+ * @param  rowStart      The first row of the band
+ * @param  rowEnd        One past the last row of the band
+ * @param  oddPointsFlag 1 to update 'O' points, 0 to update 'E' points
+ * @param  omega         The relaxation factor
+ * @param  precision     The precision to compare the change against
+ * @param  squares       If not NULL, increased by the sum of the squares of
+ *                       the changes
+ *
+ * @return               The largest change of any point in the band
+ */
+static double relaxBandSplit(
+    SplitGrid * const split,
+    const RelaxKernels * const kernels,
+    const int rowStart,
+    const int rowEnd,
+    const int oddPointsFlag,
+    const double omega,
+    const double precision,
+    double * const squares
+)
+{
+    const int dimension = split->dimension;
+    const int otherFlag = !oddPointsFlag;
+
+    double maxChange = 0;
 
+    for (int row = rowStart; row < rowEnd; row++) {
+        // Column of the first point of this colour, and so s (see above)
+        const int firstCol = firstColumn(row, oddPointsFlag);
+        const int s = firstCol & 1;
+        const int firstK = firstCol / 2;
+
+        // Number of points of this colour in the row, excluding edges
+        const int count = (dimension - firstCol) / 2;
+
+        const double change = kernels->relaxSplitRow(
+            splitGridRow(split, oddPointsFlag, row) + firstK,
+            splitGridRow(split, otherFlag, row) + firstK - 1 + s,
+            splitGridRow(split, otherFlag, row - 1) + firstK,
+            splitGridRow(split, otherFlag, row + 1) + firstK,
+            count,
+            omega,
+            precision,
+            squares
+        );
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+    }
+
+    return maxChange;
+}
+
+/**
+ * Relax all points of one colour in a band of rows, using whichever layout
+ * the grid is stored in.
+ *
+ * @param  bandArgs      BandArgs shared by all workers
+ * @param  rowStart      The first row of the band
+ * @param  rowEnd        One past the last row of the band
+ * @param  oddPointsFlag 1 to update 'O' points, 0 to update 'E' points
+ * @param  squares       If not NULL, increased by the sum of the squares of
+ *                       the changes
+ *
+ * @return               The largest change of any point in the band
+ */
+static double relaxBandAnyLayout(
+    BandArgs * const bandArgs,
+    const int rowStart,
+    const int rowEnd,
+    const int oddPointsFlag,
+    double * const squares
+)
+{
+    if (bandArgs->split) {
+        return relaxBandSplit(
+            bandArgs->split,
+            bandArgs->kernels,
+            rowStart,
+            rowEnd,
+            oddPointsFlag,
+            bandArgs->omega,
+            bandArgs->precision,
+            squares
+        );
+    }
+
+    return relaxBand(
+        bandArgs->values,
+        bandArgs->kernels,
+        rowStart,
+        rowEnd,
+        oddPointsFlag,
+        bandArgs->omega,
+        bandArgs->precision,
+        squares
+    );
+}
+
+/**
+ * Get the largest change of any point in the last sweep (or block) of
+ * SOLVE_MODE_BANDS or SOLVE_MODE_BLOCKED, from the per-worker results.
+ *
+ * @param  bandArgs BandArgs shared by all workers
+ *
+ * @return          The largest change
+ */
+static double getBandChange(const BandArgs * const bandArgs)
+{
+    SweepNorms norms;
+    sumWorkerNorms(bandArgs->results, bandArgs->threads, &norms);
+
+    return getSweepChange(&norms);
+}
+
+/**
+ * Check, in worker 0 only, whether a checkpoint is due. Must be called before
+ * the barrier that ends a sweep (or block), so every worker sees the same
+ * answer after it (see takeBandCheckpoint).
+ *
+ * @param bandArgs BandArgs shared by all workers
+ * @param workerId The ID of the worker
+ */
+static void checkCheckpointDue(BandArgs * const bandArgs, const int workerId)
+{
+    if (workerId == 0 && bandArgs->checkpointer) {
+        bandArgs->checkpointDue = isCheckpointDue(bandArgs->checkpointer);
+    }
+}
+
+/**
+ * Take a checkpoint if one is due, after the barrier that ends a sweep (or
+ * block). Every worker copies its own band into the snapshot, then once all
+ * have, worker 0 hands it to the checkpointer. The flag cannot change before
+ * every worker has read it, as worker 0 only sets it again before the barrier
+ * that ends the next sweep.
+ *
+ * @param bandArgs BandArgs shared by all workers
+ * @param workerId The ID of the worker
+ * @param rowStart The first row of the band of the worker
+ * @param rowEnd   One past the last row of the band of the worker
+ * @param sweeps   Sweeps done so far
+ */
+static void takeBandCheckpoint(
+    BandArgs * const bandArgs,
+    const int workerId,
+    const int rowStart,
+    const int rowEnd,
+    const int sweeps
+)
+{
+    if (!bandArgs->checkpointer || !bandArgs->checkpointDue) {
         return;
     }
 
-    if (*col == dimension - 3) {
-        // if even dimension, start at second column, otherwise start at first
-        *col = isEven(dimension) ? 2 : 1;
-        *row += 1;
+    Grid * const snapshot = getCheckpointGrid(bandArgs->checkpointer);
+
+    if (bandArgs->split) {
+        joinSplitGridRows(snapshot, bandArgs->split, rowStart, rowEnd);
+    } else {
+        copyGridRows(snapshot, bandArgs->values, rowStart, rowEnd);
+    }
+
+    waitBarrier(&bandArgs->barrier);
 
+    if (workerId == 0) {
+        commitCheckpoint(
+            bandArgs->checkpointer,
+            sweeps,
+            getBandChange(bandArgs)
+        );
+    }
+}
+
+/**
+ * Record the times of one step (a sweep, or a block) of a worker in the
+ * statistics, if they are being recorded. The step is made up of two halves,
+ * each some work followed by a barrier. Worker 0 also adds the step to the
+ * trace, before any worker can write its result for the next step.
+ *
+ * @param bandArgs BandArgs shared by all workers
+ * @param workerId The ID of the worker
+ * @param times    When the worker started the step, finished the work of
+ *                 the first half, passed its barrier, finished the work of
+ *                 the second half, and passed its barrier
+ * @param sweeps   Sweeps done by the end of the step
+ */
+static void recordBandStep(
+    BandArgs * const bandArgs,
+    const int workerId,
+    const double * const times,
+    const int sweeps
+)
+{
+    SolveStats * const stats = bandArgs->stats;
+
+    if (!stats) {
         return;
     }
 
-    *col += 2;
+    ThreadStats * const thread = &stats->threadStats[workerId];
 
-    return;
+    thread->busySeconds += (times[1] - times[0]) + (times[3] - times[2]);
+    thread->waitSeconds += (times[2] - times[1]) + (times[4] - times[3]);
+
+    if (workerId == 0) {
+        recordSweep(
+            stats,
+            sweeps,
+            getBandChange(bandArgs),
+            times[2] - times[0],
+            times[4] - times[2]
+        );
+    }
 }
 
 /**
- * Move to the next 'pass' of the values array. Reset the indices to the first
- * point to calculate, and update the oddPointsFlag to signal that we are doing
- * different points in the next pass.
+ * Copy the band of rows of a worker, including the edge rows next to it,
+ * between the grid and the split grid, in the direction given. Each worker
+ * doing this for its own band first touches the split grid in parallel.
  *
- * @param oddPointsFlag The flag signalling if we are doing 'odd' points
- * @param row           The row index to reset
- * @param col           The column index to reset
+ * @param bandArgs BandArgs shared by all workers
+ * @param workerId The ID of the worker
+ * @param join     1 to copy the split grid to the grid, 0 the other way
  */
-static void moveToNextPass(
-    int * const oddPointsFlag,
-    int * const row,
-    int * const col
+static void copySplitBand(
+    BandArgs * const bandArgs,
+    const int workerId,
+    const int join
 )
 {
-    // Do different points next time
-    *oddPointsFlag = *oddPointsFlag ? 0 : 1;
+    if (workerId >= bandArgs->bands) {
+        return;
+    }
 
-    // Reset indices for next 'pass'
-    *row = 1;
-    *col = *oddPointsFlag ? 2 : 1;
+    int rowStart, rowEnd;
+    getBandWithEdges(
+        workerId,
+        bandArgs->bands,
+        bandArgs->dimension,
+        &rowStart,
+        &rowEnd
+    );
+
+    if (join) {
+        joinSplitGridRows(bandArgs->values, bandArgs->split, rowStart, rowEnd);
+    } else {
+        splitGridRows(bandArgs->split, bandArgs->values, rowStart, rowEnd);
+    }
 }
 
 /**
- * Check if a point is that last 'even' point to be calculated (see comment at
- * top of this file for definition of what an even/E point is). That is, the
- * bottom right corner of the grid (excluding the fixed edge points).
+ * Pool task for SOLVE_MODE_BANDS. Every worker sweeps all 'E' points in its
+ * band, waits for all other workers, then sweeps all 'O' points. Each worker
+ * records the changes in its band in the sweep, and after a second barrier
+ * every worker reads all of them to decide (identically, with its own copy of
+ * the convergence test) whether to stop. Only two barriers per sweep are
+ * needed: a worker cannot overwrite its result for the next sweep until it
+ * has passed the first barrier of that sweep, which all workers only reach
+ * after reading the results of this sweep.
  *
- * @param  row       The row of the point
- * @param  col       The column of the point
- * @param  dimension The dimension of the two dimensional array we are solving
+ * @param workerId The ID of the worker
+ * @param args     BandArgs shared by all workers
+ */
+static void runBands(const int workerId, void * const args)
+{
+    BandArgs * const bandArgs = (BandArgs *) args;
+
+    int rowStart, rowEnd;
+    getBand(
+        workerId,
+        bandArgs->bands,
+        bandArgs->dimension,
+        &rowStart,
+        &rowEnd
+    );
+
+    Convergence convergence = bandArgs->convergence;
+
+    int solved = 0;
+    int sweeps = 0;
+
+    // Kept locally until the first barrier, as others may still read the
+    // result of the last sweep before then
+    SweepNorms norms = {{0, 0}, {0, 0}, {0, 0}};
+
+    // Times through the sweep, see recordBandStep
+    double times[5];
+
+    if (bandArgs->split) {
+        copySplitBand(bandArgs, workerId, 0);
+        waitBarrier(&bandArgs->barrier);
+    }
+
+    while (!solved) {
+        const int tested = isCheckDue(&convergence, sweeps + 1, 1);
+        const int nextTested = isCheckDue(&convergence, sweeps + 2, 1);
+
+        startSweepNorms(&norms);
+
+        times[0] = getStatsTime(bandArgs->stats);
+
+        norms.even.max = relaxBandAnyLayout(
+            bandArgs,
+            rowStart,
+            rowEnd,
+            0,
+            needsSquares(&convergence, tested, nextTested, 0)
+            ? &norms.even.squares
+            : NULL
+        );
+
+        times[1] = getStatsTime(bandArgs->stats);
+
+        waitBarrier(&bandArgs->barrier);
+
+        times[2] = getStatsTime(bandArgs->stats);
+
+        norms.odd.max = relaxBandAnyLayout(
+            bandArgs,
+            rowStart,
+            rowEnd,
+            1,
+            needsSquares(&convergence, tested, nextTested, 1)
+            ? &norms.odd.squares
+            : NULL
+        );
+
+        bandArgs->results[workerId].norms = norms;
+        checkCheckpointDue(bandArgs, workerId);
+
+        times[3] = getStatsTime(bandArgs->stats);
+
+        waitBarrier(&bandArgs->barrier);
+
+        times[4] = getStatsTime(bandArgs->stats);
+
+        if (tested) {
+            SweepNorms total;
+            sumWorkerNorms(bandArgs->results, bandArgs->threads, &total);
+
+            solved = testConvergence(&convergence, &total);
+        }
+
+        sweeps++;
+
+        recordBandStep(bandArgs, workerId, times, sweeps);
+
+        if (!solved) {
+            takeBandCheckpoint(bandArgs, workerId, rowStart, rowEnd, sweeps);
+        }
+    }
+
+    if (bandArgs->split) {
+        copySplitBand(bandArgs, workerId, 1);
+    }
+
+    if (workerId == 0) {
+        bandArgs->sweeps = sweeps;
+        bandArgs->measure = convergence.measure;
+    }
+}
+
+/**
+ * Do half-sweep h of a block on some rows for runBlocks, and record the
+ * changes if it is one of the last three half-sweeps of the block.
  *
- * @return           1 if last even point, 0 otherwise
+ * @param bandArgs    BandArgs shared by all workers
+ * @param rowStart    The first row
+ * @param rowEnd      One past the last row
+ * @param h           The half-sweep of the block
+ * @param last        Changes in the last three half-sweeps, by h - (H - 3)
+ * @param lastSquares Flags - are the squares needed from each of them
  */
-static int isLastEvenPoint(const int row, const int col, const int dimension)
+static void relaxBlockRows(
+    BandArgs * const bandArgs,
+    const int rowStart,
+    const int rowEnd,
+    const int h,
+    ChangeNorms * const last,
+    const int * const lastSquares
+)
 {
-    return (row == dimension - 2) && (col == dimension - 2);
+    const int index = h - (bandArgs->halfSweeps - 3);
+
+    if (index < 0) {
+        relaxBandAnyLayout(bandArgs, rowStart, rowEnd, h & 1, NULL);
+
+        return;
+    }
+
+    const double change = relaxBandAnyLayout(
+        bandArgs,
+        rowStart,
+        rowEnd,
+        h & 1,
+        lastSquares[index] ? &last[index].squares : NULL
+    );
+
+    if (change > last[index].max) {
+        last[index].max = change;
+    }
 }
 
 /**
- * Check if a point is that last 'odd' point to be calculated (see comment at
- * top of this file for definition of what an odd/O point is). That is, one
- * column before the bottom right corner of the grid (excluding the fixed edge
- * points).
+ * Pool task for SOLVE_MODE_BLOCKED. Number the half-sweeps in a block
+ * h = 0, 1, ..., H - 1, where even h are 'E' half-sweeps and odd h are 'O'.
+ * Half-sweep h of row r only reads the other colour in rows r - 1 to r + 1,
+ * so it can be done as soon as half-sweep h - 1 has been done on those rows,
+ * as long as half-sweep h + 1 has not yet been done on them. Any order of
+ * (h, row) steps that respects this gives exactly the same values as H
+ * half-sweeps of the whole grid.
+ *
+ * Each block is done in two phases, with a barrier after each:
  *
- * @param  row       The row of the point
- * @param  col       The column of the point
- * @param  dimension The dimension of the two dimensional array we are solving
+ *   1. Each worker does half-sweep h on rows [rowStart + h, rowEnd - h) of
+ *      its band (a trapezoid in (h, row) space, not shrunk at the fixed
+ *      edges of the grid), which only needs rows inside the band. The rows
+ *      are visited as a skewed wavefront - half-sweep h of row j - h for
+ *      h = 0 ... H - 1, then moving on to j + 1 - so only about H + 2 rows
+ *      are in use at a time and stay in cache for all H half-sweeps.
  *
- * @return           1 if last odd point, 0 otherwise
+ *   2. Each worker fills in the inverted triangle left between its band and
+ *      the next, doing half-sweep h on rows [rowEnd - h, rowEnd + h) in order
+ *      of h. Bands are at least 2 * (H - 1) rows (see solveBands), so the
+ *      triangles of neighbouring boundaries never overlap.
+ *
+ * Only the changes in the last sweep of each block (and the 'O' half-sweep
+ * before it, for the residual) are recorded, and the criterion is tested at
+ * the end of a block. With SOLVE_CRITERION_CHANGE, a sweep in which no point
+ * changes by at least the precision does not write anything, so every later
+ * sweep is the same, and stopping at the end of the block gives exactly the
+ * same result as stopping straight after that sweep. With the other criteria
+ * every point is always written, so up to H / 2 - 1 more sweeps than
+ * SOLVE_MODE_BANDS would do may be done.
+ *
+ * @param workerId The ID of the worker
+ * @param args     BandArgs shared by all workers
  */
-static int isLastOddPoint(const int row, const int col, const int dimension)
+static void runBlocks(const int workerId, void * const args)
 {
-    return (row == dimension - 2) && (col == dimension - 3);
+    BandArgs * const bandArgs = (BandArgs *) args;
+    const int halfSweeps = bandArgs->halfSweeps;
+
+    // Workers without a band still have to take part in every barrier
+    const int hasBand = workerId < bandArgs->bands;
+    const int firstBand = workerId == 0;
+    const int lastBand = workerId == bandArgs->bands - 1;
+
+    int rowStart = 0, rowEnd = 0;
+
+    if (hasBand) {
+        getBand(
+            workerId,
+            bandArgs->bands,
+            bandArgs->dimension,
+            &rowStart,
+            &rowEnd
+        );
+    }
+
+    Convergence convergence = bandArgs->convergence;
+    const int blockSweeps = halfSweeps / 2;
+
+    int solved = 0;
+    int sweeps = 0;
+
+    // Kept locally until the first barrier, see runBands
+    SweepNorms norms = {{0, 0}, {0, 0}, {0, 0}};
+
+    // Times through the block, see recordBandStep
+    double times[5];
+
+    if (bandArgs->split) {
+        copySplitBand(bandArgs, workerId, 0);
+        waitBarrier(&bandArgs->barrier);
+    }
+
+    while (!solved) {
+        const int tested = isCheckDue(
+            &convergence,
+            sweeps + blockSweeps,
+            blockSweeps
+        );
+
+        // With one sweep per block, the 'O' half-sweep before the last one
+        // is in the block before
+        const int nextTested = blockSweeps == 1
+                               && isCheckDue(&convergence, sweeps + 2, 1);
+
+        // Changes in the last three half-sweeps, by h - (H - 3), and the
+        // squares needed from each
+        ChangeNorms last[3] = {{0, 0}, {0, 0}, {0, 0}};
+        const int lastSquares[3] = {
+            needsSquares(&convergence, 0, tested, 1),
+            needsSquares(&convergence, tested, 0, 0),
+            needsSquares(&convergence, tested, nextTested, 1)
+        };
+
+        times[0] = getStatsTime(bandArgs->stats);
+
+        // Phase 1: trapezoid of the band, as a wavefront
+        for (int j = rowStart; hasBand && j < rowEnd + halfSweeps - 1; j++) {
+            for (int h = 0; h < halfSweeps; h++) {
+                const int row = j - h;
+
+                if (row < (firstBand ? rowStart : rowStart + h)
+                    || row >= (lastBand ? rowEnd : rowEnd - h)
+                ) {
+                    continue;
+                }
+
+                relaxBlockRows(bandArgs, row, row + 1, h, last, lastSquares);
+            }
+        }
+
+        times[1] = getStatsTime(bandArgs->stats);
+
+        waitBarrier(&bandArgs->barrier);
+
+        times[2] = getStatsTime(bandArgs->stats);
+
+        // Phase 2: triangle between this band and the next
+        for (int h = 1; hasBand && !lastBand && h < halfSweeps; h++) {
+            relaxBlockRows(
+                bandArgs,
+                rowEnd - h,
+                rowEnd + h,
+                h,
+                last,
+                lastSquares
+            );
+        }
+
+        norms.previousOdd = halfSweeps > 2 ? last[0] : norms.odd;
+        norms.even = last[1];
+        norms.odd = last[2];
+
+        bandArgs->results[workerId].norms = norms;
+        checkCheckpointDue(bandArgs, workerId);
+
+        times[3] = getStatsTime(bandArgs->stats);
+
+        waitBarrier(&bandArgs->barrier);
+
+        times[4] = getStatsTime(bandArgs->stats);
+
+        if (tested) {
+            SweepNorms total;
+            sumWorkerNorms(bandArgs->results, bandArgs->threads, &total);
+
+            solved = testConvergence(&convergence, &total);
+        }
+
+        sweeps += blockSweeps;
+
+        recordBandStep(bandArgs, workerId, times, sweeps);
+
+        if (!solved) {
+            takeBandCheckpoint(bandArgs, workerId, rowStart, rowEnd, sweeps);
+        }
+    }
+
+    if (bandArgs->split) {
+        copySplitBand(bandArgs, workerId, 1);
+    }
+
+    if (workerId == 0) {
+        bandArgs->sweeps = sweeps;
+        bandArgs->measure = convergence.measure;
+    }
 }
 
 /**
- * Runs processes required to end a thread. Updates the flag given to signal
- * that the current thread id has finished and is now (or about to be)
- * available to be used for a new thread. Gains and releases a lock as this
- * flag is updated elsewhere to be 0, so locks must be used for concurrency.
+ * Work out how many sweeps to do per block in SOLVE_MODE_BLOCKED. With
+ * SOLVE_BLOCK_AUTO, as many as keep the H + 2 rows of the wavefront (see
+ * runBlocks) within TILE_CACHE_SIZE, up to MAX_AUTO_BLOCK_SWEEPS.
  *
+ * @param  values  The grid of values being solved
+ * @param  options Options controlling the solve
  *
- * @param  threadAvailableFlag     The flag to update
- * @param  threadAvailableFlagLock The lock on the flag to update
+ * @return         The number of sweeps per block (at least 1)
+ */
+static int getBlockSweeps(
+    const Grid * const values,
+    const SolveOptions * const options
+)
+{
+    if (options->blockSweeps != SOLVE_BLOCK_AUTO) {
+        return options->blockSweeps;
+    }
+
+    const int rowsInCache = TILE_CACHE_SIZE
+                            / (int)(values->stride * sizeof(double));
+    const int sweeps = (rowsInCache - 2) / 2;
+
+    if (sweeps < 1) {
+        return 1;
+    }
+
+    return sweeps < MAX_AUTO_BLOCK_SWEEPS ? sweeps : MAX_AUTO_BLOCK_SWEEPS;
+}
+
+/**
+ * Solve the given values array using SOLVE_MODE_BANDS or SOLVE_MODE_BLOCKED.
+ * The whole solve is a single pool task, see runBands and runBlocks. In
+ * SOLVE_LAYOUT_SPLIT the values are copied into a SplitGrid first and copied
+ * back at the end, by each worker for its own band.
+ *
+ * @param  values    The grid of values to solve and update to the solution
+ * @param  options   Options controlling the solve (threads, precision etc.)
+ * @param  kernels   The relaxation kernels to use
+ * @param  reference The root mean square residual of the grid before the
+ *                   solve, for SOLVE_CRITERION_RELATIVE
+ * @param  result    Set to information about the solve (iterations etc.)
  *
- * @return                         NULL
+ * @return           0 on success, or an error code otherwise
  */
-static void *endThread(
-    int * const threadAvailableFlag,
-    pthread_mutex_t * const threadAvailableFlagLock
+static int solveBands(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    const double reference,
+    SolveResult * const result
 )
 {
+    const int threads = options->threads;
+
     int error;
 
-    error = pthread_mutex_lock(threadAvailableFlagLock);
+    SplitGrid * split = NULL;
+
+    if (options->layout == SOLVE_LAYOUT_SPLIT) {
+        split = takeScratchSplitGrid(options, values->dimension);
+
+        if (!split) {
+            return ENOMEM;
+        }
+    }
+
+    ThreadPool * const pool = createSolvePool(options, &error);
 
     if (error) {
-        printf("Something went wrong in thread. Error code: %d\n", error);
-        exit(error);
+        releaseScratchSplitGrid(options, split);
+
+        return error;
     }
 
-    *threadAvailableFlag = 1;
+    BandArgs bandArgs;
+    bandArgs.values = values;
+    bandArgs.dimension = values->dimension;
+    bandArgs.split = split;
+    bandArgs.kernels = kernels;
+    bandArgs.precision = getKernelPrecision(options);
+    bandArgs.omega = options->omega;
+    bandArgs.threads = threads;
+    bandArgs.bands = threads;
+    bandArgs.halfSweeps = 2;
+    bandArgs.results = takeScratchResults(options);
+    bandArgs.checkpointer = options->checkpointer;
+    bandArgs.checkpointDue = 0;
+    bandArgs.stats = options->stats;
+    bandArgs.sweeps = 0;
+    bandArgs.measure = 0;
 
-    error = pthread_mutex_unlock(threadAvailableFlagLock);
+    initConvergence(
+        &bandArgs.convergence,
+        options,
+        values->dimension,
+        1,
+        reference
+    );
 
-    if (error) {
-        printf("Something went wrong in thread. Error code: %d\n", error);
-        exit(error);
+    PoolTask task = runBands;
+
+    if (options->mode == SOLVE_MODE_BLOCKED) {
+        const int interiorRows = values->dimension > 2
+                                 ? values->dimension - 2
+                                 : 0;
+
+        // Bands must be at least 2 * (H - 1) rows (see runBlocks), so use
+        // fewer sweeps per block, and if need be fewer bands, on small grids
+        if (interiorRows / threads < 2) {
+            bandArgs.bands = interiorRows / 2 > 1 ? interiorRows / 2 : 1;
+        }
+
+        int sweeps = getBlockSweeps(values, options);
+
+        while (bandArgs.bands > 1
+               && sweeps > 1
+               && interiorRows / bandArgs.bands < 4 * sweeps - 2
+        ) {
+            sweeps--;
+        }
+
+        bandArgs.halfSweeps = 2 * sweeps;
+        task = runBlocks;
+    }
+
+    error = bandArgs.results
+            ? initBarrier(&bandArgs.barrier, threads, options->spinCount)
+            : ENOMEM;
+
+    if (!error) {
+        runThreadPool(pool, task, &bandArgs);
+
+        destroyBarrier(&bandArgs.barrier);
     }
 
-    return NULL;
+    result->iterations = bandArgs.sweeps;
+
+    if (!error) {
+        result->change = getBandChange(&bandArgs);
+        result->measure = bandArgs.measure;
+    }
+
+    releaseScratchResults(options, bandArgs.results);
+    releaseScratchSplitGrid(options, split);
+
+    const int poolError = releaseSolvePool(options, pool);
+
+    return error ? error : poolError;
 }
 
 /**
- * Main callback function for each parallel thread. Updates a specific value to
- * the average of its four neighbours if it changes by more than the given
- * precision. If this happens, it resets the valuesSolvedArray, as we cannot
- * assume any pre calculated values are 'solved' if a value is updated. If the
- * value changes by less than the precision, we can (for now) view it as
- * solved, and therefore update the corresponding point in the
- * valuesSolvedArray to 1.
- *
- * @param  values                     The two dimensional array of values being
- *                                    solved
- * @param  row                        The row of the point to update
- * @param  col                        The column of the point to update
- * @param  precision                  The precision to compare the change
- *                                    against
- * @param  threadAvailableFlag        The flag to update when thread has
- *                                    finished
- * @param  threadAvailableFlagLock    The lock on the flag to update when
- *                                    thread has finished
- * @param  valuesSolvedArray          Two dimensional array of flags that
- *                                    signal which values have been solved
- * @param  valuesSolvedArrayDimension The dimension of valuesSolvedArray
- *
- * @return                            NULL
+ * Work out the optimal relaxation factor for red-black SOR on a grid of the
+ * given dimension. For Laplace's equation on a square with fixed edges and
+ * n = dimension - 1 intervals, the spectral radius of the Jacobi iteration
+ * is cos(pi / n), which gives omega = 2 / (1 + sin(pi / n)). The same holds
+ * for a cube, where it is the average of three such cosines. This depends
+ * only on the grid, not on the values, so there is no need to estimate it
+ * from early sweeps.
+ *
+ * @param  dimension The dimension of the grid
+ *
+ * @return           The optimal relaxation factor
  */
-static void *updateValue(
-    double ** const values,
-    const int row,
-    const int col,
-    const double precision,
-    int * const threadAvailableFlag,
-    pthread_mutex_t * const threadAvailableFlagLock,
-    int ** const valuesSolvedArray,
-    const int valuesSolvedArrayDimension
+static double optimalOmega(const int dimension)
+{
+    if (dimension < 3) {
+        return 1;
+    }
+
+    return 2 / (1 + sin(PI / (dimension - 1)));
+}
+
+/**
+ * Resolve the automatic values in the given options (SOLVE_SPIN_AUTO,
+ * SOLVE_OMEGA_AUTO) for a grid of the given dimension.
+ *
+ * @param options   The options as given
+ * @param dimension The dimension of the grid to be solved
+ * @param resolved  Set to the options with automatic values resolved
+ */
+static void resolveSolveOptions(
+    const SolveOptions * const options,
+    const int dimension,
+    SolveOptions * const resolved
 )
 {
-    double newValue = (values[row][col - 1] + values[row][col + 1]
-                        + values[row - 1][col] + values[row + 1][col]) / 4;
+    *resolved = *options;
 
-    // fabs - absolute value i.e. difference
-    if (fabs(newValue - values[row][col]) < precision) {
-        valuesSolvedArray[row][col] = 1;
+    resolved->spinCount = getSolveSpinCount(options);
 
-        return endThread(threadAvailableFlag, threadAvailableFlagLock);
+    if (resolved->omega == SOLVE_OMEGA_AUTO) {
+        resolved->omega = optimalOmega(dimension);
     }
+}
 
-    values[row][col] = newValue;
+/**
+ * Solve the given values array with SOLVE_METHOD_RELAX, in single precision
+ * first with SOLVE_FLOAT_MIXED, then in the given mode.
+ *
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  kernels The relaxation kernels to use
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+static int solveRelax(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    SolveResult * const result
+)
+{
+    // Taken before the single precision phase, which it is relative to too
+    double reference;
+    int error = getStartResidual(values, options, &reference);
 
-    /**
-     *  We've changed a value so must assume all values are unsolved and
-     *  recheck
-     *
-     *  May result in a race if another thread is trying to set it's
-     *  corresponding flag to 1 (solved). In the worst case this thread will
-     *  overwrite the other thread's write. This will simply result in one
-     *  extra call of this function, so is not worth the overhead of adding
-     *  locks.
-     */
-    resetSolvedArray(valuesSolvedArray, valuesSolvedArrayDimension);
+    if (error) {
+        return error;
+    }
 
-    return endThread(threadAvailableFlag, threadAvailableFlagLock);
+    if (options->floats == SOLVE_FLOAT_MIXED) {
+        error = relaxFloat(values, options, kernels, reference, result);
+
+        if (error) {
+            return error;
+        }
+    }
+
+    switch (options->mode) {
+        case SOLVE_MODE_BANDS:
+        case SOLVE_MODE_BLOCKED:
+            return solveBands(values, options, kernels, reference, result);
+        default:
+            return solveDispatch(values, options, kernels, reference, result);
+    }
 }
 
 /**
- * Proxy to updateValue for code readbility. The callback to pthread_create can
- * only be passed one parameter (of type void *). This is implemented by
- * defining a struct with the required arguments, and so this simply pulls the
- * required parameters out of this struct and passes it to updateValue.
- * Allows type checking for error checking/debugging and for code readbility.
+ * Set the given options to their defaults.
  *
- * @param  args Struct containing the required arguments for updateValue
+ * @param options The options to set
+ */
+void setDefaultSolveOptions(SolveOptions * const options)
+{
+    options->threads = 1;
+    options->precision = 0.01;
+    options->method = SOLVE_METHOD_RELAX;
+    options->preconditioner = SOLVE_PRECONDITIONER_SSOR;
+    options->omega = 1;
+    options->mode = SOLVE_MODE_DISPATCH;
+    options->layout = SOLVE_LAYOUT_NATURAL;
+    options->kernel = SOLVE_KERNEL_AUTO;
+    options->floats = SOLVE_FLOAT_DOUBLE;
+    options->spinCount = SOLVE_SPIN_AUTO;
+    options->blockSweeps = SOLVE_BLOCK_AUTO;
+    options->checkpointer = NULL;
+    options->stats = NULL;
+    options->affinity = AFFINITY_NONE;
+    options->warmStart = SOLVE_WARM_START_NONE;
+    options->criterion = SOLVE_CRITERION_CHANGE;
+    options->checkEvery = 1;
+    options->context = NULL;
+}
+
+/**
+ * Pool task for firstTouchGrid. Each worker clears its band of rows,
+ * including the edge rows next to it.
  *
- * @return      NULL
+ * @param workerId The ID of the worker
+ * @param args     TouchArgs shared by all workers
  */
-static void *updateValueProxy(void *args)
+static void runFirstTouch(const int workerId, void * const args)
 {
-    const ThreadArgs * const threadArgs = (ThreadArgs*) args;
-
-    void *res = updateValue(
-        threadArgs->values,
-        threadArgs->row,
-        threadArgs->col,
-        threadArgs->precision,
-        threadArgs->threadAvailableFlag,
-        threadArgs->threadAvailableFlagLock,
-        threadArgs->valuesSolvedArray,
-        threadArgs->valuesSolvedArrayDimension
+    const TouchArgs * const touchArgs = (TouchArgs *) args;
+    Grid * const values = touchArgs->values;
+
+    int rowStart, rowEnd;
+    getBandWithEdges(
+        workerId,
+        touchArgs->threads,
+        values->dimension,
+        &rowStart,
+        &rowEnd
     );
 
-    free(args);
+    for (int row = rowStart; row < rowEnd; row++) {
+        memset(gridRow(values, row), 0, values->stride * sizeof(double));
+    }
+}
+
+/**
+ * Touch every row of a newly created grid from the worker that will sweep it
+ * in bands and blocked modes, before anything else writes to it. On NUMA
+ * systems the memory of each band then ends up local to its worker (pinned
+ * with options->affinity), rather than all of it on the node of the thread
+ * that fills in the values. The grid is set to 0. Does nothing with a single
+ * thread.
+ *
+ * @param  values  The grid to touch
+ * @param  options Options the grid will be solved with (threads, affinity)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int firstTouchGrid(Grid * const values, const SolveOptions * const options)
+{
+    if (options->threads == 1) {
+        return 0;
+    }
+
+    // A single task, so there is nothing to gain from spinning
+    SolveOptions poolOptions = *options;
+    poolOptions.spinCount = 0;
+
+    int error;
+    ThreadPool * const pool = createSolvePool(&poolOptions, &error);
+
+    if (error) {
+        return error;
+    }
 
-    return res;
+    TouchArgs touchArgs;
+    touchArgs.values = values;
+    touchArgs.threads = options->threads;
+
+    runThreadPool(pool, runFirstTouch, &touchArgs);
+
+    return releaseSolvePool(&poolOptions, pool);
 }
 
 /**
- * Check if the solution is 'solved'. That is, the valuesSolved array does not
- * contain a '0' flag (which represents an unsolved value)
+ * Solve the given values array with the method in the given options, which
+ * have been resolved for its dimension.
  *
- * @param  valuesSolvedArray Two dimensional array of flags that signal which
- *                           values have been solved
- * @param  dimension         The dimension of valuesSolvedArray
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  kernels The relaxation kernels to use
+ * @param  result  Set to information about the solve (iterations etc.)
  *
- * @return                   1 if valuesSolvedArray does not contain 0 (i.e
- *                           solution is 'solved'), 0 otherwise
+ * @return         0 on success, or an error code otherwise
  */
-static int isSolved(int ** const valuesSolvedArray, const int dimension)
+static int solveMethod(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    SolveResult * const result
+)
 {
-    return !twoDIntArrayContains(0, valuesSolvedArray, dimension);
+    switch (options->method) {
+        case SOLVE_METHOD_VCYCLE:
+        case SOLVE_METHOD_FMG:
+            return solveMultigrid(values, options, kernels, result);
+        case SOLVE_METHOD_CG:
+            return solveConjugateGradient(values, options, result);
+        case SOLVE_METHOD_JACOBI:
+            return solveJacobi(values, options, kernels, result);
+        default:
+            return solveRelax(values, options, kernels, result);
+    }
 }
 
 /**
- * Check if all threads have finished. If the threadsAvailable array contains a
- * 0, then we know a thread is still running (as the last thing a thread does
- * is update it's corresponding entry in this array to 1).
- * All threads have finished if the given threadsAvailable array does not
- * contain a 0.
- *
- * @param  threadsAvailable Array of flags singalling which threads are
- *                          available
- * @param  threads          Max number of threads, which is the dimension of
- *                          the threadsAvailable array
- *
- * @return                  1 if threadsAvailable does not contain 0 (i.e all
- *                          threads have finished), 0 otherwise
+ * Seed the interior of the given values for SOLVE_WARM_START_COARSE. The
+ * edges are interpolated onto a grid of dimension / 2 + 1, which is warm
+ * started in the same way, then solved with the same options (resolved for
+ * its dimension, so SOLVE_OMEGA_AUTO gives its own optimal factor). Its
+ * solution is interpolated up to the interior of the values. Coarse grids
+ * are scratch grids, so are reused by later solves with a context.
+ *
+ * @param  values  The grid of values to seed
+ * @param  options Options controlling the solve, as given to solve
+ * @param  kernels The relaxation kernels to use
+ * @param  result  coarseIterations is increased by the iterations done
+ *
+ * @return         0 on success, or an error code otherwise
  */
-static int allThreadsFinished(int * const threadsAvailable, const int threads)
+static int warmStartCoarse(
+    Grid * const values,
+    const SolveOptions * const options,
+    const RelaxKernels * const kernels,
+    SolveResult * const result
+)
 {
-    // intArraySearch returns -1 if it doesn't find given value
-    return intArraySearch(0, threadsAvailable, threads) == -1;
+    const int dimension = values->dimension / 2 + 1;
+
+    if (dimension < WARM_START_MIN_DIMENSION) {
+        return 0;
+    }
+
+    Grid * const coarse = takeScratchGrid(options, dimension);
+
+    if (!coarse) {
+        return ENOMEM;
+    }
+
+    interpolateGrid(coarse, values, 0);
+
+    int error = warmStartCoarse(coarse, options, kernels, result);
+
+    if (!error) {
+        // Only the solve of the full grid is checkpointed and recorded
+        SolveOptions resolved;
+        resolveSolveOptions(options, dimension, &resolved);
+        resolved.checkpointer = NULL;
+        resolved.stats = NULL;
+
+        SolveResult coarseResult;
+        coarseResult.iterations = 0;
+        coarseResult.floatIterations = 0;
+
+        error = solveMethod(coarse, &resolved, kernels, &coarseResult);
+
+        result->coarseIterations += coarseResult.iterations
+                                    + coarseResult.floatIterations;
+    }
+
+    if (!error) {
+        interpolateGrid(values, coarse, 1);
+    }
+
+    releaseScratchGrid(options, coarse);
+
+    return error;
+}
+
+/**
+ * Seed the interior of the given values from a previous solution, such as
+ * the solution of the same problem before its edges changed a little, so
+ * that a solve starts close to the new solution. The edges of the values
+ * are kept. If the dimensions differ, the previous solution is interpolated
+ * (see interpolateGrid).
+ *
+ * @param  values   The grid of values to seed
+ * @param  previous The previous solution
+ *
+ * @return          0 on success, or EINVAL if either grid has a dimension
+ *                  of less than 2
+ */
+int warmStartGrid(Grid * const values, const Grid * const previous)
+{
+    if (values->dimension < 2 || previous->dimension < 2) {
+        return EINVAL;
+    }
+
+    interpolateGrid(values, previous, 1);
+
+    return 0;
 }
 
 /**
@@ -365,159 +1520,105 @@ static int allThreadsFinished(int * const threadsAvailable, const int threads)
  * this criteria. Uses a given number of threads to solve the problem in
  * parallel.
  *
- * @param values    The two dimensional values array to solve and update to the
- *                  solution
- * @param dimension The dimension of the two dimensional values array
- * @param threads   The number of threads to use when solving the problem (note
- *                  this is an upper bound)
- * @param precision The precision to work to (stop updating values when they
- *                  change by less than the precision)
+ * @param values  The grid of values to solve and update to the solution
+ * @param options Options controlling the solve (threads, precision etc.)
+ * @param result  Set to information about the solve (iterations etc.)
  *
- * @return          0 on success, or an error code otherwise
+ * @return        0 on success, or an error code otherwise
  */
 int solve(
-    double ** const values,
-    const int dimension,
-    const int threads,
-    const double precision
+    Grid * const values,
+    const SolveOptions * const options,
+    SolveResult * const result
 )
 {
-    // Array of available threads, initially all are available
-    int threadsAvailable[threads];
-    for (int i = 0; i < threads; i++) {
-        threadsAvailable[i] = 1;
+    const RelaxKernels * const kernels = getRelaxKernels(options->kernel);
+
+    if (!kernels) {
+        return ENOTSUP;
     }
 
-    // To check return codes of pthread functions
-    int error;
+    SolveOptions resolved;
+    resolveSolveOptions(options, values->dimension, &resolved);
 
-    // Array of locks on available threads
-    pthread_mutex_t threadsAvailableLocks[threads];
-    for (int i = 0; i < threads; i++) {
-        error = pthread_mutex_init(&threadsAvailableLocks[i], NULL);
+    result->iterations = 0;
+    result->omega = resolved.omega;
+    result->change = 0;
+    result->measure = 0;
+    result->floatIterations = 0;
+    result->coarseIterations = 0;
 
-        if (error) {
-            return error;
-        }
+    if (resolved.stats) {
+        clearSolveStats(resolved.stats);
     }
 
-    // Keep track of threads to join them later
-    pthread_t tIds[threads];
-    int tId;
-
-    // start at (1, 1) as edges are fixed.
-    int row = 1, col = 1;
+    int error = 0;
 
-    // start with 'E' points
-    int oddPointsFlag = 0;
+    if (resolved.warmStart == SOLVE_WARM_START_COARSE) {
+        error = warmStartCoarse(values, options, kernels, result);
+    }
 
-    // Create array to flag which values have been solved ...
-    int ** const valuesSolvedArray = createTwoDIntArray(dimension);
-    // and initially set it
-    resetSolvedArray(valuesSolvedArray, dimension);
+    if (!error) {
+        error = solveMethod(values, &resolved, kernels, result);
+    }
 
-    /**
-     *  Only terminate solution is solved and all threads have finished
-     *  Note it is important that these checks are in this order, as swapping
-     *  the order could lead to a race where the isSolved check passes, then a
-     *  thread resets the valuesSolved array and terminates, then the second
-     *  check passes even though we do not have the complete solution.
-     */
-    while (!(allThreadsFinished(threadsAvailable, threads)
-           && isSolved(valuesSolvedArray, dimension))
+    // The other methods always stop on the change
+    if (resolved.method != SOLVE_METHOD_RELAX
+        && resolved.method != SOLVE_METHOD_JACOBI
     ) {
-        /**
-         * Find index (ID) of next available thread to spawn
-         *
-         * If a thread is updating it's own ID in availableThreads to
-         * 1 ('available'), this will miss this as it does not acquire the
-         * lock. However, this is a design choice. This will simply loop
-         * and try again rather than have the overhead of acquiring the
-         * lock.
-         */
-        tId = intArraySearch(1, threadsAvailable, threads);
-
-        // If no threads available
-        if (tId == -1) {
-            // busy wait, may be CPU hungry but will be faster
-            continue;
-        }
-
-        // If value isn't already solved, spawn thread to update it
-        if (!valuesSolvedArray[row][col]) {
-            // Dynamically allocated as we need a fresh instance every time
-            // This is freed in the callback (updateValueProxy)
-            ThreadArgs * const args = malloc(sizeof(ThreadArgs));
-            args->values = values;
-            args->row = row;
-            args->col = col;
-            args->precision = precision;
-            args->threadAvailableFlag = &threadsAvailable[tId];
-            args->threadAvailableFlagLock = &threadsAvailableLocks[tId];
-            args->valuesSolvedArray = valuesSolvedArray;
-            args->valuesSolvedArrayDimension = dimension;
-
-            error = pthread_mutex_lock(&threadsAvailableLocks[tId]);
-
-            if (error) {
-                return error;
-            }
-
-            // create the thread
-            error = pthread_create(
-                &tIds[tId],
-                NULL,
-                updateValueProxy,
-                (void *)args
-            );
-
-            if (error) {
-                return error;
-            }
-
-            /**
-             * Detach so that memory is automatically reallocated when thread
-             * terminates.
-             * We do not need to join threads as we have the threadsAvailable
-             * array to tell us when all threads are finished.
-             */
-            error = pthread_detach(tIds[tId]);
+        result->measure = result->change;
+    }
 
-            if (error) {
-                return error;
-            }
+    if (resolved.stats && !error) {
+        resolved.stats->iterations = result->iterations;
+        resolved.stats->change = result->change;
+        resolved.stats->solveSeconds = getMonotonicTime()
+                                       - resolved.stats->startTime;
+    }
 
-            // set thread to unavailable
-            threadsAvailable[tId] = 0;
+    if (resolved.context) {
+        trimSolveContext(resolved.context);
+    }
 
-            error = pthread_mutex_unlock(&threadsAvailableLocks[tId]);
+    return error;
+}
 
-            if (error) {
-                return error;
-            }
-        }
+/**
+ * Solve the given cube of values and update it to the solution. Replaces
+ * each point with the average of its six neighbours, using red-black
+ * relaxation in the same way as SOLVE_METHOD_RELAX, until no point changes
+ * by at least the given precision. Only the threads, precision, omega and
+ * spinCount options are used.
+ *
+ * @param values  The cube of values to solve and update to the solution
+ * @param options Options controlling the solve (threads, precision etc.)
+ * @param result  Set to information about the solve (iterations etc.)
+ *
+ * @return        0 on success, or an error code otherwise
+ */
+int solve3D(
+    Grid3D * const values,
+    const SolveOptions * const options,
+    SolveResult * const result
+)
+{
+    SolveOptions resolved;
+    resolveSolveOptions(options, values->dimension, &resolved);
 
-        // If we are not at the last point in this 'pass'
-        if (!isLastEvenPoint(row, col, dimension)
-            && !isLastOddPoint(row, col, dimension)
-        ) {
-            moveToNext(&row, &col, dimension);
+    result->iterations = 0;
+    result->omega = resolved.omega;
+    result->change = 0;
+    result->measure = 0;
+    result->floatIterations = 0;
+    result->coarseIterations = 0;
 
-            continue;
-        }
+    const int error = solveRelax3D(values, &resolved, result);
 
-        // Here we must be at the last point, so move to next pass
-        moveToNextPass(&oddPointsFlag, &row, &col);
+    result->measure = result->change;
 
-        // Wait for all live threads to finish before the next pass, as we
-        // cannot do some 'E's and 'O's at the same time (see top of file
-        // comment for info on what an 'E' and an 'O' is)
-        while (!allThreadsFinished(threadsAvailable, threads)) {
-            continue;
-        }
+    if (resolved.context) {
+        trimSolveContext(resolved.context);
     }
 
-    freeTwoDIntArray(valuesSolvedArray, dimension);
-
-    return 0;
+    return error;
 }
@@ -1,3 +1,252 @@
+#ifndef SOLVE_H
+#define SOLVE_H
+
+#include "../array/array.h"
+#include "../affinity/affinity.h"
+#include "../checkpoint/checkpoint.h"
+#include "../stats/stats.h"
+
+/**
+ * The numerical method solve uses:
+ *  - SOLVE_METHOD_RELAX:  red-black Gauss-Seidel relaxation of the grid.
+ *  - SOLVE_METHOD_VCYCLE: multigrid V-cycles, using red-black Gauss-Seidel
+ *                         as the smoother on a hierarchy of coarser grids.
+ *  - SOLVE_METHOD_FMG:    full multigrid - solve on the coarsest grid and
+ *                         interpolate up, doing a V-cycle on each level, then
+ *                         V-cycles on the full grid.
+ *  - SOLVE_METHOD_CG:     preconditioned conjugate gradient (see
+ *                         SolvePreconditioner).
+ *  - SOLVE_METHOD_JACOBI: Jacobi relaxation into a second buffer, which gives
+ *                         the same result for any number of threads.
+ * The methods other than SOLVE_METHOD_RELAX always split work into bands of
+ * rows, and so ignore the mode and layout.
+ */
+typedef enum {
+    SOLVE_METHOD_RELAX,
+    SOLVE_METHOD_VCYCLE,
+    SOLVE_METHOD_FMG,
+    SOLVE_METHOD_CG,
+    SOLVE_METHOD_JACOBI
+} SolveMethod;
+
+/**
+ * The preconditioner used by SOLVE_METHOD_CG:
+ *  - SOLVE_PRECONDITIONER_JACOBI: divide by the diagonal (4).
+ *  - SOLVE_PRECONDITIONER_SSOR:   one symmetric red-black Gauss-Seidel
+ *                                 sweep ('E', 'O', then 'E' points again).
+ */
+typedef enum {
+    SOLVE_PRECONDITIONER_JACOBI,
+    SOLVE_PRECONDITIONER_SSOR
+} SolvePreconditioner;
+
+/**
+ * The different ways solve can schedule work between threads:
+ *  - SOLVE_MODE_DISPATCH: points of each colour are handed out to workers in
+ *                         batches from a shared cursor.
+ *  - SOLVE_MODE_BANDS:    each worker owns a contiguous band of rows, sweeps
+ *                         all 'E' points in it, waits at a barrier, then
+ *                         sweeps all 'O' points.
+ *  - SOLVE_MODE_BLOCKED:  like SOLVE_MODE_BANDS, but each worker does several
+ *                         sweeps of its band while the rows are in cache
+ *                         before synchronising (temporal blocking).
+ */
+typedef enum {
+    SOLVE_MODE_DISPATCH,
+    SOLVE_MODE_BANDS,
+    SOLVE_MODE_BLOCKED
+} SolveMode;
+
+/**
+ * How the grid is stored while it is being solved:
+ *  - SOLVE_LAYOUT_NATURAL: the grid as given, row by row.
+ *  - SOLVE_LAYOUT_SPLIT:   'E' and 'O' points in two compacted arrays (see
+ *                          SplitGrid in src/array/array.h), so each half-sweep
+ *                          reads and writes with unit stride. Only used by
+ *                          SOLVE_MODE_BANDS and SOLVE_MODE_BLOCKED.
+ */
+typedef enum {
+    SOLVE_LAYOUT_NATURAL,
+    SOLVE_LAYOUT_SPLIT
+} SolveLayout;
+
+/**
+ * Which implementation of the relaxation kernel to use (see
+ * src/solve/kernel.c). SOLVE_KERNEL_AUTO picks the widest one the CPU
+ * supports at startup.
+ */
+typedef enum {
+    SOLVE_KERNEL_AUTO,
+    SOLVE_KERNEL_SCALAR,
+    SOLVE_KERNEL_SSE2,
+    SOLVE_KERNEL_AVX2,
+    SOLVE_KERNEL_AVX512
+} SolveKernel;
+
+/**
+ * The floating point precision SOLVE_METHOD_RELAX sweeps in:
+ *  - SOLVE_FLOAT_DOUBLE: every sweep is double precision.
+ *  - SOLVE_FLOAT_MIXED:  relax a single precision copy of the grid first,
+ *                        which halves the memory moved per sweep, refine it
+ *                        with corrections relaxed in single precision from
+ *                        the residual in double, then finish with double
+ *                        precision sweeps until the criterion is met (see
+ *                        src/solve/mixed.c).
+ */
+typedef enum {
+    SOLVE_FLOAT_DOUBLE,
+    SOLVE_FLOAT_MIXED
+} SolveFloat;
+
+/**
+ * How solve seeds the interior of the grid before solving:
+ *  - SOLVE_WARM_START_NONE:   start from the values as given.
+ *  - SOLVE_WARM_START_COARSE: solve a grid of about half the dimension with
+ *                             the same edges (itself warm started in the
+ *                             same way, down to a small grid), and
+ *                             interpolate its solution up to the interior.
+ *                             Each coarse grid costs about a quarter as much
+ *                             per sweep, and the solve of the full grid then
+ *                             starts close to the solution.
+ * To start from a previous solution instead, see warmStartGrid.
+ */
+typedef enum {
+    SOLVE_WARM_START_NONE,
+    SOLVE_WARM_START_COARSE
+} SolveWarmStart;
+
+/**
+ * When SOLVE_METHOD_RELAX and SOLVE_METHOD_JACOBI stop, by comparing a
+ * measure of a sweep against the precision:
+ *  - SOLVE_CRITERION_CHANGE:      the largest change of any point. Points
+ *                                 that would change by less than the
+ *                                 precision are left as they are.
+ *  - SOLVE_CRITERION_CHANGE_L2:   the root mean square change of the points
+ *                                 (their L2 norm over the square root of the
+ *                                 number of interior points, so a precision
+ *                                 means the same on any size of grid).
+ *  - SOLVE_CRITERION_RESIDUAL:    the largest residual of the discrete
+ *                                 Laplace equation, i.e. of the four
+ *                                 neighbours of a point minus 4 times it.
+ *  - SOLVE_CRITERION_RESIDUAL_L2: the root mean square residual.
+ *  - SOLVE_CRITERION_RELATIVE:    the root mean square residual over its
+ *                                 value before the first sweep.
+ * The kernels work all of these out as they relax the points, with no extra
+ * pass over the grid. The residuals are those of the grid as it was at the
+ * start of the sweep (see src/solve/criterion.c). With the criteria other
+ * than SOLVE_CRITERION_CHANGE every point is updated every sweep. The other
+ * methods always stop on the change (or residual, for conjugate gradient).
+ */
+typedef enum {
+    SOLVE_CRITERION_CHANGE,
+    SOLVE_CRITERION_CHANGE_L2,
+    SOLVE_CRITERION_RESIDUAL,
+    SOLVE_CRITERION_RESIDUAL_L2,
+    SOLVE_CRITERION_RELATIVE
+} SolveCriterion;
+
+// omega value that picks the optimal relaxation factor for the grid size
+#define SOLVE_OMEGA_AUTO 0
+
+// spinCount value that spins only if every thread can have its own CPU
+#define SOLVE_SPIN_AUTO -1
+
+// blockSweeps value that picks the number of sweeps from the row size
+#define SOLVE_BLOCK_AUTO 0
+
+/**
+ * Opaque solve context type, which keeps the thread pool and scratch buffers
+ * between solves. See src/solve/context.c for details.
+ */
+typedef struct SolveContext SolveContext;
+
+// Options controlling how solve works
+typedef struct {
+    int threads; // The number of threads to use (upper bound)
+    double precision; // The precision to work to
+    SolveMethod method; // The numerical method to use
+    SolvePreconditioner preconditioner; // Preconditioner for SOLVE_METHOD_CG
+    double omega; // Relaxation factor for SOLVE_METHOD_RELAX (1 for
+                  // Gauss-Seidel, between 1 and 2 for over-relaxation), or
+                  // SOLVE_OMEGA_AUTO
+    SolveMode mode; // How work is split between threads
+    SolveLayout layout; // How the grid is stored while solving
+    SolveKernel kernel; // Which relaxation kernel to use
+    SolveFloat floats; // Floating point precision of SOLVE_METHOD_RELAX sweeps
+    int spinCount; // How long waiting threads spin before blocking, or
+                   // SOLVE_SPIN_AUTO
+    int blockSweeps; // Sweeps per block in SOLVE_MODE_BLOCKED, or
+                     // SOLVE_BLOCK_AUTO
+    AffinityPolicy affinity; // How workers are pinned to CPUs
+    SolveWarmStart warmStart; // How to seed the interior before solving
+    SolveCriterion criterion; // When to stop SOLVE_METHOD_RELAX and
+                              // SOLVE_METHOD_JACOBI
+    int checkEvery; // Test the criterion only every this many sweeps (in
+                    // SOLVE_MODE_BLOCKED, at the end of each block that
+                    // has such a sweep in it)
+    Checkpointer * checkpointer; // Takes checkpoints between sweeps of
+                                 // SOLVE_METHOD_RELAX in double precision,
+                                 // or NULL for none
+    SolveStats * stats; // Statistics to record (created for at least this
+                        // many threads), or NULL for none
+    SolveContext * context; // Thread pool and scratch buffers to reuse (see
+                            // createSolveContext), or NULL to set them up
+                            // for this solve only
+} SolveOptions;
+
+// Information about a finished solve
+typedef struct {
+    int iterations; // Sweeps (relax, Jacobi), cycles of the full grid
+                    // (multigrid) or iterations (conjugate gradient) done
+    double omega; // The relaxation factor used by SOLVE_METHOD_RELAX
+    double change; // Largest change of any point in the last sweep (or
+                   // smoothing sweep), or residual / 4 for conjugate gradient
+    int floatIterations; // Single precision sweeps done by SOLVE_FLOAT_MIXED
+                         // before the iterations above
+    double measure; // The measure of options->criterion at the last test,
+                    // or the change for the methods that ignore it
+    int coarseIterations; // Iterations (as above, plus any single precision
+                          // sweeps) done on the coarse grids of
+                          // SOLVE_WARM_START_COARSE, all grids together
+} SolveResult;
+
+/**
+ * Set the given options to their defaults.
+ *
+ * @param options The options to set
+ */
+void setDefaultSolveOptions(SolveOptions * const options);
+
+/**
+ * Touch every row of a newly created grid from the worker that will sweep it
+ * in bands and blocked modes, before anything else writes to it. On NUMA
+ * systems the memory of each band then ends up local to its worker (pinned
+ * with options->affinity), rather than all of it on the node of the thread
+ * that fills in the values. The grid is set to 0. Does nothing with a single
+ * thread.
+ *
+ * @param  values  The grid to touch
+ * @param  options Options the grid will be solved with (threads, affinity)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int firstTouchGrid(Grid * const values, const SolveOptions * const options);
+
+/**
+ * Seed the interior of the given values from a previous solution, such as
+ * the solution of the same problem before its edges changed a little, so
+ * that a solve starts close to the new solution. The edges of the values
+ * are kept. If the dimensions differ, the previous solution is interpolated
+ * (see interpolateGrid).
+ *
+ * @param  values   The grid of values to seed
+ * @param  previous The previous solution
+ *
+ * @return          0 on success, or EINVAL if either grid has a dimension
+ *                  of less than 2
+ */
+int warmStartGrid(Grid * const values, const Grid * const previous);
+
 /**
  * Solve the given values array and update it to the solution. Replaces each
  * point with the average of its four neighbours and repeats until the point
@@ -5,19 +254,99 @@
  * this criteria. Uses a given number of threads to solve the problem in
  * parallel.
  *
- * @param values    The two dimensional values array to solve and update to the
- *                  solution
- * @param dimension The dimension of the two dimensional values array
- * @param threads   The number of threads to use when solving the problem (note
- *                  this is an upper bound)
- * @param precision The precision to work to (stop updating values when they
- *                  change by less than the precision)
+ * @param values  The grid of values to solve and update to the solution
+ * @param options Options controlling the solve (threads, precision etc.)
+ * @param result  Set to information about the solve (iterations etc.)
  *
- * @return          0 on success, or an error code otherwise
+ * @return        0 on success, or an error code otherwise
  */
 int solve(
-    double ** const values,
-    const int dimension,
-    const int threads,
-    const double precision
+    Grid * const values,
+    const SolveOptions * const options,
+    SolveResult * const result
+);
+
+/**
+ * Solve the given cube of values and update it to the solution. Replaces
+ * each point with the average of its six neighbours, using red-black
+ * relaxation in the same way as SOLVE_METHOD_RELAX, until no point changes
+ * by at least the given precision. Only the threads, precision, omega and
+ * spinCount options are used.
+ *
+ * @param values  The cube of values to solve and update to the solution
+ * @param options Options controlling the solve (threads, precision etc.)
+ * @param result  Set to information about the solve (iterations etc.)
+ *
+ * @return        0 on success, or an error code otherwise
+ */
+int solve3D(
+    Grid3D * const values,
+    const SolveOptions * const options,
+    SolveResult * const result
 );
+
+/**
+ * Create a solve context, with a thread pool of options->threads workers
+ * pinned according to options->affinity, and no scratch buffers yet. The
+ * options are kept for solveWithContext. If the workers are pinned, so is
+ * the calling thread until the context is freed. Should always be followed
+ * later in the calling code with freeSolveContext.
+ *
+ * Solves with a context (solveWithContext, or solve, solve3D and
+ * firstTouchGrid with options->context set) run on its pool, and keep their
+ * scratch buffers in it for the next solve, so repeated solves of the same
+ * size set nothing up. A context must only be used by one solve at a time.
+ *
+ * @param  options Options to solve with (threads, spinCount and affinity
+ *                 are fixed for the life of the context)
+ * @param  error   Set to 0 on success, or an error code otherwise
+ *
+ * @return         Pointer to the created context, or NULL on error
+ */
+SolveContext *createSolveContext(
+    const SolveOptions * const options,
+    int * const error
+);
+
+/**
+ * Change the options solveWithContext uses. The threads, spinCount and
+ * affinity cannot be changed, as the pool was created with them.
+ *
+ * @param  context The context
+ * @param  options The new options
+ *
+ * @return         0 on success, or EINVAL if threads, spinCount or affinity
+ *                 differ from the ones the context was created with
+ */
+int setSolveContextOptions(
+    SolveContext * const context,
+    const SolveOptions * const options
+);
+
+/**
+ * Solve the given values array with the options of a context, in the same
+ * way as solve, reusing the context's thread pool and scratch buffers.
+ *
+ * @param  context The context
+ * @param  values  The grid of values to solve and update to the solution
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveWithContext(
+    SolveContext * const context,
+    Grid * const values,
+    SolveResult * const result
+);
+
+/**
+ * Free a solve context, its thread pool and all its scratch buffers. Must
+ * not be called while a solve is using it.
+ *
+ * @param  context The context to free
+ *
+ * @return         0 on success, or a pthread error code from freeing the pool
+ */
+int freeSolveContext(SolveContext * const context);
+
+#endif
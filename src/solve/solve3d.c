@@ -0,0 +1,288 @@
+/**
+ * Red-black relaxation of a cube, where each interior point is replaced by
+ * the average of its six neighbours (left, right, above, below, in front and
+ * behind). The faces of the cube are fixed, as the edges are in two
+ * dimensions.
+ *
+ * Points are coloured by whether plane + row + col is even or odd, so as in
+ * two dimensions all six neighbours of an 'E' point are 'O' points and vice
+ * versa, and all points of one colour can be relaxed in any order. The
+ * result does not depend on the number of threads.
+ *
+ * All workers run the whole solve as a single pool task, each owning a band
+ * of interior planes (see getBand in src/solve/band.c), with barriers after
+ * each colour as in bands mode. A plane of a large cube does not fit in
+ * cache, so each band is swept in tiles of rows: every plane of the band is
+ * relaxed for the rows of one tile before moving on to the next tile, so the
+ * planes in front and behind are still in cache when they are read.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../array/array.h"
+#include "../pool/pool.h"
+#include "../barrier/barrier.h"
+#include "solve.h"
+#include "band.h"
+#include "context.h"
+#include "solve3d.h"
+
+// Target size of the rows of three planes that are swept together
+#define TILE_CACHE_SIZE (256 * 1024)
+
+// struct to pass multiple arguments to the pool task
+typedef struct {
+    Grid3D * values; // The cube of values
+    double precision; // The precision to work to
+    double omega; // The relaxation factor
+    int threads; // The number of workers
+    int tileRows; // Rows in each tile
+    Barrier barrier; // Barrier between half-sweeps
+    WorkerResult * results; // Result of each worker
+    int sweeps; // Sweeps done, set by worker 0
+} Band3DArgs;
+
+/**
+ * Relax every other point of a row of the cube, from firstCol up to but not
+ * including endCol, in the same way as RelaxRowFunction (see kernel.h).
+ *
+ * @param  current   The row to relax
+ * @param  above     The row above it in the same plane
+ * @param  below     The row below it in the same plane
+ * @param  front     The same row in the plane before
+ * @param  back      The same row in the plane after
+ * @param  firstCol  The first column to relax
+ * @param  endCol    One past the last column that may be relaxed
+ * @param  omega     The relaxation factor
+ * @param  precision The precision to work to
+ *
+ * @return           The largest change of any point in the row
+ */
+static double relaxRow3D(
+    double * const current,
+    const double * const above,
+    const double * const below,
+    const double * const front,
+    const double * const back,
+    const int firstCol,
+    const int endCol,
+    const double omega,
+    const double precision
+)
+{
+    double maxChange = 0;
+
+    for (int col = firstCol; col < endCol; col += 2) {
+        double newValue = (current[col - 1] + current[col + 1]
+                           + above[col] + below[col]
+                           + front[col] + back[col]) / 6;
+
+        if (omega != 1) {
+            newValue = current[col] + omega * (newValue - current[col]);
+        }
+
+        const double change = fabs(newValue - current[col]);
+
+        if (change > maxChange) {
+            maxChange = change;
+        }
+
+        if (change < precision) {
+            continue;
+        }
+
+        current[col] = newValue;
+    }
+
+    return maxChange;
+}
+
+/**
+ * Relax all points of one colour in a band of planes, a tile of rows at a
+ * time.
+ *
+ * @param  args       Band3DArgs shared by all workers
+ * @param  planeStart The first plane in the band
+ * @param  planeEnd   One past the last plane in the band
+ * @param  odd        0 to relax 'E' points, 1 to relax 'O' points
+ *
+ * @return            The largest change of any point relaxed
+ */
+static double relaxBand3D(
+    const Band3DArgs * const args,
+    const int planeStart,
+    const int planeEnd,
+    const int odd
+)
+{
+    const Grid3D * const values = args->values;
+    const int dimension = values->dimension;
+
+    double maxChange = 0;
+
+    for (int tileStart = 1; tileStart < dimension - 1;
+         tileStart += args->tileRows
+    ) {
+        const int tileEnd = tileStart + args->tileRows < dimension - 1
+                            ? tileStart + args->tileRows
+                            : dimension - 1;
+
+        for (int plane = planeStart; plane < planeEnd; plane++) {
+            for (int row = tileStart; row < tileEnd; row++) {
+                const double change = relaxRow3D(
+                    grid3DRow(values, plane, row),
+                    grid3DRow(values, plane, row - 1),
+                    grid3DRow(values, plane, row + 1),
+                    grid3DRow(values, plane - 1, row),
+                    grid3DRow(values, plane + 1, row),
+                    2 - ((plane + row + odd) & 1),
+                    dimension - 1,
+                    args->omega,
+                    args->precision
+                );
+
+                if (change > maxChange) {
+                    maxChange = change;
+                }
+            }
+        }
+    }
+
+    return maxChange;
+}
+
+/**
+ * Pool task for the 3D solve. Each worker relaxes the 'E' points in its band
+ * of planes, waits for all workers, then relaxes the 'O' points, and repeats
+ * until a sweep changes no point by at least the precision.
+ *
+ * @param workerId The ID of the worker
+ * @param args     Band3DArgs shared by all workers
+ */
+static void runBands3D(const int workerId, void * const args)
+{
+    Band3DArgs * const bandArgs = (Band3DArgs *) args;
+
+    int planeStart, planeEnd;
+    getBand(
+        workerId,
+        bandArgs->threads,
+        bandArgs->values->dimension,
+        &planeStart,
+        &planeEnd
+    );
+
+    int sweeps = 0;
+    int solved = 0;
+
+    while (!solved) {
+        double maxChange = relaxBand3D(bandArgs, planeStart, planeEnd, 0);
+
+        waitBarrier(&bandArgs->barrier);
+
+        const double oddChange = relaxBand3D(
+            bandArgs,
+            planeStart,
+            planeEnd,
+            1
+        );
+
+        if (oddChange > maxChange) {
+            maxChange = oddChange;
+        }
+
+        bandArgs->results[workerId].maxChange = maxChange;
+
+        waitBarrier(&bandArgs->barrier);
+
+        solved = maxWorkerChange(bandArgs->results, bandArgs->threads)
+                 < bandArgs->precision;
+
+        sweeps++;
+    }
+
+    if (workerId == 0) {
+        bandArgs->sweeps = sweeps;
+    }
+}
+
+/**
+ * Work out how many rows to sweep at a time, so that the rows of the plane
+ * being relaxed and the planes either side of it fit in TILE_CACHE_SIZE.
+ *
+ * @param  values The cube being solved
+ *
+ * @return        The number of rows in each tile, at least 1
+ */
+static int getTileRows(const Grid3D * const values)
+{
+    const size_t rowSize = values->stride * sizeof(double);
+    const int rows = (int)(TILE_CACHE_SIZE / (3 * rowSize)) - 2;
+
+    return rows > 1 ? rows : 1;
+}
+
+/**
+ * Solve the given cube of values with red-black relaxation of the
+ * seven-point stencil, and update it to the solution. Stops after the first
+ * sweep in which no point changed by at least the precision.
+ *
+ * @param  values  The cube of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveRelax3D(
+    Grid3D * const values,
+    const SolveOptions * const options,
+    SolveResult * const result
+)
+{
+    const int threads = options->threads;
+
+    int error = 0;
+
+    Band3DArgs bandArgs;
+    bandArgs.values = values;
+    bandArgs.precision = options->precision;
+    bandArgs.omega = options->omega;
+    bandArgs.threads = threads;
+    bandArgs.tileRows = getTileRows(values);
+    bandArgs.results = takeScratchResults(options);
+    bandArgs.sweeps = 0;
+
+    if (!bandArgs.results) {
+        return ENOMEM;
+    }
+
+    ThreadPool * const pool = createSolvePool(options, &error);
+
+    if (!error) {
+        error = initBarrier(&bandArgs.barrier, threads, options->spinCount);
+
+        if (!error) {
+            runThreadPool(pool, runBands3D, &bandArgs);
+
+            destroyBarrier(&bandArgs.barrier);
+        }
+
+        const int poolError = releaseSolvePool(options, pool);
+
+        if (!error) {
+            error = poolError;
+        }
+    }
+
+    result->iterations = bandArgs.sweeps;
+
+    if (!error) {
+        result->change = maxWorkerChange(bandArgs.results, threads);
+    }
+
+    releaseScratchResults(options, bandArgs.results);
+
+    return error;
+}
@@ -0,0 +1,24 @@
+#ifndef SOLVE3D_H
+#define SOLVE3D_H
+
+#include "../array/array.h"
+#include "solve.h"
+
+/**
+ * Solve the given cube of values with red-black relaxation of the
+ * seven-point stencil, and update it to the solution. Stops after the first
+ * sweep in which no point changed by at least the precision.
+ *
+ * @param  values  The cube of values to solve and update to the solution
+ * @param  options Options controlling the solve (threads, precision etc.)
+ * @param  result  Set to information about the solve (iterations etc.)
+ *
+ * @return         0 on success, or an error code otherwise
+ */
+int solveRelax3D(
+    Grid3D * const values,
+    const SolveOptions * const options,
+    SolveResult * const result
+);
+
+#endif
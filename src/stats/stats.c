@@ -0,0 +1,226 @@
+/**
+ * Statistics of a solve (see SolveStats in stats.h), and writing them out as
+ * JSON. Everything here is recorded by at most one thread at a time: each
+ * thread only adds to its own ThreadStats, and the trace is only added to by
+ * the thread that decides whether the solve has converged.
+ */
+
+// Needed for posix_memalign when compiling with -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../utility/utility.h"
+#include "stats.h"
+
+// Entries the trace starts with room for. It doubles whenever it is full.
+#define INITIAL_TRACE_CAPACITY 1024
+
+/**
+ * Create a record of statistics for a solve with the given number of
+ * threads. Should always be followed later in the calling code with
+ * freeSolveStats.
+ *
+ * @param  threads        The number of threads the solve will use
+ * @param  stream         File to write a line of JSON to every
+ *                        streamInterval sweeps while solving, or NULL
+ * @param  streamInterval Sweeps between lines streamed
+ *
+ * @return                Pointer to the statistics, or NULL if out of memory
+ */
+SolveStats *createSolveStats(
+    const int threads,
+    FILE * const stream,
+    const int streamInterval
+)
+{
+    SolveStats * const stats = malloc(sizeof(SolveStats));
+
+    if (!stats) {
+        return NULL;
+    }
+
+    stats->threads = threads;
+
+    // Aligned, so the padding of ThreadStats gives each thread its own line
+    void *threadStats;
+
+    if (posix_memalign(
+            &threadStats,
+            STATS_CACHE_LINE_SIZE,
+            threads * sizeof(ThreadStats)
+        )
+    ) {
+        threadStats = NULL;
+    }
+
+    stats->threadStats = threadStats;
+    stats->capacity = INITIAL_TRACE_CAPACITY;
+    stats->trace = malloc(stats->capacity * sizeof(SweepStats));
+    stats->stream = stream;
+    stats->streamInterval = streamInterval > 0 ? streamInterval : 1;
+
+    if (!stats->threadStats || !stats->trace) {
+        freeSolveStats(stats);
+
+        return NULL;
+    }
+
+    clearSolveStats(stats);
+
+    return stats;
+}
+
+/**
+ * Clear all statistics recorded so far, and start timing a new solve.
+ *
+ * @param stats The statistics to clear
+ */
+void clearSolveStats(SolveStats * const stats)
+{
+    for (int i = 0; i < stats->threads; i++) {
+        stats->threadStats[i].busySeconds = 0;
+        stats->threadStats[i].waitSeconds = 0;
+    }
+
+    stats->steps = 0;
+    stats->truncated = 0;
+    stats->iterations = 0;
+    stats->change = 0;
+    stats->startTime = getMonotonicTime();
+    stats->solveSeconds = 0;
+    stats->nextStream = stats->streamInterval;
+}
+
+/**
+ * Add a step to the convergence trace, and stream a line if due. Only one
+ * thread may call this at a time. If the trace cannot grow, it is marked as
+ * truncated and the step is dropped.
+ *
+ * @param stats        The statistics to add to
+ * @param sweeps       Sweeps done by the end of the step
+ * @param change       Largest change of any point in the last sweep
+ * @param firstSeconds Time of the first half of the step
+ * @param lastSeconds  Time of the second half of the step
+ */
+void recordSweep(
+    SolveStats * const stats,
+    const int sweeps,
+    const double change,
+    const double firstSeconds,
+    const double lastSeconds
+)
+{
+    if (stats->steps == stats->capacity && !stats->truncated) {
+        SweepStats * const trace = realloc(
+            stats->trace,
+            2 * stats->capacity * sizeof(SweepStats)
+        );
+
+        if (trace) {
+            stats->trace = trace;
+            stats->capacity *= 2;
+        } else {
+            stats->truncated = 1;
+        }
+    }
+
+    if (stats->steps < stats->capacity) {
+        SweepStats * const step = &stats->trace[stats->steps++];
+
+        step->sweeps = sweeps;
+        step->change = change;
+        step->phaseSeconds[0] = firstSeconds;
+        step->phaseSeconds[1] = lastSeconds;
+    }
+
+    if (stats->stream && sweeps >= stats->nextStream) {
+        fprintf(
+            stats->stream,
+            "{\"sweeps\": %d, \"change\": %.9g, \"seconds\": %.6f}\n",
+            sweeps,
+            change,
+            getMonotonicTime() - stats->startTime
+        );
+        fflush(stats->stream);
+
+        while (stats->nextStream <= sweeps) {
+            stats->nextStream += stats->streamInterval;
+        }
+    }
+}
+
+/**
+ * Write the statistics as a JSON object.
+ *
+ * @param  f     The file to write to
+ * @param  stats The statistics to write
+ *
+ * @return       0 on success, or an error code otherwise
+ */
+int writeSolveStats(FILE * const f, const SolveStats * const stats)
+{
+    fprintf(f, "{\n");
+    fprintf(f, "  \"threads\": %d,\n", stats->threads);
+    fprintf(f, "  \"iterations\": %d,\n", stats->iterations);
+    fprintf(f, "  \"finalChange\": %.9g,\n", stats->change);
+    fprintf(f, "  \"solveSeconds\": %.6f,\n", stats->solveSeconds);
+    fprintf(f, "  \"threadStats\": [");
+
+    for (int i = 0; i < stats->threads; i++) {
+        const ThreadStats * const thread = &stats->threadStats[i];
+        const double total = thread->busySeconds + thread->waitSeconds;
+
+        fprintf(
+            f,
+            "%s\n    {\"thread\": %d, \"busySeconds\": %.6f, "
+            "\"waitSeconds\": %.6f, \"busyRatio\": %.4f}",
+            i ? "," : "",
+            i,
+            thread->busySeconds,
+            thread->waitSeconds,
+            total > 0 ? thread->busySeconds / total : 0
+        );
+    }
+
+    fprintf(f, "\n  ],\n");
+    fprintf(
+        f,
+        "  \"traceTruncated\": %s,\n",
+        stats->truncated ? "true" : "false"
+    );
+    fprintf(f, "  \"trace\": [");
+
+    for (int i = 0; i < stats->steps; i++) {
+        const SweepStats * const step = &stats->trace[i];
+
+        fprintf(
+            f,
+            "%s\n    {\"sweeps\": %d, \"change\": %.9g, "
+            "\"phaseSeconds\": [%.9f, %.9f]}",
+            i ? "," : "",
+            step->sweeps,
+            step->change,
+            step->phaseSeconds[0],
+            step->phaseSeconds[1]
+        );
+    }
+
+    fprintf(f, "%s]\n}\n", stats->steps ? "\n  " : "");
+
+    return ferror(f) ? EIO : 0;
+}
+
+/**
+ * Free the given statistics.
+ *
+ * @param stats The statistics to free
+ */
+void freeSolveStats(SolveStats * const stats)
+{
+    free(stats->trace);
+    free(stats->threadStats);
+    free(stats);
+}
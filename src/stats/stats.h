@@ -0,0 +1,108 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+// Size that per-thread statistics are padded to, so threads updating their
+// own never share a cache line
+#define STATS_CACHE_LINE_SIZE 64
+
+// Time one thread of a solve spent working and waiting
+typedef struct {
+    double busySeconds; // Time spent relaxing points
+    double waitSeconds; // Time spent waiting at barriers (or for the pool)
+    char padding[STATS_CACHE_LINE_SIZE - 2 * sizeof(double)];
+} ThreadStats;
+
+// One step of the convergence trace: a sweep, or a block of sweeps in
+// SOLVE_MODE_BLOCKED
+typedef struct {
+    int sweeps; // Sweeps done by the end of the step
+    double change; // Largest change of any point in the last sweep
+    double phaseSeconds[2]; // Time of each half of the step: the 'E' and 'O'
+                            // half-sweeps, or the two phases of a block
+} SweepStats;
+
+/**
+ * Statistics recorded by solve, for diagnosing load imbalance and slow
+ * convergence. The per-thread times and convergence trace are recorded by
+ * SOLVE_METHOD_RELAX in double precision; every method records the totals.
+ */
+typedef struct {
+    int threads; // Number of threads the solve was given
+    ThreadStats * threadStats; // Times of each thread
+    SweepStats * trace; // One entry per step, in order
+    int steps; // Number of entries in the trace
+    int capacity; // Entries the trace has room for
+    int truncated; // Flag - did the trace run out of memory
+    int iterations; // Iterations of the solve (as in SolveResult)
+    double change; // Final change of the solve (as in SolveResult)
+    double startTime; // Monotonic time the solve started
+    double solveSeconds; // Wall time of the whole solve
+    FILE * stream; // File to stream progress to, or NULL
+    int streamInterval; // Sweeps between lines streamed
+    int nextStream; // Sweeps after which to stream the next line
+} SolveStats;
+
+/**
+ * Create a record of statistics for a solve with the given number of
+ * threads. Should always be followed later in the calling code with
+ * freeSolveStats.
+ *
+ * @param  threads        The number of threads the solve will use
+ * @param  stream         File to write a line of JSON to every
+ *                        streamInterval sweeps while solving, or NULL
+ * @param  streamInterval Sweeps between lines streamed
+ *
+ * @return                Pointer to the statistics, or NULL if out of memory
+ */
+SolveStats *createSolveStats(
+    const int threads,
+    FILE * const stream,
+    const int streamInterval
+);
+
+/**
+ * Clear all statistics recorded so far, and start timing a new solve.
+ *
+ * @param stats The statistics to clear
+ */
+void clearSolveStats(SolveStats * const stats);
+
+/**
+ * Add a step to the convergence trace, and stream a line if due. Only one
+ * thread may call this at a time. If the trace cannot grow, it is marked as
+ * truncated and the step is dropped.
+ *
+ * @param stats        The statistics to add to
+ * @param sweeps       Sweeps done by the end of the step
+ * @param change       Largest change of any point in the last sweep
+ * @param firstSeconds Time of the first half of the step
+ * @param lastSeconds  Time of the second half of the step
+ */
+void recordSweep(
+    SolveStats * const stats,
+    const int sweeps,
+    const double change,
+    const double firstSeconds,
+    const double lastSeconds
+);
+
+/**
+ * Write the statistics as a JSON object.
+ *
+ * @param  f     The file to write to
+ * @param  stats The statistics to write
+ *
+ * @return       0 on success, or an error code otherwise
+ */
+int writeSolveStats(FILE * const f, const SolveStats * const stats);
+
+/**
+ * Free the given statistics.
+ *
+ * @param stats The statistics to free
+ */
+void freeSolveStats(SolveStats * const stats);
+
+#endif
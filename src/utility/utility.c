@@ -1,3 +1,12 @@
+// Needed for sysconf and clock_gettime when compiling with -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utility.h"
+
 /**
  * Checks if an integer value is even.
  *
@@ -9,3 +18,57 @@ const int isEven(const int value)
 {
     return value % 2 == 0;
 }
+
+/**
+ * Get the number of CPUs currently online.
+ *
+ * @return The number of online CPUs (at least 1)
+ */
+int getOnlineCpus(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cpus > 0) {
+        return (int)cpus;
+    }
+#endif
+
+    return 1;
+}
+
+/**
+ * Get the current time from a monotonic clock, for measuring intervals.
+ *
+ * @return The time in seconds
+ */
+double getMonotonicTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * If the given command line argument is of the form name=value, return a
+ * pointer to the value.
+ *
+ * @param  arg  The command line argument
+ * @param  name The name of the option, including leading --
+ *
+ * @return      Pointer to the value, or NULL if arg is not the given option
+ */
+const char *getOptionValue(
+    const char * const arg,
+    const char * const name
+)
+{
+    const size_t length = strlen(name);
+
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+        return NULL;
+    }
+
+    return arg + length + 1;
+}
@@ -1,3 +1,6 @@
+#ifndef UTILITY_H
+#define UTILITY_H
+
 /**
  * Checks if an integer value is even
  *
@@ -6,3 +9,33 @@
  * @return       1 if even, 0 otherwise
  */
 const int isEven(const int value);
+
+/**
+ * Get the number of CPUs currently online.
+ *
+ * @return The number of online CPUs (at least 1)
+ */
+int getOnlineCpus(void);
+
+/**
+ * Get the current time from a monotonic clock, for measuring intervals.
+ *
+ * @return The time in seconds
+ */
+double getMonotonicTime(void);
+
+/**
+ * If the given command line argument is of the form name=value, return a
+ * pointer to the value.
+ *
+ * @param  arg  The command line argument
+ * @param  name The name of the option, including leading --
+ *
+ * @return      Pointer to the value, or NULL if arg is not the given option
+ */
+const char *getOptionValue(
+    const char * const arg,
+    const char * const name
+);
+
+#endif